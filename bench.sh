@@ -0,0 +1,14 @@
+#!/usr/bin/env bash
+set -e
+
+# End-to-end throughput sweep, as CSV on stdout.
+# Every pipeline_bench option and the plugin chain pass through, e.g.
+#   bash bench.sh --lines=200000 --length=exp:80 uppercaser expander
+# The sweep is run once per queue backend; to compare two builds, run
+# ./output/pipeline_bench --root=<other tree> --label=<name> --no-header ...
+# against the other tree and append its rows.
+
+bash build.sh > /dev/null
+
+./output/pipeline_bench --label=locked --host="--queue-backend=locked" "$@"
+./output/pipeline_bench --label=spsc --host="--queue-backend=spsc" --no-header "$@"
@@ -0,0 +1,73 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "kernels/text_kernels.h"
+
+/*
+ * Throughput of every text kernel variant, in GB/s of input.
+ * expand restores its input with memcpy before every run, so its figures
+ * include one extra copy of the input.
+ * Usage: ./output/kernel_bench [line_length ...]
+ */
+
+#define BENCH_SECONDS 0.2
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double measure(void (*kernel)(char*, size_t), char* buf, const char* src, size_t len, int restore) {
+    long runs = 0;
+    double start = now_sec(), elapsed = 0;
+    do {
+        for (int i = 0; i < 64; i++) {
+            if (restore) memcpy(buf, src, len);
+            kernel(buf, len);
+        }
+        runs += 64;
+        elapsed = now_sec() - start;
+    } while (elapsed < BENCH_SECONDS);
+    return (double)runs * len / elapsed / 1e9;
+}
+
+int main(int argc, char** argv) {
+    static const size_t default_lengths[] = { 16, 64, 256, 1024, 16384, 1 << 20 };
+    static const char* const variants[] = { "scalar", "sse2", "avx2", "avx512" };
+    size_t count = argc > 1 ? (size_t)(argc - 1) : sizeof(default_lengths) / sizeof(default_lengths[0]);
+    size_t* lengths = malloc(count * sizeof(size_t));
+    if (!lengths) return 1;
+    size_t max_len = 0;
+    for (size_t i = 0; i < count; i++) {
+        lengths[i] = argc > 1 ? strtoul(argv[i + 1], NULL, 10) : default_lengths[i];
+        if (lengths[i] > max_len) max_len = lengths[i];
+    }
+    char* src = malloc(max_len + 1);
+    char* buf = malloc(2 * max_len + 1);
+    if (!src || !buf) return 1;
+    for (size_t i = 0; i < max_len; i++) {
+        src[i] = (char)('a' + i % 26);
+    }
+    memcpy(buf, src, max_len);
+
+    printf("kernel,variant,length,gb_per_s\n");
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+        const text_kernels_t* k = text_kernels_by_name(variants[v]);
+        if (!k) continue;
+        for (size_t i = 0; i < count; i++) {
+            size_t len = lengths[i];
+            memcpy(buf, src, len);
+            printf("upper,%s,%zu,%.2f\n", k->name, len, measure(k->upper, buf, src, len, 0));
+            printf("reverse,%s,%zu,%.2f\n", k->name, len, measure(k->reverse, buf, src, len, 0));
+            printf("rotate_right,%s,%zu,%.2f\n", k->name, len, measure(k->rotate_right, buf, src, len, 0));
+            printf("expand,%s,%zu,%.2f\n", k->name, len, measure(k->expand, buf, src, len, 1));
+        }
+    }
+    free(buf);
+    free(src);
+    free(lengths);
+    return 0;
+}
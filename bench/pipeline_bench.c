@@ -0,0 +1,320 @@
+#define _DEFAULT_SOURCE
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * End-to-end pipeline throughput. Generates a synthetic workload, runs the
+ * analyzer over it once per queue size and run, and prints one CSV row per
+ * run: lines/s, MB/s of input, CPU utilisation (user + sys over wall time)
+ * and peak RSS of the analyzer process. Output goes to /dev/null, so a
+ * chain without logger measures the pipeline alone.
+ *
+ * Usage: ./output/pipeline_bench [options] [plugin ...]
+ *   --lines=N              lines per workload (default 1000000)
+ *   --length=DIST          fixed:N, uniform:MIN-MAX or exp:MEAN (default uniform:1-120)
+ *   --queue-sizes=A,B,...  queue_size sweep (default 16,64,256,1024)
+ *   --runs=N               runs per queue size (default 3)
+ *   --seed=N               workload seed (default 1)
+ *   --host="OPTS"          analyzer options, e.g. "--queue-backend=spsc --fuse"
+ *   --root=DIR             build to run: DIR/output/analyzer (default .)
+ *   --label=TEXT           first CSV column, to tell builds apart (default current)
+ *   --no-header            omit the CSV header
+ * The chain defaults to: uppercaser rotator flipper expander
+ */
+
+#define MAX_QUEUE_SIZES 32
+#define MAX_HOST_ARGS 32
+
+typedef enum { LENGTH_FIXED, LENGTH_UNIFORM, LENGTH_EXP } length_dist_t;
+
+typedef struct {
+    long lines;
+    const char* length_spec;
+    length_dist_t dist;
+    long min_len, max_len;       /* fixed: min_len; uniform: [min_len, max_len] */
+    double mean_len;             /* exp */
+    int queue_sizes[MAX_QUEUE_SIZES];
+    int queue_size_count;
+    int runs;
+    uint64_t seed;
+    const char* host;
+    const char* root;
+    const char* label;
+    int header;
+    char** chain;
+    int chain_len;
+} bench_config_t;
+
+typedef struct {
+    double seconds;
+    double cpu_seconds;
+    long peak_rss_kb;
+} run_result_t;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t next_random(uint64_t* state) {
+    /* xorshift64*: cheap and reproducible across machines */
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static int parse_length(const char* spec, bench_config_t* cfg) {
+    char* end = NULL;
+    if (strncmp(spec, "fixed:", 6) == 0) {
+        cfg->dist = LENGTH_FIXED;
+        cfg->min_len = strtol(spec + 6, &end, 10);
+        return end == spec + 6 || *end != '\0' || cfg->min_len < 0 ? -1 : 0;
+    }
+    if (strncmp(spec, "uniform:", 8) == 0) {
+        cfg->dist = LENGTH_UNIFORM;
+        cfg->min_len = strtol(spec + 8, &end, 10);
+        if (end == spec + 8 || *end != '-') return -1;
+        const char* max = end + 1;
+        cfg->max_len = strtol(max, &end, 10);
+        return end == max || *end != '\0' || cfg->min_len < 0 || cfg->max_len < cfg->min_len ? -1 : 0;
+    }
+    if (strncmp(spec, "exp:", 4) == 0) {
+        cfg->dist = LENGTH_EXP;
+        cfg->mean_len = strtod(spec + 4, &end);
+        return end == spec + 4 || *end != '\0' || cfg->mean_len <= 0 ? -1 : 0;
+    }
+    return -1;
+}
+
+static long draw_length(const bench_config_t* cfg, uint64_t* state) {
+    switch (cfg->dist) {
+    case LENGTH_FIXED:
+        return cfg->min_len;
+    case LENGTH_UNIFORM:
+        return cfg->min_len + (long)(next_random(state) % (uint64_t)(cfg->max_len - cfg->min_len + 1));
+    case LENGTH_EXP: {
+        /* Inverse transform; capped so a single line cannot swallow the workload */
+        double u = (double)(next_random(state) >> 11) / 9007199254740992.0;
+        double len = -cfg->mean_len * log1p(-u);
+        return len > cfg->mean_len * 64 ? (long)(cfg->mean_len * 64) : (long)len;
+    }
+    }
+    return 0;
+}
+
+static int parse_queue_sizes(const char* list, bench_config_t* cfg) {
+    cfg->queue_size_count = 0;
+    const char* p = list;
+    while (*p) {
+        char* end = NULL;
+        long size = strtol(p, &end, 10);
+        if (end == p || size < 1 || size > 1 << 24 || cfg->queue_size_count == MAX_QUEUE_SIZES) {
+            return -1;
+        }
+        cfg->queue_sizes[cfg->queue_size_count++] = (int)size;
+        if (*end == ',') end++;
+        else if (*end != '\0') return -1;
+        p = end;
+    }
+    return cfg->queue_size_count > 0 ? 0 : -1;
+}
+
+/* Write the workload to a temporary file; returns its size in bytes or -1 */
+static long long write_workload(const bench_config_t* cfg, FILE* out) {
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ 0123456789";
+    uint64_t state = cfg->seed ? cfg->seed : 1;
+    long long bytes = 0;
+    for (long i = 0; i < cfg->lines; i++) {
+        long len = draw_length(cfg, &state);
+        for (long c = 0; c < len; c++) {
+            putc(alphabet[next_random(&state) % (sizeof(alphabet) - 1)], out);
+        }
+        putc('\n', out);
+        bytes += len + 1;
+    }
+    fputs("<END>\n", out);
+    return fflush(out) == 0 ? bytes : -1;
+}
+
+/* Run the analyzer once over the workload */
+static int run_analyzer(const bench_config_t* cfg, const char* workload, int queue_size,
+                        run_result_t* result) {
+    char* argv[MAX_HOST_ARGS + 64];
+    char queue_arg[16];
+    char* host = strdup(cfg->host ? cfg->host : "");
+    if (!host) return -1;
+    int argc = 0;
+    argv[argc++] = "./output/analyzer";
+    for (char* tok = strtok(host, " "); tok && argc < MAX_HOST_ARGS; tok = strtok(NULL, " ")) {
+        argv[argc++] = tok;
+    }
+    snprintf(queue_arg, sizeof queue_arg, "%d", queue_size);
+    argv[argc++] = queue_arg;
+    for (int i = 0; i < cfg->chain_len && argc < MAX_HOST_ARGS + 63; i++) {
+        argv[argc++] = cfg->chain[i];
+    }
+    argv[argc] = NULL;
+
+    double start = now_sec();
+    pid_t pid = fork();
+    if (pid < 0) {
+        free(host);
+        return -1;
+    }
+    if (pid == 0) {
+        int in = open(workload, O_RDONLY);
+        int out = open("/dev/null", O_WRONLY);
+        if (in < 0 || out < 0 || chdir(cfg->root) != 0 ||
+            dup2(in, STDIN_FILENO) < 0 || dup2(out, STDOUT_FILENO) < 0) {
+            perror("pipeline_bench");
+            _exit(127);
+        }
+        execv(argv[0], argv);
+        perror("pipeline_bench: ./output/analyzer");
+        _exit(127);
+    }
+    int status = 0;
+    struct rusage usage;
+    pid_t waited = wait4(pid, &status, 0, &usage);
+    result->seconds = now_sec() - start;
+    free(host);
+    if (waited != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return -1;
+    }
+    result->cpu_seconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+                          usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    result->peak_rss_kb = usage.ru_maxrss;
+    return 0;
+}
+
+static void print_quoted(const char* text) {
+    putchar('"');
+    for (const char* p = text; *p; p++) {
+        if (*p == '"') putchar('"');
+        putchar(*p);
+    }
+    putchar('"');
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [--lines=N] [--length=fixed:N|uniform:MIN-MAX|exp:MEAN] [--queue-sizes=A,B,...]\n"
+            "       [--runs=N] [--seed=N] [--host=\"OPTS\"] [--root=DIR] [--label=TEXT] [--no-header]\n"
+            "       [plugin ...]\n", prog);
+}
+
+int main(int argc, char** argv) {
+    static char* default_chain[] = { "uppercaser", "rotator", "flipper", "expander" };
+    bench_config_t cfg = {
+        .lines = 1000000,
+        .length_spec = "uniform:1-120",
+        .runs = 3,
+        .seed = 1,
+        .root = ".",
+        .label = "current",
+        .header = 1,
+        .chain = default_chain,
+        .chain_len = 4,
+    };
+    parse_length(cfg.length_spec, &cfg);
+    parse_queue_sizes("16,64,256,1024", &cfg);
+    int i = 1;
+    for (; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        const char* arg = argv[i];
+        int bad = 0;
+        if (strncmp(arg, "--lines=", 8) == 0) {
+            cfg.lines = atol(arg + 8);
+            bad = cfg.lines < 1;
+        } else if (strncmp(arg, "--length=", 9) == 0) {
+            cfg.length_spec = arg + 9;
+            bad = parse_length(cfg.length_spec, &cfg) != 0;
+        } else if (strncmp(arg, "--queue-sizes=", 14) == 0) {
+            bad = parse_queue_sizes(arg + 14, &cfg) != 0;
+        } else if (strncmp(arg, "--runs=", 7) == 0) {
+            cfg.runs = atoi(arg + 7);
+            bad = cfg.runs < 1;
+        } else if (strncmp(arg, "--seed=", 7) == 0) {
+            cfg.seed = strtoull(arg + 7, NULL, 10);
+        } else if (strncmp(arg, "--host=", 7) == 0) {
+            cfg.host = arg + 7;
+        } else if (strncmp(arg, "--root=", 7) == 0) {
+            cfg.root = arg + 7;
+        } else if (strncmp(arg, "--label=", 8) == 0) {
+            cfg.label = arg + 8;
+        } else if (strcmp(arg, "--no-header") == 0) {
+            cfg.header = 0;
+        } else {
+            bad = 1;
+        }
+        if (bad) {
+            fprintf(stderr, "pipeline_bench: bad option '%s'\n", arg);
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (i < argc) {
+        cfg.chain = argv + i;
+        cfg.chain_len = argc - i;
+    }
+
+    char workload[] = "/tmp/pipeline_bench_XXXXXX";
+    int fd = mkstemp(workload);
+    FILE* file = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!file) {
+        perror("pipeline_bench: workload");
+        return 1;
+    }
+    long long bytes = write_workload(&cfg, file);
+    fclose(file);
+    if (bytes < 0) {
+        fprintf(stderr, "pipeline_bench: failed to write the workload\n");
+        unlink(workload);
+        return 1;
+    }
+
+    char chain[1024] = "";
+    for (int c = 0; c < cfg.chain_len; c++) {
+        if (c) strncat(chain, " ", sizeof chain - strlen(chain) - 1);
+        strncat(chain, cfg.chain[c], sizeof chain - strlen(chain) - 1);
+    }
+    if (cfg.header) {
+        printf("label,host_options,chain,length,lines,bytes,queue_size,run,"
+               "seconds,lines_per_sec,mb_per_sec,cpu_util,peak_rss_kb\n");
+    }
+    int failed = 0;
+    for (int q = 0; q < cfg.queue_size_count && !failed; q++) {
+        for (int r = 1; r <= cfg.runs; r++) {
+            run_result_t res;
+            if (run_analyzer(&cfg, workload, cfg.queue_sizes[q], &res) != 0) {
+                fprintf(stderr, "pipeline_bench: analyzer failed (queue_size %d)\n", cfg.queue_sizes[q]);
+                failed = 1;
+                break;
+            }
+            print_quoted(cfg.label);
+            putchar(',');
+            print_quoted(cfg.host ? cfg.host : "");
+            putchar(',');
+            print_quoted(chain);
+            printf(",%s,%ld,%lld,%d,%d,%.4f,%.0f,%.2f,%.2f,%ld\n",
+                   cfg.length_spec, cfg.lines, bytes, cfg.queue_sizes[q], r, res.seconds,
+                   cfg.lines / res.seconds, bytes / res.seconds / 1e6,
+                   res.cpu_seconds / res.seconds, res.peak_rss_kb);
+            fflush(stdout);
+        }
+    }
+    unlink(workload);
+    return failed;
+}
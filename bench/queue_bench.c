@@ -0,0 +1,75 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "consumer_producer.h"
+
+/*
+ * Single producer / single consumer throughput of each queue backend.
+ * Usage: ./output/queue_bench [items] [capacity]
+ */
+
+typedef struct {
+    consumer_producer_t* queue;
+    long items;
+} bench_arg_t;
+
+static char token = 'x';
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void* producer(void* arg) {
+    bench_arg_t* b = arg;
+    for (long i = 0; i < b->items; i++) {
+        consumer_producer_put(b->queue, &token);
+    }
+    consumer_producer_signal_finished(b->queue);
+    return NULL;
+}
+
+static double run(consumer_producer_backend_t backend, long items, int capacity) {
+    consumer_producer_t* queue = aligned_alloc(CP_CACHE_LINE, sizeof *queue);
+    if (!queue || consumer_producer_init_backend(queue, capacity, backend) != NULL) {
+        fprintf(stderr, "queue init failed\n");
+        exit(1);
+    }
+    bench_arg_t arg = { queue, items };
+    pthread_t thread;
+    double start = now_sec();
+    pthread_create(&thread, NULL, producer, &arg);
+    long received = 0;
+    while (consumer_producer_get(queue) != NULL) {
+        received++;
+    }
+    pthread_join(thread, NULL);
+    double elapsed = now_sec() - start;
+    if (received != items) {
+        fprintf(stderr, "lost items: %ld of %ld\n", received, items);
+        exit(1);
+    }
+    consumer_producer_destroy(queue);
+    free(queue);
+    return items / elapsed;
+}
+
+int main(int argc, char** argv) {
+    long items = argc > 1 ? atol(argv[1]) : 1000000;
+    int capacity = argc > 2 ? atoi(argv[2]) : 1024;
+    if (items <= 0 || capacity <= 0) {
+        fprintf(stderr, "Usage: %s [items] [capacity]\n", argv[0]);
+        return 1;
+    }
+    double locked = run(CP_BACKEND_LOCKED, items, capacity);
+    double spsc = run(CP_BACKEND_SPSC, items, capacity);
+    printf("backend,items,capacity,items_per_sec\n");
+    printf("locked,%ld,%d,%.0f\n", items, capacity, locked);
+    printf("spsc,%ld,%d,%.0f\n", items, capacity, spsc);
+    printf("# spsc/locked speedup: %.2fx\n", spsc / locked);
+    return 0;
+}
@@ -8,24 +8,107 @@ rm -rf output
 mkdir -p output
 mkdir -p plugins
 
+# Synchronization primitives shared by the host, the plugins and the benches
+SYNC_SRCS="plugins/sync/monitor.c plugins/sync/consumer_producer.c plugins/sync/eventcount.c plugins/sync/spill.c"
+
+# Text kernels use intrinsics, which need the optimizer to stay in registers,
+# so they are built once at -O2 and linked into every plugin
+echo "Building text kernels..."
+gcc -std=c11 -O2 -Wall -Wextra -fPIC -Iplugins -c \
+    -o output/text_kernels.o plugins/kernels/text_kernels.c
+
+# Host modules, shared by analyzer and analyzer-static
+HOST_SRCS="host/msg_alloc.c \
+    host/replica.c \
+    host/ingest.c \
+    host/file_input.c \
+    host/output.c \
+    host/stats_report.c \
+    host/latency.c \
+    host/placement.c \
+    host/executor.c \
+    host/topology.c \
+    host/memo.c \
+    host/pacer.c \
+    host/uring.c"
+
 # Build analyzer
 echo "Building main analyzer..."
-gcc -std=c11 -Wall -Wextra -pthread -ldl -Iplugins -Iplugins/sync \
-    -o output/analyzer main.c
+gcc -std=c11 -O2 -Wall -Wextra -pthread -ldl -Iplugins -Iplugins/sync -Ihost \
+    -o output/analyzer main.c \
+    $HOST_SRCS \
+    plugins/message.c \
+    $SYNC_SRCS
 
 # List of plugins
 PLUGINS="logger uppercaser rotator flipper expander typewriter"
 
+# Plugins without side effects, which analyzer-static specializes chains of
+PURE_PLUGINS="uppercaser rotator flipper expander"
+
 # Build each plugin
 for plugin in $PLUGINS; do
     echo "Building plugin: $plugin"
-    gcc -std=c11 -Wall -Wextra -fPIC -shared -Iplugins -Iplugins/sync \
+    gcc -std=c11 -O2 -Wall -Wextra -fPIC -shared -Iplugins -Iplugins/sync \
         -o output/${plugin}.so \
         plugins/${plugin}.c \
         plugins/plugin_common.c \
-        plugins/sync/monitor.c \
-        plugins/sync/consumer_producer.c \
+        plugins/message.c \
+        output/text_kernels.o \
+        $SYNC_SRCS \
         -lpthread -ldl
 done
 
-echo "build.sh completed successfully."
\ No newline at end of file
+# analyzer-static: the plugins linked in through a static registry (see
+# host/static_registry.h). Each plugin's exported functions are renamed
+# after it, and the whole binary is built with LTO so the specialized chains
+# inline the transforms.
+echo "Building analyzer-static..."
+mkdir -p output/static
+bash gen_static.sh "$PLUGINS" "$PURE_PLUGINS" > output/static/static_registry.c
+STATIC_OBJS=""
+for plugin in $PLUGINS; do
+    RENAMES=""
+    for symbol in plugin_init plugin_fini plugin_place_work plugin_attach plugin_wait_finished \
+                  plugin_get_descriptor plugin_get_name; do
+        RENAMES="$RENAMES -D${symbol}=${plugin}_${symbol}"
+    done
+    gcc -std=c11 -O2 -flto=auto -Wall -Wextra -DANALYZER_STATIC -Iplugins -Iplugins/sync $RENAMES -c \
+        -o output/static/${plugin}.o plugins/${plugin}.c
+    STATIC_OBJS="$STATIC_OBJS output/static/${plugin}.o"
+done
+gcc -std=c11 -O2 -flto=auto -Wall -Wextra -pthread -DANALYZER_STATIC -Iplugins -Iplugins/sync -Ihost \
+    -o output/analyzer-static main.c \
+    $HOST_SRCS \
+    output/static/static_registry.c \
+    $STATIC_OBJS \
+    plugins/plugin_common.c \
+    plugins/message.c \
+    output/text_kernels.o \
+    $SYNC_SRCS \
+    -ldl
+
+# Queue backend micro-benchmark
+echo "Building queue_bench..."
+gcc -std=c11 -O2 -Wall -Wextra -pthread -Iplugins -Iplugins/sync \
+    -o output/queue_bench bench/queue_bench.c \
+    $SYNC_SRCS
+
+# End-to-end pipeline benchmark driver (see bench.sh)
+echo "Building pipeline_bench..."
+gcc -std=c11 -O2 -Wall -Wextra \
+    -o output/pipeline_bench bench/pipeline_bench.c -lm
+
+# Text kernel correctness test and throughput benchmark
+echo "Building kernel_test and kernel_bench..."
+gcc -std=c11 -O2 -Wall -Wextra -Iplugins \
+    -o output/kernel_test tests/kernel_test.c output/text_kernels.o
+gcc -std=c11 -O2 -Wall -Wextra -Iplugins \
+    -o output/kernel_bench bench/kernel_bench.c output/text_kernels.o
+
+# A plugin with only the original string entry points, for Test 28
+echo "Building v1_flipper..."
+gcc -std=c11 -O2 -Wall -Wextra -fPIC -shared -pthread \
+    -o output/v1_flipper.so tests/v1_flipper.c
+
+echo "build.sh completed successfully."
@@ -0,0 +1,94 @@
+#!/usr/bin/env bash
+set -e
+
+# Write the analyzer-static plugin table and specialized chains (see
+# host/static_registry.h) to stdout.
+#   bash gen_static.sh "<built-in plugins>" "<pure plugins>"
+# Every sequence of one to STATIC_CHAIN_MAX pure plugins gets its own
+# function.
+
+PLUGINS=$1
+PURE=$2
+MAX_CHAIN=$(sed -n 's/^#define STATIC_CHAIN_MAX \([0-9]*\).*/\1/p' host/static_registry.h)
+
+echo "/* Generated by gen_static.sh; do not edit */"
+echo "#define _POSIX_C_SOURCE 200809L"
+echo "#include <string.h>"
+echo "#include \"static_registry.h\""
+echo
+for plugin in $PLUGINS; do
+    echo "const plugin_descriptor_t* ${plugin}_plugin_get_descriptor(void);"
+done
+for plugin in $PURE; do
+    echo "const char* ${plugin}_transform(message_t* msg);"
+done
+echo "void plugin_set_host_services(const host_services_t* services);"
+echo
+echo "static const static_plugin_t plugins[] = {"
+for plugin in $PLUGINS; do
+    echo "    { \"$plugin\", ${plugin}_plugin_get_descriptor, plugin_set_host_services },"
+done
+echo "};"
+
+# Sequences of the pure plugins, one per line, words separated by spaces
+sequences() {
+    local prefix=$1 depth=$2
+    for plugin in $PURE; do
+        echo "${prefix}${plugin}"
+        if [ "$depth" -lt "$MAX_CHAIN" ]; then
+            sequences "${prefix}${plugin} " $((depth + 1))
+        fi
+    done
+}
+SEQUENCES=$(sequences "" 1)
+
+while read -r sequence; do
+    echo
+    echo "static void chain_${sequence// /_}(message_t** msgs, int count) {"
+    echo "    for (int i = 0; i < count; i++) {"
+    for plugin in $sequence; do
+        echo "        static_chain_check(${plugin}_transform(msgs[i]), \"$plugin\");"
+    done
+    echo "    }"
+    echo "}"
+done <<< "$SEQUENCES"
+
+echo
+echo "static const struct {"
+echo "    int count;"
+echo "    const plugin_descriptor_t* (*stages[STATIC_CHAIN_MAX])(void);"
+echo "    static_chain_fn run;"
+echo "} chains[] = {"
+while read -r sequence; do
+    stages=""
+    for plugin in $sequence; do
+        stages="${stages:+$stages, }${plugin}_plugin_get_descriptor"
+    done
+    echo "    { $(wc -w <<< "$sequence"), { $stages }, chain_${sequence// /_} },"
+done <<< "$SEQUENCES"
+echo "};"
+
+cat <<'C'
+
+const static_plugin_t* static_registry_find(const char* name) {
+    for (size_t p = 0; p < sizeof plugins / sizeof plugins[0]; p++) {
+        if (strcmp(plugins[p].name, name) == 0) {
+            return &plugins[p];
+        }
+    }
+    return NULL;
+}
+
+static_chain_fn static_registry_find_chain(const plugin_descriptor_t* const* descs, int count) {
+    for (size_t c = 0; c < sizeof chains / sizeof chains[0]; c++) {
+        int match = chains[c].count == count;
+        for (int s = 0; match && s < count; s++) {
+            match = chains[c].stages[s]() == descs[s];
+        }
+        if (match) {
+            return chains[c].run;
+        }
+    }
+    return NULL;
+}
+C
@@ -0,0 +1,557 @@
+#define _GNU_SOURCE
+#include "executor.h"
+#include "consumer_producer.h"
+#include "eventcount.h"
+#include "placement.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EXECUTOR_BATCH_MAX 64
+#define DEQUE_SIZE         256   /* power of two; a full deque spills to the injection list */
+
+/* Task states. A stage is in at most one worker's hands at a time. */
+enum {
+    TASK_IDLE,          /* nothing to do, or someone is about to schedule it */
+    TASK_SCHEDULED,     /* waiting in a deque, the injection list or a continuation */
+    TASK_RUNNING,
+    TASK_NOTIFIED       /* running, and more input arrived meanwhile */
+};
+
+struct executor_stage {
+    const char* name;
+    message_transform_t transform;
+    message_sink_t next;
+    int batch;                       /* messages taken per run */
+    uint64_t limit;                  /* inbox capacity (queue_size) */
+    uint64_t mask;
+    message_t** ring;
+
+    /* Inbox: one producer and one runner at a time, handed over through state */
+    _Alignas(CP_CACHE_LINE) _Atomic uint64_t tail;     /* written by the producer */
+    _Atomic uint64_t high_water;
+    _Atomic uint64_t put_wait_ns;    /* producers helping or waiting on a full inbox */
+    atomic_int placing;              /* producers inside the sink */
+    _Alignas(CP_CACHE_LINE) _Atomic uint64_t head;     /* written by the runner */
+    stage_counters_t counters;
+    _Alignas(CP_CACHE_LINE) atomic_int state;
+    eventcount_t room;               /* producers waiting for the runner to take messages */
+    struct executor_stage* inject_next;
+    int injected;                    /* on the injection list (under inject_lock) */
+
+    pthread_mutex_t done_lock;
+    pthread_cond_t done_cond;
+    int finished;                    /* <END> forwarded */
+};
+
+/* Chase-Lev deque: the owner pushes and pops at the bottom, thieves take the top */
+typedef struct {
+    _Alignas(CP_CACHE_LINE) _Atomic int64_t top;
+    _Alignas(CP_CACHE_LINE) _Atomic int64_t bottom;
+    _Atomic(executor_stage_t*) slots[DEQUE_SIZE];
+} deque_t;
+
+typedef struct {
+    deque_t deque;
+    pthread_t thread;
+    int index;
+    unsigned rng;                    /* victim selection */
+    executor_stage_t* continuation;  /* downstream stage woken by the current run */
+} executor_worker_t;
+
+static struct {
+    executor_worker_t* workers;
+    int count;
+    int started;
+    atomic_int stopping;
+    eventcount_t idle;               /* workers with nothing to run */
+    /* Stages scheduled from outside the pool, or from a full deque */
+    pthread_mutex_t inject_lock;
+    executor_stage_t* inject_head;
+    executor_stage_t* inject_tail;
+    atomic_int inject_count;
+} pool;
+
+static _Thread_local executor_worker_t* self;   /* NULL outside the pool */
+static _Thread_local int depth;                 /* stages this thread is running (nested when helping) */
+
+static int deque_push(deque_t* d, executor_stage_t* stage) {
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    if (b - t >= DEQUE_SIZE) {
+        return -1;
+    }
+    atomic_store_explicit(&d->slots[b & (DEQUE_SIZE - 1)], stage, memory_order_relaxed);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_release);
+    return 0;
+}
+
+static executor_stage_t* deque_pop(deque_t* d) {
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_seq_cst);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_seq_cst);
+    if (t > b) {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return NULL;
+    }
+    executor_stage_t* stage = atomic_load_explicit(&d->slots[b & (DEQUE_SIZE - 1)], memory_order_relaxed);
+    if (t == b) {
+        /* Last one: race the thieves for it */
+        if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst,
+                                                     memory_order_relaxed)) {
+            stage = NULL;
+        }
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    return stage;
+}
+
+static executor_stage_t* deque_steal(deque_t* d) {
+    int64_t t = atomic_load_explicit(&d->top, memory_order_seq_cst);
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_seq_cst);
+    if (t >= b) {
+        return NULL;
+    }
+    executor_stage_t* stage = atomic_load_explicit(&d->slots[t & (DEQUE_SIZE - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst,
+                                                 memory_order_relaxed)) {
+        return NULL;
+    }
+    return stage;
+}
+
+static int deque_nonempty(deque_t* d) {
+    return atomic_load(&d->bottom) > atomic_load(&d->top);
+}
+
+static void inject(executor_stage_t* stage) {
+    pthread_mutex_lock(&pool.inject_lock);
+    /* Already listed: that entry will run it */
+    if (!stage->injected) {
+        stage->injected = 1;
+        stage->inject_next = NULL;
+        if (pool.inject_tail) {
+            pool.inject_tail->inject_next = stage;
+        } else {
+            pool.inject_head = stage;
+        }
+        pool.inject_tail = stage;
+        atomic_fetch_add(&pool.inject_count, 1);
+    }
+    pthread_mutex_unlock(&pool.inject_lock);
+}
+
+static executor_stage_t* take_injected(void) {
+    if (atomic_load_explicit(&pool.inject_count, memory_order_relaxed) == 0) {
+        return NULL;
+    }
+    pthread_mutex_lock(&pool.inject_lock);
+    executor_stage_t* stage = pool.inject_head;
+    if (stage) {
+        pool.inject_head = stage->inject_next;
+        if (!pool.inject_head) {
+            pool.inject_tail = NULL;
+        }
+        stage->injected = 0;
+        atomic_fetch_sub(&pool.inject_count, 1);
+    }
+    pthread_mutex_unlock(&pool.inject_lock);
+    return stage;
+}
+
+/*
+ * Hand a stage that just became SCHEDULED to a worker. The first stage a
+ * worker's top-level run wakes becomes its continuation; everything else
+ * goes on its deque, or to the injection list from outside the pool.
+ */
+static void schedule(executor_stage_t* stage) {
+    if (self && depth == 1 && !self->continuation) {
+        self->continuation = stage;
+        return;
+    }
+    if (!self || deque_push(&self->deque, stage) != 0) {
+        inject(stage);
+    }
+    eventcount_notify_one(&pool.idle);
+}
+
+/*
+ * New input arrived
+ * @return Non-zero if the caller moved the stage to SCHEDULED and must schedule it
+ */
+static int wake(executor_stage_t* stage) {
+    int state = atomic_load(&stage->state);
+    while (1) {
+        if (state == TASK_IDLE) {
+            if (atomic_compare_exchange_weak(&stage->state, &state, TASK_SCHEDULED)) return 1;
+        } else if (state == TASK_RUNNING) {
+            if (atomic_compare_exchange_weak(&stage->state, &state, TASK_NOTIFIED)) return 0;
+        } else {
+            return 0;
+        }
+    }
+}
+
+static uint64_t inbox_depth(executor_stage_t* stage) {
+    return atomic_load(&stage->tail) - atomic_load(&stage->head);
+}
+
+static int inbox_put(executor_stage_t* stage, message_t** msgs, int count) {
+    uint64_t tail = atomic_load_explicit(&stage->tail, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&stage->head, memory_order_acquire);
+    uint64_t room = stage->limit - (tail - head);
+    int n = room < (uint64_t)count ? (int)room : count;
+    for (int i = 0; i < n; i++) {
+        stage->ring[(tail + i) & stage->mask] = msgs[i];
+    }
+    /* seq_cst: ordered against the state check in wake() and finish() */
+    atomic_store(&stage->tail, tail + n);
+    stats_max(&stage->high_water, tail + n - head);
+    return n;
+}
+
+static int inbox_take(executor_stage_t* stage, message_t** msgs, int max) {
+    uint64_t head = atomic_load_explicit(&stage->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&stage->tail, memory_order_acquire);
+    int n = tail - head < (uint64_t)max ? (int)(tail - head) : max;
+    for (int i = 0; i < n; i++) {
+        msgs[i] = stage->ring[(head + i) & stage->mask];
+    }
+    atomic_store_explicit(&stage->head, head + n, memory_order_release);
+    return n;
+}
+
+static void process(executor_stage_t* stage, message_t** msgs, int count) {
+    if (stage->transform.process_batch) {
+        stage->transform.process_batch(msgs, count);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        const char* err = stage->transform.process(msgs[i]);
+        if (err) {
+            fprintf(stderr, "[ERROR][%s] - %s\n", stage->name, err);
+        }
+    }
+}
+
+/* End of a run: give the stage up, or schedule it again if input is waiting */
+static void finish(executor_stage_t* stage, int ended) {
+    int expected = TASK_RUNNING;
+    if (ended) {
+        atomic_store(&stage->state, TASK_IDLE);
+        eventcount_notify(&stage->room);
+        return;
+    }
+    if (inbox_depth(stage) == 0 && atomic_compare_exchange_strong(&stage->state, &expected, TASK_IDLE)) {
+        eventcount_notify(&stage->room);
+        return;
+    }
+    atomic_store(&stage->state, TASK_SCHEDULED);
+    eventcount_notify(&stage->room);
+    schedule(stage);
+}
+
+/* Take one batch from a stage this thread has claimed, run it and forward it */
+static void run_claimed(executor_stage_t* stage) {
+    message_t* msgs[EXECUTOR_BATCH_MAX];
+    depth++;
+    int count = inbox_take(stage, msgs, stage->batch);
+    if (count > 0) {
+        eventcount_notify(&stage->room);
+    }
+    int ended = 0;
+    int next = 0;
+    while (next < count) {
+        int data = message_data_run(msgs + next, count - next);
+        if (data == 0) {
+            message_t* msg = msgs[next++];
+            if (message_is_end(msg)) {
+                for (int i = next; i < count; i++) {
+                    message_free(msgs[i]);
+                }
+                (void)stage->next.place(stage->next.target, msg);
+                ended = 1;
+                break;
+            }
+            (void)stage->next.place(stage->next.target, msg);
+            continue;
+        }
+        message_t** run = msgs + next;
+        uint64_t bytes_in = 0, bytes_out = 0;
+        for (int i = 0; i < data; i++) bytes_in += run[i]->len;
+        uint64_t start = stats_now_ns();
+        process(stage, run, data);
+        uint64_t busy = stats_now_ns() - start;
+        for (int i = 0; i < data; i++) bytes_out += run[i]->len;
+        stage_counters_record(&stage->counters, (uint64_t)data, bytes_in, bytes_out, busy);
+        (void)message_sink_place_batch(&stage->next, run, data);
+        next += data;
+    }
+    finish(stage, ended);
+    depth--;
+    if (ended) {
+        pthread_mutex_lock(&stage->done_lock);
+        stage->finished = 1;
+        pthread_cond_broadcast(&stage->done_cond);
+        pthread_mutex_unlock(&stage->done_lock);
+    }
+}
+
+/* Claim a stage nobody is running, so a producer can drain it itself */
+static int try_claim(executor_stage_t* stage) {
+    int state = atomic_load(&stage->state);
+    while (state == TASK_IDLE || state == TASK_SCHEDULED) {
+        if (atomic_compare_exchange_weak(&stage->state, &state, TASK_RUNNING)) return 1;
+    }
+    return 0;
+}
+
+/* The inbox is full and someone else is running the stage: wait for room */
+static void wait_for_room(executor_stage_t* stage) {
+    unsigned key = eventcount_prepare_wait(&stage->room);
+    int state = atomic_load(&stage->state);
+    if (inbox_depth(stage) < stage->limit || state == TASK_IDLE || state == TASK_SCHEDULED) {
+        eventcount_cancel_wait(&stage->room);
+        return;
+    }
+    eventcount_wait(&stage->room, key);
+}
+
+static const char* executor_place_batch(void* target, message_t** msgs, int count) {
+    executor_stage_t* stage = (executor_stage_t*)target;
+    uint64_t waited = 0;
+    atomic_fetch_add(&stage->placing, 1);
+    while (count > 0) {
+        int put = inbox_put(stage, msgs, count);
+        msgs += put;
+        count -= put;
+        if (put > 0 && wake(stage)) {
+            schedule(stage);
+        }
+        if (count == 0) {
+            break;
+        }
+        // Full: run the stage here if nobody is, otherwise wait for whoever is
+        uint64_t start = stats_now_ns();
+        if (try_claim(stage)) {
+            run_claimed(stage);
+        } else {
+            wait_for_room(stage);
+        }
+        waited += stats_now_ns() - start;
+    }
+    if (waited) {
+        stats_add(&stage->put_wait_ns, waited);
+    }
+    atomic_fetch_sub(&stage->placing, 1);
+    return NULL;
+}
+
+static const char* executor_place_message(void* target, message_t* msg) {
+    return executor_place_batch(target, &msg, 1);
+}
+
+static executor_stage_t* find_work(executor_worker_t* worker) {
+    executor_stage_t* stage = worker->continuation;
+    if (stage) {
+        worker->continuation = NULL;
+        return stage;
+    }
+    stage = deque_pop(&worker->deque);
+    if (stage) return stage;
+    stage = take_injected();
+    if (stage) return stage;
+    // Steal the oldest entry of another worker, starting at a random victim
+    worker->rng ^= worker->rng << 13;
+    worker->rng ^= worker->rng >> 17;
+    worker->rng ^= worker->rng << 5;
+    for (int i = 0; i < pool.count; i++) {
+        executor_worker_t* victim = &pool.workers[(worker->rng + i) % pool.count];
+        if (victim != worker && (stage = deque_steal(&victim->deque)) != NULL) {
+            return stage;
+        }
+    }
+    return NULL;
+}
+
+static int pool_has_work(void) {
+    if (atomic_load(&pool.inject_count) > 0) return 1;
+    for (int i = 0; i < pool.count; i++) {
+        if (deque_nonempty(&pool.workers[i].deque)) return 1;
+    }
+    return 0;
+}
+
+static void* worker_thread(void* arg) {
+    self = (executor_worker_t*)arg;
+    int spin_limit = eventcount_spin_limit();
+    int spins = 0;
+    while (1) {
+        executor_stage_t* stage = find_work(self);
+        if (stage) {
+            spins = 0;
+            // Stale entries (the stage was claimed by a helper meanwhile) are dropped
+            int expected = TASK_SCHEDULED;
+            if (atomic_compare_exchange_strong(&stage->state, &expected, TASK_RUNNING)) {
+                run_claimed(stage);
+            }
+            continue;
+        }
+        if (atomic_load(&pool.stopping)) {
+            break;
+        }
+        if (spins < spin_limit) {
+            spins++;
+            eventcount_relax();
+            continue;
+        }
+        unsigned key = eventcount_prepare_wait(&pool.idle);
+        if (pool_has_work() || atomic_load(&pool.stopping)) {
+            eventcount_cancel_wait(&pool.idle);
+            continue;
+        }
+        eventcount_wait(&pool.idle, key);
+    }
+    return NULL;
+}
+
+const char* executor_start(int workers, const int* cpus) {
+    if (workers < 1 || workers > EXECUTOR_MAX_WORKERS) {
+        return "Worker count out of range";
+    }
+    pool.workers = aligned_alloc(CP_CACHE_LINE, (size_t)workers * sizeof(executor_worker_t));
+    if (!pool.workers) {
+        return "Memory allocation failed";
+    }
+    memset(pool.workers, 0, (size_t)workers * sizeof(executor_worker_t));
+    pool.count = workers;
+    pool.started = 0;
+    atomic_init(&pool.stopping, 0);
+    atomic_init(&pool.inject_count, 0);
+    eventcount_init(&pool.idle);
+    pthread_mutex_init(&pool.inject_lock, NULL);
+    for (int i = 0; i < workers; i++) {
+        executor_worker_t* worker = &pool.workers[i];
+        worker->index = i;
+        worker->rng = 2654435761u * (unsigned)(i + 1);
+        atomic_init(&worker->deque.top, 0);
+        atomic_init(&worker->deque.bottom, 0);
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        if (cpus) {
+            (void)placement_set_thread_attr(&attr, cpus[i]);   /* best effort: unpinned on failure */
+        }
+        int rc = pthread_create(&worker->thread, &attr, worker_thread, worker);
+        pthread_attr_destroy(&attr);
+        if (rc != 0) {
+            executor_stop();
+            return "Failed to create executor worker";
+        }
+        pool.started++;
+    }
+    return NULL;
+}
+
+void executor_stop(void) {
+    if (!pool.workers) return;
+    atomic_store(&pool.stopping, 1);
+    eventcount_notify(&pool.idle);
+    for (int i = 0; i < pool.started; i++) {
+        pthread_join(pool.workers[i].thread, NULL);
+    }
+    pthread_mutex_destroy(&pool.inject_lock);
+    free(pool.workers);
+    pool.workers = NULL;
+    pool.count = 0;
+    pool.started = 0;
+}
+
+const char* executor_stage_create(executor_stage_t** out, const char* name,
+                                  const message_transform_t* transform, int queue_size) {
+    if (queue_size <= 0) {
+        return "Queue size must be greater than 0";
+    }
+    if (!transform || !transform->process) {
+        return "Stage has no transform to run";
+    }
+    executor_stage_t* stage = aligned_alloc(CP_CACHE_LINE, sizeof *stage);
+    if (!stage) {
+        return "Memory allocation failed";
+    }
+    memset(stage, 0, sizeof *stage);
+    uint64_t slots = 1;
+    while (slots < (uint64_t)queue_size) slots <<= 1;
+    stage->ring = malloc(slots * sizeof(message_t*));
+    if (!stage->ring) {
+        free(stage);
+        return "Memory allocation failed";
+    }
+    stage->name = name;
+    stage->transform = *transform;
+    stage->limit = (uint64_t)queue_size;
+    stage->mask = slots - 1;
+    stage->batch = queue_size < EXECUTOR_BATCH_MAX ? queue_size : EXECUTOR_BATCH_MAX;
+    atomic_init(&stage->tail, 0);
+    atomic_init(&stage->head, 0);
+    atomic_init(&stage->state, TASK_IDLE);
+    atomic_init(&stage->placing, 0);
+    eventcount_init(&stage->room);
+    pthread_mutex_init(&stage->done_lock, NULL);
+    pthread_cond_init(&stage->done_cond, NULL);
+    *out = stage;
+    return NULL;
+}
+
+void executor_stage_get_sink(executor_stage_t* stage, message_sink_t* sink) {
+    sink->place = executor_place_message;
+    sink->place_batch = executor_place_batch;
+    sink->target = stage;
+}
+
+void executor_stage_attach(executor_stage_t* stage, const message_sink_t* next_sink) {
+    stage->next = *next_sink;
+}
+
+const char* executor_stage_wait_finished(executor_stage_t* stage) {
+    pthread_mutex_lock(&stage->done_lock);
+    while (!stage->finished) {
+        pthread_cond_wait(&stage->done_cond, &stage->done_lock);
+    }
+    pthread_mutex_unlock(&stage->done_lock);
+    return NULL;
+}
+
+void executor_stage_get_stats(executor_stage_t* stage, stage_stats_t* stats) {
+    memset(stats, 0, sizeof *stats);
+    stage_counters_read(&stage->counters, stats);
+    stats->threads = 0;
+    stats->has_queue = 1;
+    uint64_t head = atomic_load(&stage->head);
+    uint64_t tail = atomic_load(&stage->tail);
+    stats->queue.capacity = stage->limit;
+    stats->queue.depth = tail - head;
+    stats->queue.high_water = atomic_load(&stage->high_water);
+    stats->queue.puts = tail;
+    stats->queue.gets = head;
+    stats->queue.put_wait_ns = atomic_load(&stage->put_wait_ns);
+}
+
+void executor_stage_destroy(executor_stage_t* stage) {
+    if (!stage) return;
+    // A producer may still be on its way out of the sink after placing <END>
+    while (atomic_load(&stage->placing) > 0) {
+        sched_yield();
+    }
+    uint64_t head = atomic_load(&stage->head);
+    uint64_t tail = atomic_load(&stage->tail);
+    for (uint64_t i = head; i != tail; i++) {
+        message_free(stage->ring[i & stage->mask]);
+    }
+    pthread_cond_destroy(&stage->done_cond);
+    pthread_mutex_destroy(&stage->done_lock);
+    free(stage->ring);
+    free(stage);
+}
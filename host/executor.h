@@ -0,0 +1,88 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include "message.h"
+#include "stats.h"
+
+/**
+ * Work-stealing executor (--executor): pure stages run as tasks on a fixed
+ * pool of worker threads instead of a thread each.
+ * Every task stage has a bounded inbox. Placing messages in it schedules
+ * the stage; a worker that schedules the next stage while running one
+ * keeps it as its continuation, so a batch goes down the chain on one
+ * core while it is still in cache. The rest of the stage's inbox is left
+ * on the worker's Chase-Lev deque, where idle workers steal it (oldest
+ * first), so consecutive stages still run in parallel. A stage runs on
+ * one worker at a time, which keeps its output in input order.
+ * Nobody blocks on a full inbox while it could make progress: the
+ * producer runs the stage itself if no one else is running it, and only
+ * waits for the one that is. Threads outside the pool (the input reader,
+ * plugin and replica threads) place messages the same way.
+ */
+
+// Largest pool
+#define EXECUTOR_MAX_WORKERS 256
+
+typedef struct executor_stage executor_stage_t;
+
+/**
+ * Start the worker pool
+ * @param workers Number of worker threads, 1..EXECUTOR_MAX_WORKERS
+ * @param cpus CPU for each worker (-1 entries run unpinned), or NULL
+ * @return NULL on success, error message on failure
+ */
+const char* executor_start(int workers, const int* cpus);
+
+/**
+ * Stop and join the workers. Call once every task stage has finished,
+ * before the stages are destroyed.
+ */
+void executor_stop(void);
+
+/**
+ * Create a task stage
+ * @param out Receives the stage
+ * @param name Stage name (for diagnosis; must outlive the stage)
+ * @param transform The plugin's transform
+ * @param queue_size Capacity of the stage's inbox
+ * @return NULL on success, error message on failure
+ */
+const char* executor_stage_create(executor_stage_t** out, const char* name,
+                                  const message_transform_t* transform, int queue_size);
+
+/**
+ * Get the sink feeding the stage's inbox
+ * @param stage Stage
+ * @param sink Filled with the stage's sink
+ */
+void executor_stage_get_sink(executor_stage_t* stage, message_sink_t* sink);
+
+/**
+ * Forward processed messages to a sink. Must be called before the first
+ * message is placed.
+ * @param stage Stage
+ * @param next_sink Next stage's sink
+ */
+void executor_stage_attach(executor_stage_t* stage, const message_sink_t* next_sink);
+
+/**
+ * Wait until the stage has forwarded <END>
+ * @param stage Stage
+ * @return NULL on success, error message on failure
+ */
+const char* executor_stage_wait_finished(executor_stage_t* stage);
+
+/**
+ * Sample the stage's counters and inbox
+ * @param stage Stage
+ * @param stats Filled with the snapshot
+ */
+void executor_stage_get_stats(executor_stage_t* stage, stage_stats_t* stats);
+
+/**
+ * Free the stage (the executor must be stopped)
+ * @param stage Stage (may be NULL)
+ */
+void executor_stage_destroy(executor_stage_t* stage);
+
+#endif /* EXECUTOR_H */
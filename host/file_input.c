@@ -0,0 +1,305 @@
+#define _POSIX_C_SOURCE 200809L
+#include "file_input.h"
+#include "ingest.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Chunks in flight per worker (claimed or finished but not yet merged) */
+#define CHUNKS_PER_JOB 2
+
+typedef struct {
+    message_t** msgs;            /* the chunk's lines, transformed, in order */
+    size_t count;
+    size_t cap;
+    int done;                    /* worker finished the chunk */
+    int has_end;                 /* the chunk stops at the sentinel */
+    const char* err;
+} chunk_t;
+
+typedef struct {
+    const char* map;
+    size_t size;
+    const message_transform_t* transforms;
+    const char* const* names;
+    int count;
+    stage_counters_t* counters;
+    atomic_int next_worker;
+
+    pthread_mutex_t lock;
+    pthread_cond_t changed;      /* a chunk finished or the merge moved on */
+    size_t next_offset;          /* start of the next unclaimed chunk */
+    uint64_t next_chunk;         /* index of the next unclaimed chunk */
+    uint64_t merged;             /* chunks forwarded so far */
+    uint64_t end_chunk;          /* first chunk holding the sentinel */
+    int stop;
+    size_t window;               /* slots; chunk c lives in slots[c % window] */
+    chunk_t* slots;
+} file_input_t;
+
+static uint64_t payload_bytes(message_t** msgs, int n) {
+    uint64_t bytes = 0;
+    for (int i = 0; i < n; i++) {
+        bytes += msgs[i]->len;
+    }
+    return bytes;
+}
+
+static void run_transforms(file_input_t* in, stage_counters_t* counters, message_t** msgs, int n) {
+    uint64_t bytes = counters ? payload_bytes(msgs, n) : 0;
+    for (int s = 0; s < in->count; s++) {
+        const message_transform_t* t = &in->transforms[s];
+        uint64_t start = counters ? stats_now_ns() : 0;
+        if (t->process_batch) {
+            t->process_batch(msgs, n);
+        } else {
+            for (int i = 0; i < n; i++) {
+                const char* err = t->process(msgs[i]);
+                if (err) {
+                    fprintf(stderr, "[ERROR][%s] - %s\n", in->names[s], err);
+                }
+            }
+        }
+        if (counters) {
+            uint64_t busy = stats_now_ns() - start;
+            uint64_t bytes_out = payload_bytes(msgs, n);
+            stage_counters_record(&counters[s], (uint64_t)n, bytes, bytes_out, busy);
+            bytes = bytes_out;
+        }
+    }
+}
+
+/* Transform the data runs of a batch; control messages pass untouched */
+static void transform_batch(file_input_t* in, stage_counters_t* counters, message_t** msgs, int n) {
+    while (n > 0) {
+        int data = message_data_run(msgs, n);
+        if (data > 0) {
+            run_transforms(in, counters, msgs, data);
+        }
+        if (data < n) {
+            data++;
+        }
+        msgs += data;
+        n -= data;
+    }
+}
+
+static int chunk_push(chunk_t* chunk, message_t* msg) {
+    if (chunk->count == chunk->cap) {
+        size_t cap = chunk->cap ? chunk->cap * 2 : 1024;
+        message_t** msgs = realloc(chunk->msgs, cap * sizeof(message_t*));
+        if (!msgs) {
+            return -1;
+        }
+        chunk->msgs = msgs;
+        chunk->cap = cap;
+    }
+    chunk->msgs[chunk->count++] = msg;
+    return 0;
+}
+
+static void chunk_clear(chunk_t* chunk) {
+    for (size_t i = 0; i < chunk->count; i++) {
+        message_free(chunk->msgs[i]);
+    }
+    chunk->count = 0;
+    chunk->done = 0;
+    chunk->has_end = 0;
+    chunk->err = NULL;
+}
+
+/* Carve map[begin, end) into messages and transform them batch by batch */
+static void process_chunk(file_input_t* in, stage_counters_t* counters, chunk_t* chunk,
+                          size_t begin, size_t end) {
+    size_t transformed = 0;
+    size_t pos = begin;
+    while (pos < end) {
+        const char* line = in->map + pos;
+        const char* nl = memchr(line, '\n', end - pos);
+        size_t len = nl ? (size_t)(nl - line) : end - pos;
+        pos += len + (nl ? 1 : 0);
+        unsigned kind = ingest_trim_line(line, &len);
+        if (kind == MESSAGE_END) {
+            chunk->has_end = 1;
+            break;
+        }
+        message_t* msg = kind == MESSAGE_DATA ? message_from_string(line, len) : message_control(kind);
+        if (!msg || chunk_push(chunk, msg) != 0) {
+            message_free(msg);
+            chunk->err = "Memory allocation failed";
+            break;
+        }
+        if (chunk->count - transformed == INGEST_BATCH) {
+            transform_batch(in, counters, chunk->msgs + transformed, INGEST_BATCH);
+            transformed = chunk->count;
+        }
+    }
+    if (chunk->count > transformed) {
+        transform_batch(in, counters, chunk->msgs + transformed, (int)(chunk->count - transformed));
+    }
+}
+
+static void* worker_main(void* arg) {
+    file_input_t* in = (file_input_t*)arg;
+    stage_counters_t* counters = NULL;
+    if (in->counters) {
+        counters = &in->counters[atomic_fetch_add(&in->next_worker, 1) * in->count];
+    }
+    pthread_mutex_lock(&in->lock);
+    for (;;) {
+        while (!in->stop && in->next_offset < in->size && in->next_chunk < in->end_chunk &&
+               in->next_chunk >= in->merged + in->window) {
+            pthread_cond_wait(&in->changed, &in->lock);
+        }
+        if (in->stop || in->next_offset >= in->size || in->next_chunk >= in->end_chunk) {
+            break;
+        }
+
+        // Claim the next chunk, extended to the end of its last line
+        uint64_t c = in->next_chunk++;
+        size_t begin = in->next_offset;
+        size_t end = in->size;
+        if (in->size - begin > FILE_INPUT_CHUNK_SIZE) {
+            const char* nl = memchr(in->map + begin + FILE_INPUT_CHUNK_SIZE, '\n',
+                                    in->size - begin - FILE_INPUT_CHUNK_SIZE);
+            end = nl ? (size_t)(nl - in->map) + 1 : in->size;
+        }
+        in->next_offset = end;
+        chunk_t* chunk = &in->slots[c % in->window];
+        pthread_mutex_unlock(&in->lock);
+
+        process_chunk(in, counters, chunk, begin, end);
+
+        pthread_mutex_lock(&in->lock);
+        chunk->done = 1;
+        if (chunk->has_end && c < in->end_chunk) {
+            in->end_chunk = c;
+        }
+        pthread_cond_broadcast(&in->changed);
+    }
+    pthread_mutex_unlock(&in->lock);
+    return NULL;
+}
+
+/* Forward finished chunks in order until the input or the sentinel runs out */
+static const char* merge(file_input_t* in, const message_sink_t* sink, uint64_t* next_seq) {
+    const char* err = NULL;
+    pthread_mutex_lock(&in->lock);
+    for (uint64_t c = 0; !err; c++) {
+        chunk_t* chunk = &in->slots[c % in->window];
+        while (!chunk->done && c <= in->end_chunk &&
+               !(c == in->next_chunk && in->next_offset >= in->size)) {
+            pthread_cond_wait(&in->changed, &in->lock);
+        }
+        if (!chunk->done) {
+            break;
+        }
+        pthread_mutex_unlock(&in->lock);
+
+        err = chunk->err;
+        size_t sent = 0;
+        while (!err && sent < chunk->count) {
+            int n = chunk->count - sent > INGEST_BATCH ? INGEST_BATCH : (int)(chunk->count - sent);
+            for (int i = 0; i < n; i++) {
+                chunk->msgs[sent + i]->seq = (*next_seq)++;
+            }
+            err = message_sink_place_batch(sink, chunk->msgs + sent, n);
+            sent += (size_t)n;
+        }
+        // The sink owns what it was given; free the rest
+        memmove(chunk->msgs, chunk->msgs + sent, (chunk->count - sent) * sizeof(message_t*));
+        chunk->count -= sent;
+        int has_end = chunk->has_end;
+        chunk_clear(chunk);
+
+        pthread_mutex_lock(&in->lock);
+        in->merged = c + 1;
+        pthread_cond_broadcast(&in->changed);
+        if (has_end) {
+            break;
+        }
+    }
+    in->stop = 1;
+    pthread_cond_broadcast(&in->changed);
+    pthread_mutex_unlock(&in->lock);
+    return err;
+}
+
+const char* file_input_run(const char* path, int jobs, const message_transform_t* transforms,
+                           const char* const* names, int count, stage_counters_t* counters,
+                           const message_sink_t* sink, uint64_t* next_seq) {
+    if (jobs < 1 || jobs > FILE_INPUT_MAX_JOBS) {
+        return "Invalid number of jobs";
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return "Cannot open input file";
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return "Input is not a regular file";
+    }
+    file_input_t in = {
+        .size = (size_t)st.st_size,
+        .transforms = transforms,
+        .names = names,
+        .count = count,
+        .counters = counters,
+        .end_chunk = UINT64_MAX,
+        .window = (size_t)jobs * CHUNKS_PER_JOB,
+    };
+    if (in.size == 0) {
+        close(fd);
+        return NULL;
+    }
+    void* map = mmap(NULL, in.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return "Cannot map input file";
+    }
+    in.map = map;
+    (void)posix_madvise(map, in.size, POSIX_MADV_SEQUENTIAL);
+
+    in.slots = calloc(in.window, sizeof(chunk_t));
+    pthread_t* threads = calloc((size_t)jobs, sizeof(pthread_t));
+    if (!in.slots || !threads) {
+        free(in.slots);
+        free(threads);
+        munmap(map, in.size);
+        return "Memory allocation failed";
+    }
+    pthread_mutex_init(&in.lock, NULL);
+    pthread_cond_init(&in.changed, NULL);
+
+    // Fewer workers than asked for only costs parallelism
+    const char* err = "Failed to start input worker";
+    int started = 0;
+    while (started < jobs && pthread_create(&threads[started], NULL, worker_main, &in) == 0) {
+        started++;
+    }
+    if (started > 0) {
+        err = merge(&in, sink, next_seq);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    // Chunks claimed past the sentinel or an error are dropped
+    for (size_t i = 0; i < in.window; i++) {
+        chunk_clear(&in.slots[i]);
+        free(in.slots[i].msgs);
+    }
+    pthread_cond_destroy(&in.changed);
+    pthread_mutex_destroy(&in.lock);
+    free(in.slots);
+    free(threads);
+    munmap(map, in.size);
+    return err;
+}
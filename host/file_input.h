@@ -0,0 +1,45 @@
+#ifndef FILE_INPUT_H
+#define FILE_INPUT_H
+
+#include <stdint.h>
+#include "message.h"
+#include "stats.h"
+
+/**
+ * Parallel file input (--input).
+ * The file is mmap'd and cut into newline-aligned chunks. Worker threads
+ * claim chunks, carve their lines into messages and run the chain's
+ * leading pure stages over them, so each worker is an independent copy of
+ * that part of the chain. The calling thread merges finished chunks back
+ * in file order, numbers the lines and hands them to the rest of the
+ * chain. At most a bounded window of chunks is in flight ahead of the
+ * merge.
+ */
+
+// Target chunk size; chunks end at the first '\n' after it
+#define FILE_INPUT_CHUNK_SIZE (256 * 1024)
+
+// Maximum worker threads
+#define FILE_INPUT_MAX_JOBS 256
+
+/**
+ * Run a file through jobs copies of a list of pure transforms, in parallel,
+ * and forward the result in file order. Lines follow the stdin rules
+ * (see ingest.h): control lines pass through in order, and input stops
+ * at <END>.
+ * @param path File to read
+ * @param jobs Worker threads, 1..FILE_INPUT_MAX_JOBS
+ * @param transforms Transforms to apply in order (must be thread-safe)
+ * @param names Stage names for error messages, one per transform
+ * @param count Number of transforms (may be 0)
+ * @param counters Per-worker stage counters, jobs * count of them: worker w
+ *        records transform s in counters[w * count + s] (may be NULL)
+ * @param sink Destination (takes ownership of every message)
+ * @param next_seq Sequence number for the next line; advanced per line
+ * @return NULL on success, error message on failure
+ */
+const char* file_input_run(const char* path, int jobs, const message_transform_t* transforms,
+                           const char* const* names, int count, stage_counters_t* counters,
+                           const message_sink_t* sink, uint64_t* next_seq);
+
+#endif /* FILE_INPUT_H */
@@ -0,0 +1,307 @@
+#define _POSIX_C_SOURCE 200809L
+#include "ingest.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "uring.h"
+
+/* A registered read-ahead block */
+typedef struct {
+    size_t len;
+    size_t pos;                /* bytes already handed to the reader */
+    uint64_t offset;
+    int busy;
+    int error;                 /* errno of a failed read */
+} ingest_slot_t;
+
+/* --io=uring: blocks read ahead of the reader, consumed in file order */
+static struct {
+    int active;
+    int fd;
+    uring_t ring;
+    char* blocks;
+    ingest_slot_t slots[INGEST_URING_DEPTH];
+    int depth;                 /* 1 unless reads carry their own offsets */
+    int head;                  /* slot the reader consumes next */
+    int seekable;
+    uint64_t offset;           /* where the next read goes */
+} uring;
+
+typedef struct {
+    const message_sink_t* sink;
+    uint64_t* next_seq;
+    message_t* msgs[INGEST_BATCH];
+    int count;
+} ingest_batch_t;
+
+static const char* flush_batch(ingest_batch_t* batch) {
+    if (batch->count == 0) {
+        return NULL;
+    }
+    int count = batch->count;
+    batch->count = 0;
+    return message_sink_place_batch(batch->sink, batch->msgs, count);
+}
+
+unsigned ingest_trim_line(const char* line, size_t* len) {
+    size_t n = *len;
+    while (n > 0 && line[n - 1] == '\r') {
+        n--;
+    }
+    *len = n;
+    return message_control_kind(line, n);
+}
+
+/**
+ * Queue one line (without its '\n'). A control line cuts the batch: it is
+ * handed over at once, together with the lines in front of it.
+ * @param batch Pending messages
+ * @param line Line bytes
+ * @param len Line length
+ * @param err Set on failure
+ * @return 1 when the line is <END>, 0 otherwise
+ */
+static int add_line(ingest_batch_t* batch, const char* line, size_t len, const char** err) {
+    unsigned kind = ingest_trim_line(line, &len);
+    if (kind == MESSAGE_END) {
+        return 1;
+    }
+    message_t* msg = kind == MESSAGE_DATA ? message_from_string(line, len) : message_control(kind);
+    if (!msg) {
+        *err = "Memory allocation failed";
+        return 0;
+    }
+    msg->seq = (*batch->next_seq)++;
+    batch->msgs[batch->count++] = msg;
+    if (batch->count == INGEST_BATCH || kind != MESSAGE_DATA) {
+        *err = flush_batch(batch);
+    }
+    return 0;
+}
+
+const char* ingest_use_uring(int fd) {
+    if (uring.active) {
+        return "io_uring input already set up";
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return "Cannot inspect the input";
+    }
+    // Reads at the file position (pipes, ttys) are issued one at a time, as they are needed
+    off_t pos = S_ISREG(st.st_mode) ? lseek(fd, 0, SEEK_CUR) : -1;
+    uring.seekable = pos >= 0;
+    uring.depth = uring.seekable ? INGEST_URING_DEPTH : 1;
+    uring.offset = uring.seekable ? (uint64_t)pos : 0;
+    size_t size = (size_t)INGEST_URING_DEPTH * INGEST_BLOCK_SIZE;
+    uring.blocks = aligned_alloc(4096, size);
+    if (!uring.blocks) {
+        return "Memory allocation failed";
+    }
+    struct iovec buffers[INGEST_URING_DEPTH];
+    for (int i = 0; i < INGEST_URING_DEPTH; i++) {
+        buffers[i].iov_base = uring.blocks + (size_t)i * INGEST_BLOCK_SIZE;
+        buffers[i].iov_len = INGEST_BLOCK_SIZE;
+    }
+    const char* err = uring_init(&uring.ring, INGEST_URING_DEPTH, fd, buffers, INGEST_URING_DEPTH);
+    if (err) {
+        free(uring.blocks);
+        uring.blocks = NULL;
+        return err;
+    }
+    memset(uring.slots, 0, sizeof uring.slots);
+    uring.fd = fd;
+    uring.head = 0;
+    uring.active = 1;
+    return NULL;
+}
+
+/* Queue the read that refills a slot (its data has all been consumed) */
+static void uring_fill(int index) {
+    ingest_slot_t* s = &uring.slots[index];
+    s->len = s->pos = 0;
+    s->error = 0;
+    s->busy = 1;
+    s->offset = uring.offset;
+    if (uring.seekable) {
+        uring.offset += INGEST_BLOCK_SIZE;
+    }
+    // Each slot has at most one request in flight, so the queue has room
+    (void)uring_queue(&uring.ring, 0, (unsigned)index, uring.blocks + (size_t)index * INGEST_BLOCK_SIZE,
+                      INGEST_BLOCK_SIZE, uring.seekable ? s->offset : (uint64_t)-1, (uint64_t)index);
+}
+
+/* Wait for at least one read to complete */
+static void uring_reap(void) {
+    int err = uring_submit(&uring.ring, 1);
+    if (err < 0) {
+        // The ring is unusable: fail every read still outstanding
+        for (int i = 0; i < INGEST_URING_DEPTH; i++) {
+            if (uring.slots[i].busy) {
+                uring.slots[i].busy = 0;
+                uring.slots[i].error = -err;
+            }
+        }
+        return;
+    }
+    uint64_t index;
+    int res;
+    while (uring_complete(&uring.ring, &index, &res)) {
+        ingest_slot_t* s = &uring.slots[index];
+        if (res == -EINTR || res == -EAGAIN) {
+            (void)uring_queue(&uring.ring, 0, (unsigned)index, uring.blocks + (size_t)index * INGEST_BLOCK_SIZE,
+                              INGEST_BLOCK_SIZE, uring.seekable ? s->offset : (uint64_t)-1, index);
+            continue;
+        }
+        s->busy = 0;
+        s->len = res > 0 ? (size_t)res : 0;
+        s->error = res < 0 ? -res : 0;
+    }
+}
+
+static void uring_drain(void) {
+    for (int i = 0; i < INGEST_URING_DEPTH; i++) {
+        while (uring.slots[i].busy) {
+            uring_reap();
+        }
+    }
+}
+
+/* Start reading ahead from the head slot */
+static void uring_prime(void) {
+    for (int k = 0; k < uring.depth; k++) {
+        uring_fill((uring.head + k) % uring.depth);
+    }
+    (void)uring_submit(&uring.ring, 0);
+}
+
+/* read() from the blocks read ahead: copies out of the head slot, refilling it once it is used up */
+static ssize_t uring_read(char* dst, size_t len) {
+    for (;;) {
+        ingest_slot_t* s = &uring.slots[uring.head];
+        if (s->busy) {
+            uring_reap();
+            continue;
+        }
+        if (s->error) {
+            errno = s->error;
+            return -1;
+        }
+        if (s->pos < s->len) {
+            size_t n = s->len - s->pos < len ? s->len - s->pos : len;
+            memcpy(dst, uring.blocks + (size_t)uring.head * INGEST_BLOCK_SIZE + s->pos, n);
+            s->pos += n;
+            return (ssize_t)n;
+        }
+        if (s->len == 0) {
+            return 0;
+        }
+        if (uring.seekable && s->len < INGEST_BLOCK_SIZE) {
+            // A short read (end of file, or a file still growing): the reads behind it
+            // were aimed past it, so start over from where this one ended
+            uring_drain();
+            uring.offset = s->offset + s->len;
+            uring_prime();
+            continue;
+        }
+        uring_fill(uring.head);
+        (void)uring_submit(&uring.ring, 0);
+        uring.head = (uring.head + 1) % uring.depth;
+    }
+}
+
+/* Reads already in flight at end of input are waited for, then the ring goes */
+static void uring_release(void) {
+    uring_drain();
+    uring_free(&uring.ring);
+    free(uring.blocks);
+    uring.blocks = NULL;
+    uring.active = 0;
+}
+
+const char* ingest_fd(int fd, const message_sink_t* sink, uint64_t* next_seq, int* saw_end) {
+    ingest_batch_t batch = { .sink = sink, .next_seq = next_seq, .count = 0 };
+    size_t cap = INGEST_BLOCK_SIZE;
+    char* buf = malloc(cap);
+    if (!buf) {
+        return "Memory allocation failed";
+    }
+
+    // Unconsumed input is buf[start, end); buf[start, scanned) holds no '\n'
+    size_t start = 0, scanned = 0, end = 0;
+    const char* err = NULL;
+    *saw_end = 0;
+    int use_uring = uring.active && uring.fd == fd;
+    if (use_uring) {
+        uring_prime();
+    }
+
+    while (!err && !*saw_end) {
+        if (end == cap) {
+            if (start > 0) {
+                memmove(buf, buf + start, end - start);
+                end -= start;
+                scanned -= start;
+                start = 0;
+            } else {
+                // One line fills the whole buffer: grow it
+                char* bigger = realloc(buf, cap * 2);
+                if (!bigger) {
+                    err = "Memory allocation failed";
+                    break;
+                }
+                buf = bigger;
+                cap *= 2;
+            }
+        }
+
+        ssize_t n = use_uring ? uring_read(buf + end, cap - end) : read(fd, buf + end, cap - end);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            err = "Failed to read input";
+            break;
+        }
+        if (n == 0) {
+            // Last line without a trailing '\n'
+            if (end > start) {
+                *saw_end = add_line(&batch, buf + start, end - start, &err);
+            }
+            break;
+        }
+        end += (size_t)n;
+
+        char* nl = NULL;
+        while (!err && (nl = memchr(buf + scanned, '\n', end - scanned)) != NULL) {
+            size_t next = (size_t)(nl - buf) + 1;
+            if (add_line(&batch, buf + start, (size_t)(nl - (buf + start)), &err)) {
+                *saw_end = 1;
+                break;
+            }
+            start = scanned = next;
+        }
+        if (!nl) {
+            scanned = end;
+        }
+
+        // Hand over what this read produced before the next one may block
+        if (!err) {
+            err = flush_batch(&batch);
+        }
+    }
+
+    if (!err) {
+        err = flush_batch(&batch);
+    } else {
+        for (int i = 0; i < batch.count; i++) {
+            message_free(batch.msgs[i]);
+        }
+    }
+    free(buf);
+    if (use_uring) {
+        uring_release();
+    }
+    return err;
+}
@@ -0,0 +1,61 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <stdint.h>
+#include "message.h"
+
+/**
+ * Block-based line ingestion.
+ * Input is read with read() in large blocks, lines are found with memchr
+ * and each line is copied once, straight from the block into its message.
+ * Lines have no length limit: the block buffer grows until a line fits.
+ * Trailing '\r's are trimmed, and a final line without '\n' still counts.
+ * Messages go out in batches, and whatever a read() produced is flushed
+ * before the next read() can block, so interactive input is not delayed.
+ * Lines that spell a control message (<END>, <FLUSH>, <BARRIER>) become
+ * one; any other line, including a bare "END", is data.
+ */
+
+// Bytes requested per read()
+#define INGEST_BLOCK_SIZE (256 * 1024)
+
+// Messages handed to the sink per place_batch call
+#define INGEST_BATCH 64
+
+// Blocks kept in flight ahead of the reader under --io=uring
+#define INGEST_URING_DEPTH 4
+
+/**
+ * Trim a line's trailing '\r's and recognize control lines
+ * @param line Line bytes, without the '\n'
+ * @param len Line length; reduced by the trimmed bytes
+ * @return MESSAGE_DATA, or the control kind the line spells
+ */
+unsigned ingest_trim_line(const char* line, size_t* len);
+
+/**
+ * Have ingest_fd read fd through io_uring (--io=uring) instead of read():
+ * INGEST_URING_DEPTH registered blocks are read with READ_FIXED from the
+ * fd registered as a fixed file, and refilled as the reader uses them up,
+ * so a regular file is read several blocks ahead of the lines being cut.
+ * Anything else (a pipe or a tty) is read one block at a time, only when
+ * the reader needs more, so nothing is read past <END>. The ring is
+ * released when ingest_fd returns.
+ * @param fd File descriptor ingest_fd will be given
+ * @return NULL on success, or why io_uring cannot be used (ingest_fd then
+ *         uses read() as usual)
+ */
+const char* ingest_use_uring(int fd);
+
+/**
+ * Feed every line of a file descriptor into a sink, up to <END> or end of
+ * file. <END> itself is not placed; <FLUSH> and <BARRIER> are.
+ * @param fd File descriptor to read
+ * @param sink Destination (takes ownership of every message)
+ * @param next_seq Sequence number for the next line; advanced per line
+ * @param saw_end Set to 1 when the sentinel was read, 0 on end of file
+ * @return NULL on success, error message on failure
+ */
+const char* ingest_fd(int fd, const message_sink_t* sink, uint64_t* next_seq, int* saw_end);
+
+#endif /* INGEST_H */
@@ -0,0 +1,247 @@
+#define _POSIX_C_SOURCE 200809L
+#include "latency.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stats.h"
+
+#define LATENCY_BUCKETS ((LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS)
+
+typedef struct {
+    _Atomic uint64_t counts[LATENCY_BUCKETS];
+    _Atomic uint64_t total;
+    _Atomic uint64_t max;
+} latency_hist_t;
+
+typedef struct {
+    uint64_t start_ns;
+    uint64_t dur_ns;
+    uint64_t seq;
+    int track;                   /* stage index, or hops for end to end */
+} trace_event_t;
+
+static struct {
+    int enabled;
+    int hops;
+    const char* const* names;
+    latency_hist_t* hist;        /* one per stage, then end to end */
+    const char* trace_path;
+    uint64_t sample_every;
+    trace_event_t* events;
+    atomic_size_t event_count;
+    uint64_t start_ns;
+} lat;
+
+/* Log-linear bucket: exact below 2^SUB_BITS, then 2^SUB_BITS per power of two */
+static int bucket_of(uint64_t value) {
+    const uint64_t limit = ((uint64_t)1 << LATENCY_MAX_BITS) - 1;
+    if (value > limit) value = limit;
+    if (value < ((uint64_t)1 << LATENCY_SUB_BITS)) {
+        return (int)value;
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    int block = exponent - LATENCY_SUB_BITS + 1;
+    int sub = (int)(value >> (exponent - LATENCY_SUB_BITS)) - (1 << LATENCY_SUB_BITS);
+    return (block << LATENCY_SUB_BITS) + sub;
+}
+
+/* Largest value that lands in a bucket */
+static uint64_t bucket_high(int bucket) {
+    if (bucket < (1 << LATENCY_SUB_BITS)) {
+        return (uint64_t)bucket;
+    }
+    int shift = (bucket >> LATENCY_SUB_BITS) - 1;
+    uint64_t sub = (uint64_t)(bucket & ((1 << LATENCY_SUB_BITS) - 1));
+    uint64_t low = (((uint64_t)1 << LATENCY_SUB_BITS) + sub) << shift;
+    return low + ((uint64_t)1 << shift) - 1;
+}
+
+static void hist_record(latency_hist_t* hist, uint64_t value) {
+    atomic_fetch_add_explicit(&hist->counts[bucket_of(value)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->total, 1, memory_order_relaxed);
+    uint64_t max = atomic_load_explicit(&hist->max, memory_order_relaxed);
+    while (value > max &&
+           !atomic_compare_exchange_weak_explicit(&hist->max, &max, value, memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+}
+
+static uint64_t hist_percentile(latency_hist_t* hist, double fraction) {
+    uint64_t total = atomic_load(&hist->total);
+    if (total == 0) return 0;
+    uint64_t rank = (uint64_t)(fraction * (double)total + 0.999999);
+    if (rank < 1) rank = 1;
+    uint64_t max = atomic_load(&hist->max);
+    uint64_t seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += atomic_load_explicit(&hist->counts[b], memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t high = bucket_high(b);
+            return high < max ? high : max;
+        }
+    }
+    return max;
+}
+
+static void trace_event(uint64_t seq, int track, uint64_t start_ns, uint64_t end_ns) {
+    if (!lat.events || seq % lat.sample_every != 0) return;
+    size_t slot = atomic_fetch_add_explicit(&lat.event_count, 1, memory_order_relaxed);
+    if (slot >= LATENCY_TRACE_MAX_EVENTS) return;
+    lat.events[slot] = (trace_event_t){ start_ns, end_ns - start_ns, seq, track };
+}
+
+static void probe_messages(int hop, message_t** msgs, int count) {
+    uint64_t now = stats_now_ns();
+    for (int i = 0; i < count; i++) {
+        message_t* msg = msgs[i];
+        if (hop == LATENCY_PROBE_INGEST) {
+            if (msg->kind == MESSAGE_DATA) {
+                msg->born_ns = now;
+                msg->stamp_ns = now;
+            }
+            continue;
+        }
+        if (msg->born_ns == 0) {
+            continue;           /* control message, or a copy made by a v1 stage */
+        }
+        if (hop == LATENCY_PROBE_EXIT) {
+            hist_record(&lat.hist[lat.hops], now - msg->born_ns);
+            trace_event(msg->seq, lat.hops, msg->born_ns, now);
+            continue;
+        }
+        hist_record(&lat.hist[hop], now - msg->stamp_ns);
+        trace_event(msg->seq, hop, msg->stamp_ns, now);
+        msg->stamp_ns = now;
+    }
+}
+
+static const char* probe_place(void* target, message_t* msg) {
+    latency_probe_t* probe = (latency_probe_t*)target;
+    probe_messages(probe->hop, &msg, 1);
+    return probe->next.place(probe->next.target, msg);
+}
+
+static const char* probe_place_batch(void* target, message_t** msgs, int count) {
+    latency_probe_t* probe = (latency_probe_t*)target;
+    probe_messages(probe->hop, msgs, count);
+    return message_sink_place_batch(&probe->next, msgs, count);
+}
+
+const char* latency_start(int hops, const char* const* names, const char* trace_path,
+                          uint64_t sample_every) {
+    lat.hist = calloc((size_t)hops + 1, sizeof(latency_hist_t));
+    if (!lat.hist) {
+        return "Memory allocation failed";
+    }
+    if (trace_path) {
+        lat.events = calloc(LATENCY_TRACE_MAX_EVENTS, sizeof(trace_event_t));
+        if (!lat.events) {
+            free(lat.hist);
+            lat.hist = NULL;
+            return "Memory allocation failed";
+        }
+    }
+    lat.hops = hops;
+    lat.names = names;
+    lat.trace_path = trace_path;
+    lat.sample_every = sample_every ? sample_every : 1;
+    atomic_init(&lat.event_count, 0);
+    lat.start_ns = stats_now_ns();
+    lat.enabled = 1;
+    return NULL;
+}
+
+void latency_probe_init(latency_probe_t* probe, int hop, const message_sink_t* next,
+                        message_sink_t* sink) {
+    probe->hop = hop;
+    probe->next = *next;
+    sink->place = probe_place;
+    sink->place_batch = probe_place_batch;
+    sink->target = probe;
+}
+
+void latency_record_hop(int hop, message_t** msgs, int count) {
+    probe_messages(hop, msgs, count);
+}
+
+int latency_enabled(void) {
+    return lat.enabled;
+}
+
+static void print_row(FILE* out, const char* name, latency_hist_t* hist) {
+    fprintf(out, "%-14s %10llu %10llu %10llu %10llu %10llu\n", name,
+            (unsigned long long)atomic_load(&hist->total),
+            (unsigned long long)hist_percentile(hist, 0.50),
+            (unsigned long long)hist_percentile(hist, 0.99),
+            (unsigned long long)hist_percentile(hist, 0.999),
+            (unsigned long long)atomic_load(&hist->max));
+}
+
+static void print_json_string(FILE* out, const char* str) {
+    fputc('"', out);
+    for (const char* p = str; *p; p++) {
+        if (*p == '"' || *p == '\\') fputc('\\', out);
+        fputc(*p, out);
+    }
+    fputc('"', out);
+}
+
+static const char* write_trace(void) {
+    FILE* out = fopen(lat.trace_path, "w");
+    if (!out) {
+        return "Cannot open the trace file";
+    }
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (int t = 0; t <= lat.hops; t++) {
+        fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", t + 1);
+        print_json_string(out, t < lat.hops ? lat.names[t] : "end-to-end");
+        fprintf(out, "}},\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                "\"args\":{\"sort_index\":%d}},\n", t + 1, t);
+    }
+    size_t count = atomic_load(&lat.event_count);
+    if (count > LATENCY_TRACE_MAX_EVENTS) count = LATENCY_TRACE_MAX_EVENTS;
+    for (size_t i = 0; i < count; i++) {
+        const trace_event_t* e = &lat.events[i];
+        fprintf(out, "{\"name\":\"line %llu\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"seq\":%llu}},\n",
+                (unsigned long long)e->seq, e->track < lat.hops ? "hop" : "end-to-end", e->track + 1,
+                (double)(e->start_ns - lat.start_ns) / 1e3, (double)e->dur_ns / 1e3,
+                (unsigned long long)e->seq);
+    }
+    /* Closing metadata event, so every event line above can end with a comma */
+    fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"analyzer\"}}\n]}\n");
+    if (fclose(out) != 0) {
+        return "Failed to write the trace file";
+    }
+    return NULL;
+}
+
+const char* latency_finish(FILE* report) {
+    if (!lat.enabled) {
+        return NULL;
+    }
+    flockfile(report);
+    fprintf(report, "--- latency in ns (hop: handed on by the previous stage until handed on by this one) ---\n");
+    fprintf(report, "%-14s %10s %10s %10s %10s %10s\n", "stage", "lines", "p50", "p99", "p999", "max");
+    for (int h = 0; h < lat.hops; h++) {
+        if (atomic_load(&lat.hist[h].total) > 0) {
+            print_row(report, lat.names[h], &lat.hist[h]);
+        }
+    }
+    print_row(report, "end-to-end", &lat.hist[lat.hops]);
+    size_t events = atomic_load(&lat.event_count);
+    if (events > LATENCY_TRACE_MAX_EVENTS) {
+        fprintf(report, "trace: kept %d of %zu events\n", LATENCY_TRACE_MAX_EVENTS, events);
+    }
+    fflush(report);
+    funlockfile(report);
+    return lat.events ? write_trace() : NULL;
+}
+
+void latency_stop(void) {
+    free(lat.hist);
+    free(lat.events);
+    lat.hist = NULL;
+    lat.events = NULL;
+    lat.enabled = 0;
+}
@@ -0,0 +1,90 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "message.h"
+
+/**
+ * Per-message latency tracing (--latency, --trace).
+ * Lines are stamped when the host hands them to the chain. Every stage's
+ * output sink is wrapped in a probe that records the time since the
+ * previous stamp (the hop: queue wait plus processing) and restamps the
+ * message; the probe in front of the final sink also records end-to-end
+ * latency. Hops and end-to-end go into log-linear (HDR-style) histograms
+ * with under 1% relative error. Sampled lines are also kept as Chrome
+ * trace events ("X" complete events, one track per stage), so a slow line
+ * can be followed hop by hop in chrome://tracing or Perfetto.
+ */
+
+// Sub-buckets per power of two (2^7 = 128: under 1% relative error)
+#define LATENCY_SUB_BITS 7
+
+// Largest value tracked (2^40 ns, about 18 minutes); larger ones are clamped
+#define LATENCY_MAX_BITS 40
+
+// Sampled trace events kept (the rest are counted and dropped)
+#define LATENCY_TRACE_MAX_EVENTS (1 << 20)
+
+// Default: one traced line in this many
+#define LATENCY_DEFAULT_SAMPLE 1000
+
+/* Special probe positions; stages use their chain index */
+#define LATENCY_PROBE_INGEST (-1)   /* stamps lines entering the chain */
+#define LATENCY_PROBE_EXIT   (-2)   /* records end-to-end latency */
+
+/* A sink wrapper; the caller owns its storage for the life of the pipeline */
+typedef struct latency_probe {
+    int hop;
+    message_sink_t next;
+} latency_probe_t;
+
+/**
+ * Enable tracing
+ * @param hops Number of stages
+ * @param names Stage names (kept until latency_finish)
+ * @param trace_path Chrome trace file to write, or NULL for histograms only
+ * @param sample_every Trace lines whose seq is a multiple of this
+ * @return NULL on success, error message on failure
+ */
+const char* latency_start(int hops, const char* const* names, const char* trace_path,
+                          uint64_t sample_every);
+
+/**
+ * Wrap a sink in a probe
+ * @param probe Probe storage
+ * @param hop Stage index, LATENCY_PROBE_INGEST or LATENCY_PROBE_EXIT
+ * @param next Sink the probe forwards to
+ * @param sink Filled with the wrapped sink
+ */
+void latency_probe_init(latency_probe_t* probe, int hop, const message_sink_t* next,
+                        message_sink_t* sink);
+
+/**
+ * Record a hop for messages processed inline (fused stages)
+ * @param hop Stage index
+ * @param msgs Messages (no <END>)
+ * @param count Number of messages
+ */
+void latency_record_hop(int hop, message_t** msgs, int count);
+
+/**
+ * Whether tracing is on
+ * @return Non-zero once latency_start succeeded
+ */
+int latency_enabled(void);
+
+/**
+ * Print p50/p99/p999/max per hop and end to end, and write the trace file.
+ * Call once every line has reached the final sink.
+ * @param report Destination of the table
+ * @return NULL on success, error message if the trace could not be written
+ */
+const char* latency_finish(FILE* report);
+
+/**
+ * Free everything. Call after the stage threads have exited.
+ */
+void latency_stop(void);
+
+#endif /* LATENCY_H */
@@ -0,0 +1,234 @@
+#define _POSIX_C_SOURCE 200809L
+#include "memo.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    char* bytes;                /* input, then output; NULL: free slot */
+    uint64_t key;               /* hash of the input, mixed with the run */
+    uint32_t input_len;
+    uint32_t output_len;
+    int run;
+    int next;                   /* next entry in the same bucket, -1: none */
+    int referenced;             /* hit since the hand last passed */
+} memo_entry_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    memo_entry_t* entries;
+    int* buckets;               /* first entry of each bucket, -1: none */
+    unsigned bucket_mask;
+    int capacity;
+    int used;
+    int hand;                   /* CLOCK hand */
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+} __attribute__((aligned(64))) memo_shard_t;
+
+static struct {
+    memo_shard_t* shards;
+    int shard_capacity;
+} memo;
+
+static uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+/* Final avalanche, so every input bit reaches the shard and bucket bits */
+static uint64_t fmix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t memo_hash(const char* data, size_t len) {
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ len;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof word);
+        h ^= rotl(word * 0x87c37b91114253d5ull, 31) * 0x4cf5ad432745937full;
+        h = rotl(h, 27) * 5 + 0x52dce729;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, data + i, len - i);
+    h ^= rotl(tail * 0x87c37b91114253d5ull, 31) * 0x4cf5ad432745937full;
+    return fmix(h);
+}
+
+static uint64_t run_key(int run, uint64_t hash) {
+    return hash ^ fmix((uint64_t)(unsigned)run + 1);
+}
+
+static memo_shard_t* shard_of(uint64_t key) {
+    return &memo.shards[key >> 60 & (MEMO_SHARDS - 1)];
+}
+
+/* Entry for a line in a locked shard, or -1 */
+static int find(memo_shard_t* shard, uint64_t key, int run, const char* input, size_t input_len) {
+    for (int e = shard->buckets[key & shard->bucket_mask]; e >= 0; e = shard->entries[e].next) {
+        const memo_entry_t* entry = &shard->entries[e];
+        if (entry->key == key && entry->run == run && entry->input_len == input_len &&
+            memcmp(entry->bytes, input, input_len) == 0) {
+            return e;
+        }
+    }
+    return -1;
+}
+
+static void unlink_entry(memo_shard_t* shard, int victim) {
+    int* link = &shard->buckets[shard->entries[victim].key & shard->bucket_mask];
+    while (*link != victim) {
+        link = &shard->entries[*link].next;
+    }
+    *link = shard->entries[victim].next;
+}
+
+/* Slot for a new entry in a full, locked shard: the first one the hand finds unreferenced */
+static int evict(memo_shard_t* shard) {
+    for (;;) {
+        memo_entry_t* entry = &shard->entries[shard->hand];
+        int slot = shard->hand;
+        shard->hand = (shard->hand + 1) % shard->capacity;
+        if (!entry->referenced) {
+            unlink_entry(shard, slot);
+            shard->evictions++;
+            return slot;
+        }
+        entry->referenced = 0;
+    }
+}
+
+const char* memo_start(size_t entries) {
+    if (entries < MEMO_SHARDS || entries > (size_t)MEMO_SHARDS * (1u << 30)) {
+        return "Cache size out of range";
+    }
+    memo.shard_capacity = (int)(entries / MEMO_SHARDS);
+    unsigned buckets = 1;
+    while (buckets < (unsigned)memo.shard_capacity) {
+        buckets <<= 1;
+    }
+    memo.shards = aligned_alloc(64, MEMO_SHARDS * sizeof(memo_shard_t));
+    if (!memo.shards) {
+        return "Memory allocation failed";
+    }
+    memset(memo.shards, 0, MEMO_SHARDS * sizeof(memo_shard_t));
+    for (int s = 0; s < MEMO_SHARDS; s++) {
+        memo_shard_t* shard = &memo.shards[s];
+        shard->capacity = memo.shard_capacity;
+        shard->bucket_mask = buckets - 1;
+        shard->entries = calloc((size_t)shard->capacity, sizeof(memo_entry_t));
+        shard->buckets = malloc(buckets * sizeof(int));
+        if (!shard->entries || !shard->buckets || pthread_mutex_init(&shard->lock, NULL) != 0) {
+            free(shard->entries);
+            free(shard->buckets);
+            for (int k = 0; k < s; k++) {
+                free(memo.shards[k].entries);
+                free(memo.shards[k].buckets);
+                pthread_mutex_destroy(&memo.shards[k].lock);
+            }
+            free(memo.shards);
+            memo.shards = NULL;
+            return "Memory allocation failed";
+        }
+        memset(shard->buckets, 0xff, buckets * sizeof(int));
+    }
+    return NULL;
+}
+
+void memo_stop(void) {
+    if (!memo.shards) {
+        return;
+    }
+    for (int s = 0; s < MEMO_SHARDS; s++) {
+        memo_shard_t* shard = &memo.shards[s];
+        for (int e = 0; e < shard->used; e++) {
+            free(shard->entries[e].bytes);
+        }
+        free(shard->entries);
+        free(shard->buckets);
+        pthread_mutex_destroy(&shard->lock);
+    }
+    free(memo.shards);
+    memo.shards = NULL;
+}
+
+int memo_enabled(void) {
+    return memo.shards != NULL;
+}
+
+int memo_lookup(int run, uint64_t hash, message_t* msg) {
+    uint64_t key = run_key(run, hash);
+    memo_shard_t* shard = shard_of(key);
+    pthread_mutex_lock(&shard->lock);
+    int e = msg->len <= MEMO_MAX_LINE ? find(shard, key, run, msg->data, msg->len) : -1;
+    int hit = 0;
+    if (e >= 0) {
+        memo_entry_t* entry = &shard->entries[e];
+        if (message_reserve(msg, entry->output_len) == 0) {
+            memcpy(msg->data, entry->bytes + entry->input_len, entry->output_len);
+            msg->len = entry->output_len;
+            msg->data[msg->len] = '\0';
+            entry->referenced = 1;
+            hit = 1;
+        }
+    }
+    if (hit) {
+        shard->hits++;
+    } else {
+        shard->misses++;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return hit;
+}
+
+void memo_store(int run, uint64_t hash, const char* input, size_t input_len, const message_t* output) {
+    if (input_len > MEMO_MAX_LINE || output->len > MEMO_MAX_LINE) {
+        return;
+    }
+    // Copy outside the lock; the shard only swaps pointers
+    char* bytes = malloc(input_len + output->len + 1);
+    if (!bytes) {
+        return;
+    }
+    memcpy(bytes, input, input_len);
+    memcpy(bytes + input_len, output->data, output->len);
+    uint64_t key = run_key(run, hash);
+    memo_shard_t* shard = shard_of(key);
+    char* old = bytes;
+    pthread_mutex_lock(&shard->lock);
+    // The same line twice in one batch misses twice; keep the first
+    if (find(shard, key, run, input, input_len) < 0) {
+        int slot = shard->used < shard->capacity ? shard->used++ : evict(shard);
+        memo_entry_t* entry = &shard->entries[slot];
+        old = entry->bytes;
+        unsigned bucket = key & shard->bucket_mask;
+        *entry = (memo_entry_t){ bytes, key, (uint32_t)input_len, (uint32_t)output->len, run,
+                                 shard->buckets[bucket], 0 };
+        shard->buckets[bucket] = slot;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    free(old);
+}
+
+void memo_get_stats(cache_stats_t* stats) {
+    memset(stats, 0, sizeof *stats);
+    if (!memo.shards) {
+        return;
+    }
+    for (int s = 0; s < MEMO_SHARDS; s++) {
+        memo_shard_t* shard = &memo.shards[s];
+        pthread_mutex_lock(&shard->lock);
+        stats->capacity += (uint64_t)shard->capacity;
+        stats->entries += (uint64_t)shard->used;
+        stats->hits += shard->hits;
+        stats->misses += shard->misses;
+        stats->evictions += shard->evictions;
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef MEMO_H
+#define MEMO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "message.h"
+#include "stats.h"
+
+/**
+ * Result cache for runs of pure stages (--memo).
+ * A run's output depends only on its input line, so the host keys the
+ * run's final output on a hash of the input bytes and replays it the next
+ * time the same line comes in, without calling any of the run's stages.
+ * One table holds the entries of every run (an entry is tagged with the
+ * run it belongs to). It is split into shards by hash, each with its own
+ * lock and a CLOCK hand: a hit sets the entry's reference bit, and a miss
+ * that finds the shard full evicts the first entry the hand finds
+ * unreferenced, clearing bits on the way.
+ */
+
+// Entries kept by default
+#define MEMO_DEFAULT_ENTRIES 65536
+
+// Shards (a power of two)
+#define MEMO_SHARDS 16
+
+// Lines longer than this, in or out, are not cached
+#define MEMO_MAX_LINE 4096
+
+/**
+ * Create the table
+ * @param entries Entries to keep, at least MEMO_SHARDS
+ * @return NULL on success, error message on failure
+ */
+const char* memo_start(size_t entries);
+
+/**
+ * Free the table (no-op when it was not started)
+ */
+void memo_stop(void);
+
+/**
+ * Whether memo_start succeeded
+ * @return Non-zero when the table exists
+ */
+int memo_enabled(void);
+
+/**
+ * Hash a line
+ * @param data Bytes
+ * @param len Number of bytes
+ * @return 64-bit hash
+ */
+uint64_t memo_hash(const char* data, size_t len);
+
+/**
+ * Replace a line by a run's cached output for it
+ * @param run Run the output belongs to (its first stage's index)
+ * @param hash memo_hash of the line
+ * @param msg Line; rewritten on a hit
+ * @return 1 on a hit, 0 on a miss (msg unchanged)
+ */
+int memo_lookup(int run, uint64_t hash, message_t* msg);
+
+/**
+ * Remember a run's output for an input line
+ * @param run Run the output belongs to
+ * @param hash memo_hash of the input
+ * @param input Input bytes
+ * @param input_len Number of input bytes
+ * @param output The run's output for it
+ */
+void memo_store(int run, uint64_t hash, const char* input, size_t input_len, const message_t* output);
+
+/**
+ * Sample the table's counters
+ * @param stats Filled with the snapshot
+ */
+void memo_get_stats(cache_stats_t* stats);
+
+#endif /* MEMO_H */
@@ -0,0 +1,221 @@
+#define _GNU_SOURCE
+#include "msg_alloc.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define MSG_CLASS_COUNT   11          /* 64 B .. 64 KiB */
+#define MSG_MIN_SHIFT     6
+#define MSG_LARGE_CLASS   0xffffu
+#define MSG_SLAB_BYTES    (256u * 1024u)
+#define MSG_REMOTE_BATCH  32          /* cross-thread frees handed back at once */
+#define MSG_REMOTE_SLOTS  4           /* distinct owners a thread batches for */
+
+typedef struct msg_cache msg_cache_t;
+
+/* Header in front of every block; 16 bytes keeps payloads 16-byte aligned */
+typedef struct block {
+    union {
+        msg_cache_t* owner;           /* while allocated */
+        struct block* next;           /* while on a free list */
+    };
+    uint32_t size_class;
+    uint32_t reserved;
+} block_t;
+
+typedef struct {
+    msg_cache_t* owner;
+    block_t* head;
+    block_t* tail;
+    int count;
+} remote_batch_t;
+
+struct msg_cache {
+    block_t* free_list[MSG_CLASS_COUNT];
+    char* bump[MSG_CLASS_COUNT];
+    char* bump_end[MSG_CLASS_COUNT];
+    remote_batch_t pending[MSG_REMOTE_SLOTS];   /* frees owed to other caches */
+    int next_victim;
+    _Alignas(64) _Atomic(block_t*) remote;      /* blocks other threads returned */
+    msg_cache_t* next_orphan;
+};
+
+static _Thread_local msg_cache_t* tls_cache;
+
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t cache_key;
+static pthread_mutex_t orphan_lock = PTHREAD_MUTEX_INITIALIZER;
+static msg_cache_t* orphans;
+
+static size_t class_size(unsigned size_class) {
+    return (size_t)1 << (size_class + MSG_MIN_SHIFT);
+}
+
+static int class_for(size_t total) {
+    for (unsigned c = 0; c < MSG_CLASS_COUNT; c++) {
+        if (total <= class_size(c)) return (int)c;
+    }
+    return -1;
+}
+
+static void push_remote(msg_cache_t* owner, block_t* head, block_t* tail) {
+    block_t* old = atomic_load_explicit(&owner->remote, memory_order_relaxed);
+    do {
+        tail->next = old;
+    } while (!atomic_compare_exchange_weak_explicit(&owner->remote, &old, head,
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+static void flush_slot(remote_batch_t* slot) {
+    if (slot->count > 0) {
+        push_remote(slot->owner, slot->head, slot->tail);
+    }
+    slot->owner = NULL;
+    slot->head = slot->tail = NULL;
+    slot->count = 0;
+}
+
+static void flush_pending(msg_cache_t* cache) {
+    for (int i = 0; i < MSG_REMOTE_SLOTS; i++) {
+        flush_slot(&cache->pending[i]);
+    }
+}
+
+/* Thread exit: return what we owe and park the cache for the next thread */
+static void cache_release(void* arg) {
+    msg_cache_t* cache = arg;
+    flush_pending(cache);
+    tls_cache = NULL;
+    pthread_mutex_lock(&orphan_lock);
+    cache->next_orphan = orphans;
+    orphans = cache;
+    pthread_mutex_unlock(&orphan_lock);
+}
+
+static void make_key(void) {
+    pthread_key_create(&cache_key, cache_release);
+}
+
+static msg_cache_t* cache_get(void) {
+    msg_cache_t* cache = tls_cache;
+    if (cache) return cache;
+
+    pthread_once(&key_once, make_key);
+    pthread_mutex_lock(&orphan_lock);
+    cache = orphans;
+    if (cache) orphans = cache->next_orphan;
+    pthread_mutex_unlock(&orphan_lock);
+
+    if (!cache) {
+        cache = mmap(NULL, sizeof *cache, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (cache == MAP_FAILED) return NULL;
+        atomic_init(&cache->remote, NULL);
+    }
+    cache->next_orphan = NULL;
+    tls_cache = cache;
+    pthread_setspecific(cache_key, cache);
+    return cache;
+}
+
+/* Move blocks other threads handed back onto the local free lists */
+static int drain_remote(msg_cache_t* cache) {
+    block_t* b = atomic_exchange_explicit(&cache->remote, NULL, memory_order_acquire);
+    int drained = 0;
+    while (b) {
+        block_t* next = b->next;
+        b->next = cache->free_list[b->size_class];
+        cache->free_list[b->size_class] = b;
+        b = next;
+        drained = 1;
+    }
+    return drained;
+}
+
+static int refill_slab(msg_cache_t* cache, unsigned c) {
+    size_t bytes = class_size(c) * 8;
+    if (bytes < MSG_SLAB_BYTES) bytes = MSG_SLAB_BYTES;
+    char* slab = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (slab == MAP_FAILED) return -1;
+    cache->bump[c] = slab;
+    cache->bump_end[c] = slab + bytes;
+    return 0;
+}
+
+void* msg_alloc(size_t size, size_t* usable) {
+    int c = class_for(size + sizeof(block_t));
+    if (c < 0) {
+        block_t* b = malloc(sizeof(block_t) + size);
+        if (!b) return NULL;
+        b->owner = NULL;
+        b->size_class = MSG_LARGE_CLASS;
+        if (usable) *usable = size;
+        return b + 1;
+    }
+
+    msg_cache_t* cache = cache_get();
+    if (!cache) return NULL;
+    block_t* b = cache->free_list[c];
+    if (!b && drain_remote(cache)) {
+        b = cache->free_list[c];
+    }
+    if (b) {
+        cache->free_list[c] = b->next;
+    } else {
+        if (cache->bump[c] == cache->bump_end[c] && refill_slab(cache, (unsigned)c) != 0) {
+            return NULL;
+        }
+        b = (block_t*)cache->bump[c];
+        cache->bump[c] += class_size((unsigned)c);
+    }
+    b->owner = cache;
+    b->size_class = (uint32_t)c;
+    if (usable) *usable = class_size((unsigned)c) - sizeof(block_t);
+    return b + 1;
+}
+
+void msg_free(void* ptr) {
+    if (!ptr) return;
+    block_t* b = (block_t*)ptr - 1;
+    if (b->size_class == MSG_LARGE_CLASS) {
+        free(b);
+        return;
+    }
+
+    msg_cache_t* owner = b->owner;
+    msg_cache_t* cache = cache_get();
+    if (cache == owner) {
+        b->next = owner->free_list[b->size_class];
+        owner->free_list[b->size_class] = b;
+        return;
+    }
+    if (!cache) {
+        push_remote(owner, b, b);
+        return;
+    }
+
+    remote_batch_t* slot = NULL;
+    for (int i = 0; i < MSG_REMOTE_SLOTS; i++) {
+        if (cache->pending[i].owner == owner) {
+            slot = &cache->pending[i];
+            break;
+        }
+        if (!slot && cache->pending[i].owner == NULL) {
+            slot = &cache->pending[i];
+        }
+    }
+    if (!slot) {
+        slot = &cache->pending[cache->next_victim];
+        cache->next_victim = (cache->next_victim + 1) % MSG_REMOTE_SLOTS;
+        flush_slot(slot);
+    }
+    slot->owner = owner;
+    b->next = slot->head;
+    slot->head = b;
+    if (!slot->tail) slot->tail = b;
+    if (++slot->count >= MSG_REMOTE_BATCH) {
+        flush_slot(slot);
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef MSG_ALLOC_H
+#define MSG_ALLOC_H
+
+#include <stddef.h>
+
+/**
+ * Pipeline-wide message allocator.
+ * Size-classed blocks are carved from mmap'd slabs into per-thread caches.
+ * A block freed by a thread other than its owner is parked in a small
+ * per-owner batch and handed back with a single CAS once the batch fills,
+ * so the common "allocate on ingest, free at the sink" pattern never goes
+ * near the system allocator once the caches are warm. Requests above the
+ * largest class fall back to malloc.
+ */
+
+/**
+ * Allocate a block
+ * @param size Requested bytes
+ * @param usable Receives the usable size (may be NULL)
+ * @return Block or NULL on failure
+ */
+void* msg_alloc(size_t size, size_t* usable);
+
+/**
+ * Free a block from msg_alloc, from any thread
+ * @param ptr Block (may be NULL)
+ */
+void msg_free(void* ptr);
+
+#endif /* MSG_ALLOC_H */
@@ -0,0 +1,615 @@
+#define _POSIX_C_SOURCE 200809L
+#include "output.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "uring.h"
+
+#define OUTPUT_IOV_MAX     1024   /* buffers per writev() */
+#define OUTPUT_FREE_BLOCKS 64     /* recycled threshold-sized blocks */
+#define OUTPUT_MAX_PENDING 16     /* sealed buffers (in thresholds) before writers wait */
+#define OUTPUT_URING_DEPTH 4      /* registered staging buffers in flight (--io=uring) */
+#define OUTPUT_URING_SLOT  (1024 * 1024)
+
+/* A buffer's memory; sealed blocks queue up for the writer in FIFO order */
+typedef struct output_block {
+    struct output_block* next;
+    size_t len;
+    size_t cap;
+    char data[];
+} output_block_t;
+
+/* A registered staging buffer: filled by the writer, then written by the kernel */
+typedef struct {
+    size_t len;
+    size_t done;               /* bytes the kernel has written so far */
+    uint64_t offset;
+    int busy;
+} output_slot_t;
+
+/* One thread's buffer; kept for reuse by a later thread when its owner exits */
+typedef struct output_buffer {
+    pthread_mutex_t lock;      /* owner appends, the writer seals on linger */
+    output_block_t* block;     /* being filled; NULL until the next record */
+    int owned;
+    struct output_buffer* next;
+} output_buffer_t;
+
+static struct {
+    int fd;
+    output_policy_t policy;
+    atomic_int running;
+    pthread_t thread;
+    pthread_key_t key;         /* releases a thread's buffer when it exits */
+
+    pthread_mutex_t lock;      /* everything below */
+    pthread_cond_t wake;       /* writer: sealed blocks, dirty buffers or stop */
+    pthread_cond_t drained;    /* flushers and held-back writers */
+    output_block_t* head;
+    output_block_t* tail;
+    size_t pending_bytes;
+    int writing;               /* the writer holds blocks taken off the queue */
+    int stop;
+    int failed;                /* the fd stopped accepting data; output is dropped */
+    output_block_t* free_blocks;
+    int free_count;
+
+    atomic_int dirty;          /* a buffer went from empty to non-empty */
+
+    pthread_mutex_t registry_lock;
+    output_buffer_t* buffers;
+
+    /* --io=uring, used by the writer thread only */
+    int uring;
+    uring_t ring;
+    char* staging;
+    output_slot_t slots[OUTPUT_URING_DEPTH];
+    int depth;                 /* 1 unless writes carry their own offsets */
+    int fill;                  /* slot being filled */
+    int seekable;
+    uint64_t offset;           /* where the next slot goes */
+    int positioned;            /* offset is taken from the fd until the writer next goes idle */
+    int uring_failed;
+} out = {
+    .fd = STDOUT_FILENO,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .registry_lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static _Thread_local output_buffer_t* local_buffer;
+
+int output_policy_parse(const char* spec, output_policy_t* policy) {
+    char* end = NULL;
+    if (strcmp(spec, "end") == 0) {
+        policy->mode = OUTPUT_FLUSH_END;
+        policy->threshold = OUTPUT_END_THRESHOLD;
+        policy->linger_ms = 0;
+        return 0;
+    }
+    if (strncmp(spec, "size:", 5) == 0) {
+        long long bytes = strtoll(spec + 5, &end, 10);
+        if (end == spec + 5 || *end != '\0' || bytes < 1 || bytes > (1LL << 30)) {
+            return -1;
+        }
+        policy->mode = OUTPUT_FLUSH_SIZE;
+        policy->threshold = (size_t)bytes;
+        policy->linger_ms = 0;
+        return 0;
+    }
+    if (strncmp(spec, "linger:", 7) == 0) {
+        long ms = strtol(spec + 7, &end, 10);
+        if (end == spec + 7 || *end != '\0' || ms < 0 || ms > 60000) {
+            return -1;
+        }
+        policy->mode = OUTPUT_FLUSH_LINGER;
+        policy->threshold = OUTPUT_DEFAULT_THRESHOLD;
+        policy->linger_ms = (unsigned)ms;
+        return 0;
+    }
+    return -1;
+}
+
+/* Write every byte of iov, or give up when the fd fails */
+static int write_all(int fd, struct iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, count);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+    return 0;
+}
+
+static output_block_t* block_get(size_t min) {
+    size_t cap = min > out.policy.threshold ? min : out.policy.threshold;
+    if (cap == out.policy.threshold) {
+        pthread_mutex_lock(&out.lock);
+        output_block_t* block = out.free_blocks;
+        if (block) {
+            out.free_blocks = block->next;
+            out.free_count--;
+        }
+        pthread_mutex_unlock(&out.lock);
+        if (block) {
+            block->len = 0;
+            return block;
+        }
+    }
+    output_block_t* block = malloc(sizeof(output_block_t) + cap);
+    if (block) {
+        block->len = 0;
+        block->cap = cap;
+    }
+    return block;
+}
+
+/* Queue a buffer's block for the writer (buffer lock held, keeps per-buffer order) */
+static void seal(output_buffer_t* buf) {
+    output_block_t* block = buf->block;
+    buf->block = NULL;
+    if (!block) return;
+    block->next = NULL;
+    pthread_mutex_lock(&out.lock);
+    if (out.tail) {
+        out.tail->next = block;
+    } else {
+        out.head = block;
+    }
+    out.tail = block;
+    out.pending_bytes += block->len;
+    pthread_cond_signal(&out.wake);
+    pthread_mutex_unlock(&out.lock);
+}
+
+static void seal_all(void) {
+    pthread_mutex_lock(&out.registry_lock);
+    for (output_buffer_t* buf = out.buffers; buf; buf = buf->next) {
+        pthread_mutex_lock(&buf->lock);
+        if (buf->block && buf->block->len > 0) {
+            seal(buf);
+        }
+        pthread_mutex_unlock(&buf->lock);
+    }
+    pthread_mutex_unlock(&out.registry_lock);
+}
+
+/* Thread exit: hand the rest of its output to the writer and free the buffer for reuse */
+static void release_buffer(void* arg) {
+    output_buffer_t* buf = (output_buffer_t*)arg;
+    pthread_mutex_lock(&buf->lock);
+    if (buf->block && buf->block->len > 0) {
+        seal(buf);
+    }
+    pthread_mutex_unlock(&buf->lock);
+    pthread_mutex_lock(&out.registry_lock);
+    buf->owned = 0;
+    pthread_mutex_unlock(&out.registry_lock);
+}
+
+static output_buffer_t* get_local_buffer(void) {
+    if (local_buffer) {
+        return local_buffer;
+    }
+    pthread_mutex_lock(&out.registry_lock);
+    output_buffer_t* buf = out.buffers;
+    while (buf && buf->owned) {
+        buf = buf->next;
+    }
+    if (!buf) {
+        buf = calloc(1, sizeof(output_buffer_t));
+        if (buf) {
+            pthread_mutex_init(&buf->lock, NULL);
+            buf->next = out.buffers;
+            out.buffers = buf;
+        }
+    }
+    if (buf) {
+        buf->owned = 1;
+        pthread_setspecific(out.key, buf);
+    }
+    pthread_mutex_unlock(&out.registry_lock);
+    local_buffer = buf;
+    return buf;
+}
+
+const char* output_use_uring(int fd) {
+    if (atomic_load(&out.running) || out.uring) {
+        return "Output writer already running";
+    }
+    struct stat st;
+    int flags = fcntl(fd, F_GETFL);
+    if (fstat(fd, &st) != 0 || flags < 0) {
+        return "Cannot inspect the output";
+    }
+    // Writes to the file position (pipes, ttys, O_APPEND) could overtake each other: one at a time
+    out.seekable = S_ISREG(st.st_mode) && !(flags & O_APPEND);
+    out.depth = out.seekable ? OUTPUT_URING_DEPTH : 1;
+    size_t size = (size_t)OUTPUT_URING_DEPTH * OUTPUT_URING_SLOT;
+    out.staging = aligned_alloc(4096, size);
+    if (!out.staging) {
+        return "Memory allocation failed";
+    }
+    struct iovec buffers[OUTPUT_URING_DEPTH];
+    for (int i = 0; i < OUTPUT_URING_DEPTH; i++) {
+        buffers[i].iov_base = out.staging + (size_t)i * OUTPUT_URING_SLOT;
+        buffers[i].iov_len = OUTPUT_URING_SLOT;
+    }
+    const char* err = uring_init(&out.ring, OUTPUT_URING_DEPTH, fd, buffers, OUTPUT_URING_DEPTH);
+    if (err) {
+        free(out.staging);
+        out.staging = NULL;
+        return err;
+    }
+    memset(out.slots, 0, sizeof out.slots);
+    out.fd = fd;
+    out.fill = 0;
+    out.uring_failed = 0;
+    out.uring = 1;
+    return NULL;
+}
+
+static void uring_release(void) {
+    if (!out.uring) {
+        return;
+    }
+    uring_free(&out.ring);
+    free(out.staging);
+    out.staging = NULL;
+    out.uring = 0;
+}
+
+static void uring_send(int index) {
+    output_slot_t* s = &out.slots[index];
+    uint64_t offset = out.seekable ? s->offset + s->done : (uint64_t)-1;
+    // Each slot has at most one request in flight, so the queue has room
+    (void)uring_queue(&out.ring, 1, (unsigned)index, out.staging + (size_t)index * OUTPUT_URING_SLOT + s->done,
+                      (unsigned)(s->len - s->done), offset, (uint64_t)index);
+}
+
+/* Wait for at least one write to complete; a short one goes again for the rest */
+static void uring_reap(void) {
+    if (uring_submit(&out.ring, 1) < 0) {
+        // The ring is unusable: nothing more completes, so nothing is waited for
+        out.uring_failed = 1;
+        for (int i = 0; i < OUTPUT_URING_DEPTH; i++) {
+            out.slots[i].busy = 0;
+            out.slots[i].len = 0;
+        }
+        return;
+    }
+    uint64_t index;
+    int res;
+    while (uring_complete(&out.ring, &index, &res)) {
+        output_slot_t* s = &out.slots[index];
+        if (res == -EINTR || res == -EAGAIN) {
+            res = 0;
+        } else if (res <= 0) {
+            out.uring_failed = 1;
+            s->done = s->len;
+        }
+        s->done += (size_t)(res > 0 ? res : 0);
+        if (s->done < s->len && !out.uring_failed) {
+            uring_send((int)index);
+            continue;
+        }
+        s->busy = 0;
+        s->len = 0;
+    }
+}
+
+/* Hand the slot being filled to the kernel and move on to the next one */
+static void uring_flush_slot(void) {
+    output_slot_t* s = &out.slots[out.fill];
+    if (s->len == 0) {
+        return;
+    }
+    s->busy = 1;
+    s->done = 0;
+    s->offset = out.offset;
+    out.offset += s->len;
+    uring_send(out.fill);
+    (void)uring_submit(&out.ring, 0);
+    out.fill = (out.fill + 1) % out.depth;
+}
+
+/* Copy iov into staging buffers, submitting each one as it fills */
+static int uring_write(const struct iovec* iov, int count) {
+    if (out.seekable && !out.positioned) {
+        off_t pos = lseek(out.fd, 0, SEEK_CUR);
+        out.offset = pos < 0 ? 0 : (uint64_t)pos;
+        out.positioned = 1;
+    }
+    for (int i = 0; i < count && !out.uring_failed; i++) {
+        const char* src = iov[i].iov_base;
+        size_t left = iov[i].iov_len;
+        while (left > 0 && !out.uring_failed) {
+            output_slot_t* s = &out.slots[out.fill];
+            if (s->busy) {
+                uring_reap();
+                continue;
+            }
+            size_t n = OUTPUT_URING_SLOT - s->len < left ? OUTPUT_URING_SLOT - s->len : left;
+            memcpy(out.staging + (size_t)out.fill * OUTPUT_URING_SLOT + s->len, src, n);
+            s->len += n;
+            src += n;
+            left -= n;
+            if (s->len == OUTPUT_URING_SLOT) {
+                uring_flush_slot();
+            }
+        }
+    }
+    return out.uring_failed ? -1 : 0;
+}
+
+/* Submit the partial slot and wait for every write in flight */
+static int uring_finish(void) {
+    if (!out.uring_failed) {
+        uring_flush_slot();
+    }
+    for (int i = 0; i < OUTPUT_URING_DEPTH; i++) {
+        while (out.slots[i].busy) {
+            uring_reap();
+        }
+    }
+    // Later plain writes to the fd (after the writer stops) continue where these ended
+    if (out.positioned && !out.uring_failed) {
+        (void)lseek(out.fd, (off_t)out.offset, SEEK_SET);
+    }
+    out.positioned = 0;
+    return out.uring_failed ? -1 : 0;
+}
+
+static void write_blocks(output_block_t* list) {
+    struct iovec iov[OUTPUT_IOV_MAX];
+    while (list) {
+        int count = 0;
+        output_block_t* last = list;
+        for (output_block_t* b = list; b && count < OUTPUT_IOV_MAX; b = b->next) {
+            iov[count].iov_base = b->data;
+            iov[count].iov_len = b->len;
+            count++;
+            last = b;
+        }
+        // Only this thread sets failed, so it can read it unlocked. Under --io=uring the
+        // blocks are copied to staging buffers, so they are recycled while the kernel writes
+        int failed = out.failed || (out.uring ? uring_write(iov, count) : write_all(out.fd, iov, count)) != 0;
+
+        output_block_t* rest = last->next;
+        pthread_mutex_lock(&out.lock);
+        out.failed = failed;
+        for (output_block_t* b = list; b != rest;) {
+            output_block_t* next = b->next;
+            out.pending_bytes -= b->len;
+            if (b->cap == out.policy.threshold && out.free_count < OUTPUT_FREE_BLOCKS) {
+                b->next = out.free_blocks;
+                out.free_blocks = b;
+                out.free_count++;
+            } else {
+                free(b);
+            }
+            b = next;
+        }
+        pthread_cond_broadcast(&out.drained);
+        pthread_mutex_unlock(&out.lock);
+        list = rest;
+    }
+}
+
+static void* writer_main(void* arg) {
+    (void)arg;
+    int lingering = 0;
+    struct timespec deadline;
+    pthread_mutex_lock(&out.lock);
+    for (;;) {
+        if (out.head) {
+            output_block_t* list = out.head;
+            out.head = out.tail = NULL;
+            out.writing = 1;
+            pthread_mutex_unlock(&out.lock);
+            write_blocks(list);
+            pthread_mutex_lock(&out.lock);
+            if (out.uring && !out.head) {
+                // Nothing more to copy: the rest of the staged output goes now,
+                // and flushers wait for it
+                pthread_mutex_unlock(&out.lock);
+                int failed = uring_finish() != 0;
+                pthread_mutex_lock(&out.lock);
+                out.failed |= failed;
+            }
+            out.writing = 0;
+            pthread_cond_broadcast(&out.drained);
+            continue;
+        }
+        if (out.stop) {
+            break;
+        }
+        if (out.policy.mode == OUTPUT_FLUSH_LINGER && atomic_load(&out.dirty)) {
+            // Give partially filled buffers linger_ms to fill up, then seal them
+            if (!lingering) {
+                clock_gettime(CLOCK_MONOTONIC, &deadline);
+                deadline.tv_sec += out.policy.linger_ms / 1000;
+                deadline.tv_nsec += (long)(out.policy.linger_ms % 1000) * 1000000L;
+                if (deadline.tv_nsec >= 1000000000L) {
+                    deadline.tv_sec++;
+                    deadline.tv_nsec -= 1000000000L;
+                }
+                lingering = 1;
+            }
+            if (pthread_cond_timedwait(&out.wake, &out.lock, &deadline) == ETIMEDOUT) {
+                lingering = 0;
+                atomic_store(&out.dirty, 0);
+                pthread_mutex_unlock(&out.lock);
+                seal_all();
+                pthread_mutex_lock(&out.lock);
+            }
+            continue;
+        }
+        pthread_cond_wait(&out.wake, &out.lock);
+    }
+    pthread_mutex_unlock(&out.lock);
+    return NULL;
+}
+
+const char* output_start(int fd, const output_policy_t* policy) {
+    if (atomic_load(&out.running)) {
+        return "Output writer already running";
+    }
+    if (out.uring && fd != out.fd) {
+        uring_release();
+    }
+    out.fd = fd;
+    if (policy) {
+        out.policy = *policy;
+    } else {
+        out.policy.mode = OUTPUT_FLUSH_LINGER;
+        out.policy.threshold = OUTPUT_DEFAULT_THRESHOLD;
+        out.policy.linger_ms = OUTPUT_DEFAULT_LINGER_MS;
+    }
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&out.wake, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&out.drained, NULL);
+    if (pthread_key_create(&out.key, release_buffer) != 0) {
+        uring_release();
+        return "Failed to create output buffer key";
+    }
+    // Anything already sitting in stdio goes out before the writer's data
+    fflush(stdout);
+    out.stop = 0;
+    if (pthread_create(&out.thread, NULL, writer_main, NULL) != 0) {
+        pthread_key_delete(out.key);
+        uring_release();
+        return "Failed to start output writer";
+    }
+    atomic_store(&out.running, 1);
+    return NULL;
+}
+
+void output_write(const struct iovec* parts, int count) {
+    size_t total = 0;
+    for (int i = 0; i < count; i++) {
+        total += parts[i].iov_len;
+    }
+    output_buffer_t* buf = atomic_load(&out.running) ? get_local_buffer() : NULL;
+    if (!buf) {
+        for (int i = 0; i < count; i++) {
+            struct iovec part = parts[i];
+            (void)write_all(out.fd, &part, 1);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&buf->lock);
+    output_block_t* block = buf->block;
+    if (block && block->len + total > block->cap) {
+        seal(buf);
+        block = NULL;
+    }
+    if (!block) {
+        block = block_get(total);
+        if (!block) {
+            pthread_mutex_unlock(&buf->lock);
+            return;
+        }
+        buf->block = block;
+    }
+    int was_empty = block->len == 0;
+    for (int i = 0; i < count; i++) {
+        memcpy(block->data + block->len, parts[i].iov_base, parts[i].iov_len);
+        block->len += parts[i].iov_len;
+    }
+    int sealed = block->len >= out.policy.threshold;
+    if (sealed) {
+        seal(buf);
+    }
+    pthread_mutex_unlock(&buf->lock);
+
+    if (was_empty && !sealed && out.policy.mode == OUTPUT_FLUSH_LINGER &&
+        atomic_exchange(&out.dirty, 1) == 0) {
+        pthread_mutex_lock(&out.lock);
+        pthread_cond_signal(&out.wake);
+        pthread_mutex_unlock(&out.lock);
+    }
+    if (sealed) {
+        // Hold back while the fd is far behind
+        size_t limit = OUTPUT_MAX_PENDING * out.policy.threshold;
+        pthread_mutex_lock(&out.lock);
+        while (out.pending_bytes > limit && !out.failed && !out.stop) {
+            pthread_cond_wait(&out.drained, &out.lock);
+        }
+        pthread_mutex_unlock(&out.lock);
+    }
+}
+
+void output_cut(void) {
+    if (!atomic_load(&out.running)) {
+        return;
+    }
+    seal_all();
+}
+
+void output_flush(void) {
+    if (!atomic_load(&out.running)) {
+        return;
+    }
+    seal_all();
+    pthread_mutex_lock(&out.lock);
+    while (out.head || out.writing) {
+        pthread_cond_wait(&out.drained, &out.lock);
+    }
+    pthread_mutex_unlock(&out.lock);
+}
+
+void output_stop(void) {
+    if (!atomic_load(&out.running)) {
+        return;
+    }
+    output_flush();
+    pthread_mutex_lock(&out.lock);
+    out.stop = 1;
+    pthread_cond_signal(&out.wake);
+    pthread_mutex_unlock(&out.lock);
+    pthread_join(out.thread, NULL);
+    atomic_store(&out.running, 0);
+
+    // Callers stop the writer once the writing threads are gone
+    pthread_key_delete(out.key);
+    pthread_mutex_lock(&out.registry_lock);
+    while (out.buffers) {
+        output_buffer_t* buf = out.buffers;
+        out.buffers = buf->next;
+        free(buf->block);
+        pthread_mutex_destroy(&buf->lock);
+        free(buf);
+    }
+    pthread_mutex_unlock(&out.registry_lock);
+    while (out.free_blocks) {
+        output_block_t* block = out.free_blocks;
+        out.free_blocks = block->next;
+        free(block);
+    }
+    out.free_count = 0;
+    uring_release();
+    local_buffer = NULL;
+    pthread_cond_destroy(&out.wake);
+    pthread_cond_destroy(&out.drained);
+}
@@ -0,0 +1,91 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stddef.h>
+#include <sys/uio.h>
+
+/**
+ * Buffered output writer behind the logging stages.
+ * Every thread appends records to its own buffer, so stages never share a
+ * lock per line. A buffer that reaches the flush threshold is sealed and
+ * queued, and a writer thread writes queued buffers with one writev().
+ * Records from one thread keep their order; records from different
+ * threads interleave by buffer. Writers that get too far ahead of the fd
+ * are held back.
+ */
+
+typedef enum {
+    OUTPUT_FLUSH_SIZE,      /* write a buffer once it holds threshold bytes */
+    OUTPUT_FLUSH_LINGER,    /* ... and anything buffered after linger_ms */
+    OUTPUT_FLUSH_END,       /* hold everything until <END> (buffers that fill up still go out) */
+} output_flush_mode_t;
+
+typedef struct {
+    output_flush_mode_t mode;
+    size_t threshold;       /* bytes per buffer before it is written */
+    unsigned linger_ms;     /* OUTPUT_FLUSH_LINGER: longest a record waits */
+} output_policy_t;
+
+// Defaults: linger:10 with 64 KiB buffers
+#define OUTPUT_DEFAULT_THRESHOLD (64 * 1024)
+#define OUTPUT_DEFAULT_LINGER_MS 10
+
+// Buffer size for OUTPUT_FLUSH_END
+#define OUTPUT_END_THRESHOLD (1024 * 1024)
+
+/**
+ * Parse a flush policy: "size:BYTES", "linger:MS" or "end"
+ * @param spec Policy text
+ * @param policy Filled on success
+ * @return 0 on success, -1 on a malformed spec
+ */
+int output_policy_parse(const char* spec, output_policy_t* policy);
+
+/**
+ * Have the writer thread write through io_uring (--io=uring): buffers are
+ * copied into registered staging buffers and written with WRITE_FIXED on
+ * the fd registered as a fixed file, several at once to a regular file
+ * (at explicit offsets) and one at a time to anything else. The writer
+ * recycles the buffers as soon as they are copied and waits for the
+ * kernel only when every staging buffer is in flight, or before it goes
+ * idle. Call it before output_start with the same fd.
+ * @param fd Destination file descriptor
+ * @return NULL on success, or why io_uring cannot be used (output then
+ *         goes out with writev() as usual)
+ */
+const char* output_use_uring(int fd);
+
+/**
+ * Start the writer thread
+ * @param fd Destination file descriptor
+ * @param policy Flush policy (NULL for the default)
+ * @return NULL on success, error message on failure
+ */
+const char* output_start(int fd, const output_policy_t* policy);
+
+/**
+ * Append one record, the concatenation of parts, to this thread's buffer.
+ * Writes straight to the fd when the writer is not running.
+ * @param parts Record pieces
+ * @param count Number of pieces
+ */
+void output_write(const struct iovec* parts, int count);
+
+/**
+ * Hand everything buffered by every thread to the writer now, without
+ * waiting for it to be written (a BARRIER reaching the end of the chain)
+ */
+void output_cut(void);
+
+/**
+ * Write everything buffered by every thread and wait until it is out
+ */
+void output_flush(void);
+
+/**
+ * Flush, stop the writer thread and free the buffers. Call it after the
+ * threads that wrote output have exited.
+ */
+void output_stop(void);
+
+#endif /* OUTPUT_H */
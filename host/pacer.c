@@ -0,0 +1,349 @@
+#define _POSIX_C_SOURCE 200809L
+#include "pacer.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include "stats.h"
+
+// Lines released per handoff to the stage
+#define PACER_BATCH 64
+
+struct pacer_stage {
+    pthread_mutex_t lock;
+    pthread_cond_t room;        /* signalled when the FIFO shrinks */
+    message_sink_t next;
+    pacer_unit_t unit;
+    double rate;                /* tokens per second */
+    double burst;
+    double tokens;              /* may go negative: a line costlier than the burst overdraws */
+    uint64_t refilled_ns;
+    message_t** fifo;           /* lines waiting for tokens, in order */
+    int capacity;
+    int head;
+    int count;
+    int forwarding;             /* someone is handing lines to next: the others must not overtake */
+    int scheduled;              /* on the wheel */
+    /* Wheel linkage, under pacer.lock */
+    uint64_t due;               /* tick the stage is released at */
+    pacer_stage_t* wheel_next;
+};
+
+static struct {
+    pthread_mutex_t lock;
+    pacer_stage_t* slots[PACER_SLOTS];
+    uint64_t base_ns;           /* time of tick 0 */
+    uint64_t tick;              /* last tick processed */
+    uint64_t armed;             /* tick the timerfd fires at; UINT64_MAX: disarmed */
+    int fd;
+    int stopping;
+    atomic_int running;
+    pthread_t thread;
+} pacer = { .lock = PTHREAD_MUTEX_INITIALIZER, .fd = -1 };
+
+int pacer_rate_parse(const char* spec, pacer_rate_t* rate) {
+    char* end = NULL;
+    errno = 0;
+    unsigned long long n = strtoull(spec, &end, 10);
+    if (end == spec || errno != 0 || n == 0 || spec[0] == '-') {
+        return -1;
+    }
+    if (*end == 'B' && end[1] == '\0') {
+        rate->unit = PACER_BYTES;
+    } else if (*end == '\0') {
+        rate->unit = PACER_LINES;
+    } else {
+        return -1;
+    }
+    rate->rate = n;
+    return 0;
+}
+
+/* Arm the timerfd for a tick (pacer.lock held) */
+static void arm(uint64_t tick) {
+    uint64_t at = pacer.base_ns + tick * PACER_TICK_NS;
+    struct itimerspec spec = { { 0, 0 }, { (time_t)(at / 1000000000ull), (long)(at % 1000000000ull) } };
+    if (timerfd_settime(pacer.fd, TFD_TIMER_ABSTIME, &spec, NULL) == 0) {
+        pacer.armed = tick;
+    }
+}
+
+/* File a stage under the tick it is due (pacer.lock held); stages are never cancelled */
+static void wheel_insert(pacer_stage_t* s, uint64_t delay_ns) {
+    uint64_t now = stats_now_ns();
+    uint64_t due = (now + delay_ns - pacer.base_ns + PACER_TICK_NS - 1) / PACER_TICK_NS;
+    if (due <= pacer.tick) {
+        due = pacer.tick + 1;
+    }
+    s->due = due;
+    pacer_stage_t** slot = &pacer.slots[due % PACER_SLOTS];
+    s->wheel_next = *slot;
+    *slot = s;
+    if (due < pacer.armed) {
+        arm(due);
+    }
+}
+
+/* Tokens a line takes */
+static double cost(const pacer_stage_t* s, const message_t* msg) {
+    if (msg->kind != MESSAGE_DATA) {
+        return 0;
+    }
+    return s->unit == PACER_BYTES ? (double)msg->len : 1;
+}
+
+static void refill(pacer_stage_t* s) {
+    uint64_t now = stats_now_ns();
+    s->tokens += (double)(now - s->refilled_ns) * s->rate / 1e9;
+    if (s->tokens > s->burst) {
+        s->tokens = s->burst;
+    }
+    s->refilled_ns = now;
+}
+
+/* Take the tokens for a line if the bucket has them (a full bucket always does) */
+static int admit(pacer_stage_t* s, const message_t* msg) {
+    double c = cost(s, msg);
+    if (c > 0 && s->tokens < (c < s->burst ? c : s->burst)) {
+        return 0;
+    }
+    s->tokens -= c;
+    return 1;
+}
+
+/* Nanoseconds until the first waiting line can go */
+static uint64_t head_delay(const pacer_stage_t* s) {
+    double c = cost(s, s->fifo[s->head]);
+    double need = (c < s->burst ? c : s->burst) - s->tokens;
+    return need > 0 ? (uint64_t)(need * 1e9 / s->rate) + 1 : 0;
+}
+
+/* Put the stage on the wheel for its first waiting line (s->lock held) */
+static void schedule(pacer_stage_t* s) {
+    if (s->count == 0 || s->scheduled || s->forwarding) {
+        return;
+    }
+    s->scheduled = 1;
+    pthread_mutex_lock(&pacer.lock);
+    wheel_insert(s, head_delay(s));
+    pthread_mutex_unlock(&pacer.lock);
+}
+
+/*
+ * Hand on every waiting line the bucket pays for (s->lock held, dropped
+ * while forwarding), unless someone else is already doing it
+ * @return Lines handed on
+ */
+static int drain(pacer_stage_t* s) {
+    message_t* batch[PACER_BATCH];
+    int total = 0;
+    while (!s->forwarding) {
+        refill(s);
+        int n = 0;
+        while (n < PACER_BATCH && s->count > 0 && admit(s, s->fifo[s->head])) {
+            batch[n++] = s->fifo[s->head];
+            s->head = (s->head + 1) % s->capacity;
+            s->count--;
+        }
+        if (n == 0) {
+            break;
+        }
+        s->forwarding = 1;
+        pthread_cond_broadcast(&s->room);
+        pthread_mutex_unlock(&s->lock);
+        const char* err = message_sink_place_batch(&s->next, batch, n);
+        if (err) {
+            fprintf(stderr, "[ERROR][pacer] - %s\n", err);
+        }
+        pthread_mutex_lock(&s->lock);
+        s->forwarding = 0;
+        total += n;
+    }
+    return total;
+}
+
+static const char* pace_place_batch(void* target, message_t** msgs, int count) {
+    pacer_stage_t* s = (pacer_stage_t*)target;
+    pthread_mutex_lock(&s->lock);
+    refill(s);
+    // Lines go straight on only while nothing is waiting ahead of them
+    int pass = 0;
+    if (s->count == 0 && !s->forwarding) {
+        while (pass < count && admit(s, msgs[pass])) {
+            pass++;
+        }
+    }
+    const char* err = NULL;
+    if (pass > 0) {
+        s->forwarding = 1;
+        pthread_mutex_unlock(&s->lock);
+        err = message_sink_place_batch(&s->next, msgs, pass);
+        pthread_mutex_lock(&s->lock);
+        s->forwarding = 0;
+    }
+    for (int i = pass; i < count; i++) {
+        while (s->count == s->capacity) {
+            if (drain(s) > 0) {
+                continue;
+            }
+            // Wait for the first line's tokens, or for whoever is forwarding
+            uint64_t until = stats_now_ns() + (s->forwarding ? PACER_TICK_NS : head_delay(s));
+            struct timespec deadline = { (time_t)(until / 1000000000ull), (long)(until % 1000000000ull) };
+            pthread_cond_timedwait(&s->room, &s->lock, &deadline);
+        }
+        s->fifo[(s->head + s->count) % s->capacity] = msgs[i];
+        s->count++;
+    }
+    // Lines queued behind one still being forwarded are left to its forwarder
+    schedule(s);
+    pthread_mutex_unlock(&s->lock);
+    return err;
+}
+
+static const char* pace_place(void* target, message_t* msg) {
+    return pace_place_batch(target, &msg, 1);
+}
+
+static void release(pacer_stage_t* s) {
+    pthread_mutex_lock(&s->lock);
+    s->scheduled = 0;
+    drain(s);
+    schedule(s);
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void* pacer_main(void* arg) {
+    (void)arg;
+    for (;;) {
+        uint64_t expirations;
+        if (read(pacer.fd, &expirations, sizeof expirations) < 0 && errno != EAGAIN && errno != EINTR) {
+            break;
+        }
+        pthread_mutex_lock(&pacer.lock);
+        if (pacer.stopping) {
+            pthread_mutex_unlock(&pacer.lock);
+            break;
+        }
+        // Visit the slots of every tick that has passed (each slot once, however late we are)
+        uint64_t now = (stats_now_ns() - pacer.base_ns) / PACER_TICK_NS;
+        uint64_t steps = now - pacer.tick < PACER_SLOTS ? now - pacer.tick : PACER_SLOTS;
+        pacer_stage_t* expired = NULL;
+        for (uint64_t k = 1; k <= steps; k++) {
+            pacer_stage_t** link = &pacer.slots[(pacer.tick + k) % PACER_SLOTS];
+            while (*link) {
+                pacer_stage_t* s = *link;
+                if (s->due > now) {
+                    link = &s->wheel_next;
+                    continue;
+                }
+                *link = s->wheel_next;
+                s->wheel_next = expired;
+                expired = s;
+            }
+        }
+        pacer.tick = now > pacer.tick ? now : pacer.tick;
+        uint64_t next = UINT64_MAX;
+        for (int slot = 0; slot < PACER_SLOTS; slot++) {
+            for (pacer_stage_t* s = pacer.slots[slot]; s; s = s->wheel_next) {
+                next = s->due < next ? s->due : next;
+            }
+        }
+        pacer.armed = UINT64_MAX;
+        if (next != UINT64_MAX) {
+            arm(next);
+        }
+        pthread_mutex_unlock(&pacer.lock);
+        while (expired) {
+            pacer_stage_t* s = expired;
+            expired = s->wheel_next;
+            release(s);
+        }
+    }
+    return NULL;
+}
+
+const char* pacer_start(void) {
+    if (atomic_load(&pacer.running)) {
+        return "Pacer already running";
+    }
+    pacer.fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (pacer.fd < 0) {
+        return "timerfd_create failed";
+    }
+    pacer.base_ns = stats_now_ns();
+    pacer.tick = 0;
+    pacer.armed = UINT64_MAX;
+    pacer.stopping = 0;
+    if (pthread_create(&pacer.thread, NULL, pacer_main, NULL) != 0) {
+        close(pacer.fd);
+        pacer.fd = -1;
+        return "Failed to start pacer thread";
+    }
+    atomic_store(&pacer.running, 1);
+    return NULL;
+}
+
+void pacer_stop(void) {
+    if (!atomic_load(&pacer.running)) {
+        return;
+    }
+    pthread_mutex_lock(&pacer.lock);
+    pacer.stopping = 1;
+    struct itimerspec now = { { 0, 0 }, { 0, 1 } };
+    timerfd_settime(pacer.fd, 0, &now, NULL);
+    pthread_mutex_unlock(&pacer.lock);
+    pthread_join(pacer.thread, NULL);
+    close(pacer.fd);
+    pacer.fd = -1;
+    atomic_store(&pacer.running, 0);
+}
+
+const char* pacer_stage_create(pacer_stage_t** stage, const pacer_rate_t* rate, int capacity,
+                               const message_sink_t* next, message_sink_t* sink) {
+    pacer_stage_t* s = calloc(1, sizeof *s);
+    if (!s) {
+        return "Memory allocation failed";
+    }
+    s->fifo = malloc((size_t)capacity * sizeof(message_t*));
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    int cond_err = pthread_cond_init(&s->room, &attr);
+    pthread_condattr_destroy(&attr);
+    if (!s->fifo || cond_err != 0 || pthread_mutex_init(&s->lock, NULL) != 0) {
+        if (cond_err == 0) {
+            pthread_cond_destroy(&s->room);
+        }
+        free(s->fifo);
+        free(s);
+        return "Memory allocation failed";
+    }
+    s->next = *next;
+    s->unit = rate->unit;
+    s->rate = (double)rate->rate;
+    s->burst = rate->burst ? (double)rate->burst : rate->rate >= 20 ? (double)(rate->rate / 10) : 1;
+    s->tokens = s->burst;
+    s->refilled_ns = stats_now_ns();
+    s->capacity = capacity;
+    *stage = s;
+    sink->place = pace_place;
+    sink->place_batch = pace_place_batch;
+    sink->target = s;
+    return NULL;
+}
+
+void pacer_stage_destroy(pacer_stage_t* stage) {
+    if (!stage) {
+        return;
+    }
+    for (int i = 0; i < stage->count; i++) {
+        message_free(stage->fifo[(stage->head + i) % stage->capacity]);
+    }
+    pthread_cond_destroy(&stage->room);
+    pthread_mutex_destroy(&stage->lock);
+    free(stage->fifo);
+    free(stage);
+}
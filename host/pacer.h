@@ -0,0 +1,77 @@
+#ifndef PACER_H
+#define PACER_H
+
+#include <stdint.h>
+#include "message.h"
+
+/**
+ * Rate limits for stages (name,rate=...), without a sleeping thread per
+ * stage. A paced stage gets a sink in front of its input holding a token
+ * bucket: a line that finds enough tokens goes straight on, and one that
+ * does not waits in the sink's FIFO, with every line behind it, until the
+ * bucket has refilled. One pacer thread serves every paced stage: it
+ * sleeps on a timerfd armed for the earliest release and keeps the
+ * releases on a hashed timer wheel (a stage is filed under the tick it is
+ * due, modulo the wheel size). A full FIFO holds its producer back as a
+ * full queue would; a producer that has to wait releases the lines that
+ * come due itself, so the pacer thread waiting on one stage's queue never
+ * holds up another stage's producer.
+ * <END>, <FLUSH> and <BARRIER> cost no tokens but keep their place.
+ */
+
+// Wheel resolution and size: releases are rounded up to a tick
+#define PACER_TICK_NS 1000000ull
+#define PACER_SLOTS 256
+
+typedef enum {
+    PACER_LINES,            /* rate and burst count lines */
+    PACER_BYTES,            /* ... bytes of line text */
+} pacer_unit_t;
+
+typedef struct {
+    pacer_unit_t unit;
+    uint64_t rate;          /* per second; 0: not paced */
+    uint64_t burst;         /* bucket size; 0: a tenth of a second's worth (at least 1) */
+} pacer_rate_t;
+
+typedef struct pacer_stage pacer_stage_t;
+
+/**
+ * Parse a rate: "N" (lines per second) or "NB" (bytes per second)
+ * @param spec Rate text
+ * @param rate Unit and rate filled on success (burst untouched)
+ * @return 0 on success, -1 on a malformed spec
+ */
+int pacer_rate_parse(const char* spec, pacer_rate_t* rate);
+
+/**
+ * Start the pacer thread
+ * @return NULL on success, error message on failure
+ */
+const char* pacer_start(void);
+
+/**
+ * Stop and join the pacer thread. Call it once no paced stage has lines
+ * waiting (every <END> has gone through).
+ */
+void pacer_stop(void);
+
+/**
+ * Put a token bucket in front of a sink
+ * @param stage Set to the new paced sink's state
+ * @param rate Rate and burst
+ * @param capacity Lines the FIFO holds before producers wait
+ * @param next Sink the lines are released to
+ * @param sink Filled with the paced sink
+ * @return NULL on success, error message on failure
+ */
+const char* pacer_stage_create(pacer_stage_t** stage, const pacer_rate_t* rate, int capacity,
+                               const message_sink_t* next, message_sink_t* sink);
+
+/**
+ * Free a paced sink (lines still waiting are dropped)
+ * @param stage State from pacer_stage_create, or NULL
+ */
+void pacer_stage_destroy(pacer_stage_t* stage);
+
+#endif /* PACER_H */
@@ -0,0 +1,229 @@
+#define _GNU_SOURCE
+#include "placement.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* Memory policy modes (linux/mempolicy.h); called through syscall() so libnuma is not needed */
+#define PLACEMENT_MPOL_DEFAULT   0
+#define PLACEMENT_MPOL_PREFERRED 1
+
+#define PLACEMENT_MAX_NODES 64
+
+typedef struct {
+    int cpu;
+    int l3;                      /* first CPU sharing its L3 (or package), the group key */
+    int l2;                      /* first CPU sharing its L2 */
+    int smt_rank;                /* position among its core's hardware threads */
+} cpu_info_t;
+
+static struct {
+    int enabled;
+    int* order;
+    int count;
+    int next;
+    int node_of[PLACEMENT_MAX_CPUS];
+} place;
+
+/**
+ * Parse a CPU list ("0-3,8,10-11")
+ * @param text List
+ * @param cpus Filled with the CPUs, in list order
+ * @param max Capacity of cpus
+ * @return Number of CPUs, or -1 on a malformed list
+ */
+static int parse_cpu_list(const char* text, int* cpus, int max) {
+    int count = 0;
+    const char* p = text;
+    while (*p && *p != '\n') {
+        char* end = NULL;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0 || first >= PLACEMENT_MAX_CPUS) return -1;
+        long last = first;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first || last >= PLACEMENT_MAX_CPUS) return -1;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            if (count == max) return -1;
+            cpus[count++] = (int)cpu;
+        }
+        if (*end == ',') end++;
+        else if (*end != '\0' && *end != '\n') return -1;
+        p = end;
+    }
+    return count;
+}
+
+static int read_line(const char* path, char* buf, size_t size) {
+    FILE* f = fopen(path, "r");
+    if (!f) return -1;
+    char* ok = fgets(buf, (int)size, f);
+    fclose(f);
+    return ok ? 0 : -1;
+}
+
+/* First CPU of a list file, or fallback when it cannot be read */
+static int first_cpu_of(const char* path, int fallback) {
+    char buf[4096];
+    int cpus[PLACEMENT_MAX_CPUS];
+    if (read_line(path, buf, sizeof buf) != 0) return fallback;
+    int n = parse_cpu_list(buf, cpus, PLACEMENT_MAX_CPUS);
+    return n > 0 ? cpus[0] : fallback;
+}
+
+static void read_cpu_info(int cpu, cpu_info_t* info) {
+    char path[256], buf[4096];
+    int cpus[PLACEMENT_MAX_CPUS];
+    info->cpu = cpu;
+    snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d/topology/package_cpus_list", cpu);
+    info->l3 = first_cpu_of(path, 0);
+    info->l2 = cpu;
+    for (int index = 0; index < 16; index++) {
+        snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, index);
+        if (read_line(path, buf, sizeof buf) != 0) break;
+        int level = atoi(buf);
+        if (level != 2 && level != 3) continue;
+        snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", cpu, index);
+        if (level == 2) info->l2 = first_cpu_of(path, cpu);
+        else info->l3 = first_cpu_of(path, info->l3);
+    }
+    info->smt_rank = 0;
+    snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    if (read_line(path, buf, sizeof buf) == 0) {
+        int n = parse_cpu_list(buf, cpus, PLACEMENT_MAX_CPUS);
+        for (int i = 0; i < n; i++) {
+            if (cpus[i] == cpu) info->smt_rank = i;
+        }
+    }
+}
+
+static int compare_cpu_info(const void* a, const void* b) {
+    const cpu_info_t* x = a;
+    const cpu_info_t* y = b;
+    if (x->l3 != y->l3) return x->l3 - y->l3;
+    if (x->smt_rank != y->smt_rank) return x->smt_rank - y->smt_rank;
+    if (x->l2 != y->l2) return x->l2 - y->l2;
+    return x->cpu - y->cpu;
+}
+
+static void read_nodes(void) {
+    char path[128], buf[4096];
+    int cpus[PLACEMENT_MAX_CPUS];
+    for (int cpu = 0; cpu < PLACEMENT_MAX_CPUS; cpu++) {
+        place.node_of[cpu] = -1;
+    }
+    for (int node = 0; node < PLACEMENT_MAX_NODES; node++) {
+        snprintf(path, sizeof path, "/sys/devices/system/node/node%d/cpulist", node);
+        if (read_line(path, buf, sizeof buf) != 0) continue;
+        int n = parse_cpu_list(buf, cpus, PLACEMENT_MAX_CPUS);
+        for (int i = 0; i < n; i++) {
+            place.node_of[cpus[i]] = node;
+        }
+    }
+}
+
+const char* placement_init(const char* spec) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof allowed, &allowed) != 0) {
+        return "Cannot read the CPU affinity mask";
+    }
+    int* order = malloc(PLACEMENT_MAX_CPUS * sizeof(int));
+    if (!order) {
+        return "Memory allocation failed";
+    }
+    int count = 0;
+    if (strcmp(spec, "auto") == 0) {
+        cpu_info_t* infos = malloc(PLACEMENT_MAX_CPUS * sizeof(cpu_info_t));
+        if (!infos) {
+            free(order);
+            return "Memory allocation failed";
+        }
+        for (int cpu = 0; cpu < PLACEMENT_MAX_CPUS && cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                read_cpu_info(cpu, &infos[count++]);
+            }
+        }
+        qsort(infos, count, sizeof(cpu_info_t), compare_cpu_info);
+        for (int i = 0; i < count; i++) {
+            order[i] = infos[i].cpu;
+        }
+        free(infos);
+    } else {
+        count = parse_cpu_list(spec, order, PLACEMENT_MAX_CPUS);
+        if (count <= 0) {
+            free(order);
+            return "Malformed CPU list (CPUs 0-1023)";
+        }
+        for (int i = 0; i < count; i++) {
+            if (order[i] >= CPU_SETSIZE || !CPU_ISSET(order[i], &allowed)) {
+                free(order);
+                return "CPU list names a CPU this process cannot run on";
+            }
+        }
+    }
+    if (count == 0) {
+        free(order);
+        return "No usable CPU";
+    }
+    read_nodes();
+    free(place.order);
+    place.order = order;
+    place.count = count;
+    place.next = 0;
+    place.enabled = 1;
+    return NULL;
+}
+
+int placement_next_cpu(void) {
+    if (!place.enabled) {
+        return -1;
+    }
+    return place.order[place.next++ % place.count];
+}
+
+int placement_cpu_node(int cpu) {
+    if (!place.enabled || cpu < 0 || cpu >= PLACEMENT_MAX_CPUS) {
+        return -1;
+    }
+    return place.node_of[cpu];
+}
+
+int placement_set_thread_attr(pthread_attr_t* attr, int cpu) {
+    if (cpu < 0) {
+        return 0;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_attr_setaffinity_np(attr, sizeof set, &set) == 0 ? 0 : -1;
+}
+
+int placement_pin_self(int cpu) {
+    if (cpu < 0) {
+        return 0;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof set, &set) == 0 ? 0 : -1;
+}
+
+void placement_prefer_node(int cpu) {
+    if (!place.enabled) {
+        return;
+    }
+    int node = placement_cpu_node(cpu);
+    if (node < 0) {
+        (void)syscall(SYS_set_mempolicy, PLACEMENT_MPOL_DEFAULT, NULL, 0UL);
+        return;
+    }
+    unsigned long mask[PLACEMENT_MAX_NODES / (8 * sizeof(unsigned long))] = { 0 };
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    /* Best effort: on a kernel without NUMA support the call fails and memory stays where it is */
+    (void)syscall(SYS_set_mempolicy, PLACEMENT_MPOL_PREFERRED, mask, (unsigned long)PLACEMENT_MAX_NODES + 1);
+}
@@ -0,0 +1,62 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <pthread.h>
+
+/**
+ * Stage thread placement (--pin).
+ * CPUs are handed out in a placement order: "auto" reads the topology
+ * under /sys/devices/system/cpu and orders the CPUs this process may use
+ * so that neighbours share a last-level cache (grouped by L3, one thread
+ * per physical core before any SMT sibling, cores sharing an L2 together),
+ * so adjacent stages exchange queue cache lines without crossing sockets.
+ * An explicit list ("0,2,4-7") is used as given. Memory a stage allocates
+ * while it is created, and the slabs of the thread feeding it, are
+ * preferred on the NUMA node of its CPU.
+ */
+
+// CPUs considered
+#define PLACEMENT_MAX_CPUS 1024
+
+/**
+ * Build the placement order
+ * @param spec "auto" or a CPU list such as "0-3,8"
+ * @return NULL on success, error message on failure
+ */
+const char* placement_init(const char* spec);
+
+/**
+ * Next CPU in placement order, wrapping around
+ * @return CPU number, or -1 when placement is off
+ */
+int placement_next_cpu(void);
+
+/**
+ * NUMA node of a CPU
+ * @param cpu CPU number
+ * @return Node, or -1 if unknown
+ */
+int placement_cpu_node(int cpu);
+
+/**
+ * Pin threads created with attr to a CPU
+ * @param attr Initialized thread attributes
+ * @param cpu CPU number (-1 leaves attr unchanged)
+ * @return 0 on success, -1 on failure
+ */
+int placement_set_thread_attr(pthread_attr_t* attr, int cpu);
+
+/**
+ * Pin the calling thread to a CPU
+ * @param cpu CPU number (-1 does nothing)
+ * @return 0 on success, -1 on failure
+ */
+int placement_pin_self(int cpu);
+
+/**
+ * Prefer the NUMA node of a CPU for the calling thread's new pages
+ * @param cpu CPU whose node to prefer, or -1 to restore the default policy
+ */
+void placement_prefer_node(int cpu);
+
+#endif /* PLACEMENT_H */
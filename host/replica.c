@@ -0,0 +1,358 @@
+#define _GNU_SOURCE
+#include "replica.h"
+#include "consumer_producer.h"
+#include "placement.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REPLICA_BATCH_MAX 64
+#define REORDER_WINDOW    1024   /* power of two, larger than one batch */
+
+/* Window entry for a line the queue's overflow policy dropped: its seq is skipped */
+static message_t dropped_slot;
+
+struct replica_stage {
+    const char* name;
+    message_transform_t transform;
+    int ordered;
+    int replicas;
+    int batch;                       /* items a replica takes at once */
+    int started;                     /* threads successfully created */
+    int joined;
+    pthread_t threads[REPLICA_MAX];
+    consumer_producer_t* queue;      /* shared by all replicas, locked backend */
+    message_sink_t next;
+    atomic_int live;                 /* replicas still running */
+    atomic_int next_slot;            /* hands each replica its counters */
+    stage_counters_t counters[REPLICA_MAX];
+    _Atomic(message_t*) end;         /* <END>, forwarded by the last replica out */
+
+    /* Reorder window; also serializes forwarding so the next queue sees one producer */
+    pthread_mutex_t forward_lock;
+    pthread_cond_t window_moved;
+    uint64_t next_seq;               /* next seq to forward */
+    message_t* window[REORDER_WINDOW];
+    uint64_t input_seq;              /* seq the next input line should carry (producer side) */
+};
+
+static void process(replica_stage_t* stage, message_t** msgs, int count) {
+    if (stage->transform.process_batch) {
+        stage->transform.process_batch(msgs, count);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        const char* err = stage->transform.process(msgs[i]);
+        if (err) {
+            fprintf(stderr, "[ERROR][%s] - %s\n", stage->name, err);
+        }
+    }
+}
+
+/* Forward every message that is next in line. Called with forward_lock held. */
+static void release_ready(replica_stage_t* stage) {
+    message_t* out[REPLICA_BATCH_MAX];
+    int n = 0;
+    message_t** slot = &stage->window[stage->next_seq & (REORDER_WINDOW - 1)];
+    while (*slot != NULL) {
+        if (*slot != &dropped_slot) {
+            out[n++] = *slot;
+        }
+        *slot = NULL;
+        stage->next_seq++;
+        if (n == REPLICA_BATCH_MAX) {
+            (void)message_sink_place_batch(&stage->next, out, n);
+            n = 0;
+        }
+        slot = &stage->window[stage->next_seq & (REORDER_WINDOW - 1)];
+    }
+    if (n > 0) {
+        (void)message_sink_place_batch(&stage->next, out, n);
+    }
+    pthread_cond_broadcast(&stage->window_moved);
+}
+
+/*
+ * Hand a processed batch downstream. In ordered mode each message waits in
+ * the window until everything before it has left; a replica that is a full
+ * window ahead blocks until the laggard catches up. The replica holding
+ * next_seq never blocks, so the window always drains.
+ */
+static void deliver(replica_stage_t* stage, message_t** msgs, int count) {
+    pthread_mutex_lock(&stage->forward_lock);
+    if (!stage->ordered) {
+        (void)message_sink_place_batch(&stage->next, msgs, count);
+        pthread_mutex_unlock(&stage->forward_lock);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        uint64_t seq = msgs[i]->seq;
+        if (seq < stage->next_seq) {
+            /* Not numbered by the host; nothing to order it against */
+            (void)stage->next.place(stage->next.target, msgs[i]);
+            continue;
+        }
+        while (seq - stage->next_seq >= REORDER_WINDOW) {
+            pthread_cond_wait(&stage->window_moved, &stage->forward_lock);
+        }
+        stage->window[seq & (REORDER_WINDOW - 1)] = msgs[i];
+        if (seq == stage->next_seq) {
+            release_ready(stage);
+        }
+    }
+    pthread_mutex_unlock(&stage->forward_lock);
+}
+
+/* Last replica out: flush whatever is left in the window, then <END> */
+static void finish(replica_stage_t* stage) {
+    pthread_mutex_lock(&stage->forward_lock);
+    for (int i = 0; i < REORDER_WINDOW; i++) {
+        message_t** slot = &stage->window[(stage->next_seq + i) & (REORDER_WINDOW - 1)];
+        if (*slot != NULL && *slot != &dropped_slot) {
+            (void)stage->next.place(stage->next.target, *slot);
+        }
+        *slot = NULL;
+    }
+    message_t* end = atomic_exchange(&stage->end, NULL);
+    if (end != NULL) {
+        (void)stage->next.place(stage->next.target, end);
+    }
+    pthread_mutex_unlock(&stage->forward_lock);
+}
+
+static void* replica_thread(void* arg) {
+    replica_stage_t* stage = (replica_stage_t*)arg;
+    stage_counters_t* stats = &stage->counters[atomic_fetch_add(&stage->next_slot, 1)];
+    message_t* msgs[REPLICA_BATCH_MAX];
+    stage_counters_begin(stats);
+    while (1) {
+        int count = consumer_producer_get_batch(stage->queue, (void**)msgs, stage->batch);
+        if (count == 0) {
+            break;
+        }
+        // Runs of lines are processed; other control messages take their place in the window
+        int next = 0;
+        while (next < count && !message_is_end(msgs[next])) {
+            int data = message_data_run(msgs + next, count - next);
+            if (data == 0) {
+                deliver(stage, &msgs[next++], 1);
+                continue;
+            }
+            message_t** run = msgs + next;
+            uint64_t bytes_in = 0, bytes_out = 0;
+            for (int i = 0; i < data; i++) bytes_in += run[i]->len;
+            uint64_t start = stats_now_ns();
+            process(stage, run, data);
+            uint64_t busy = stats_now_ns() - start;
+            for (int i = 0; i < data; i++) bytes_out += run[i]->len;
+            stage_counters_record(stats, (uint64_t)data, bytes_in, bytes_out, busy);
+            deliver(stage, run, data);
+            next += data;
+        }
+        if (next == count) {
+            continue;
+        }
+
+        // <END>: keep it for the last replica and wake the others
+        atomic_store(&stage->end, msgs[next]);
+        for (int i = next + 1; i < count; i++) {
+            message_free(msgs[i]);
+        }
+        consumer_producer_signal_finished(stage->queue);
+        break;
+    }
+    stage_counters_end(stats);
+    if (atomic_fetch_sub(&stage->live, 1) == 1) {
+        finish(stage);
+    }
+    return NULL;
+}
+
+/* Skip a seq that will never reach the window. Called with forward_lock held. */
+static void mark_dropped(replica_stage_t* stage, uint64_t seq) {
+    if (seq < stage->next_seq) {
+        return;
+    }
+    while (seq - stage->next_seq >= REORDER_WINDOW) {
+        pthread_cond_wait(&stage->window_moved, &stage->forward_lock);
+    }
+    stage->window[seq & (REORDER_WINDOW - 1)] = &dropped_slot;
+    if (seq == stage->next_seq) {
+        release_ready(stage);
+    }
+}
+
+/*
+ * Lines shed by a queue upstream (drop-newest, sample, ...) leave gaps in
+ * the seqs reaching this stage. Ordered input arrives in seq order (one
+ * producer, and every stage in front keeps order), so a seq past the one
+ * expected means the lines in between are gone: skip them in the window.
+ */
+static void skip_gaps(replica_stage_t* stage, message_t* const* msgs, int count) {
+    if (!stage->ordered) {
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        uint64_t seq = msgs[i]->seq;
+        if (seq < stage->input_seq) {
+            continue;   /* not numbered by the host */
+        }
+        if (seq > stage->input_seq) {
+            pthread_mutex_lock(&stage->forward_lock);
+            for (uint64_t gap = stage->input_seq; gap < seq; gap++) {
+                mark_dropped(stage, gap);
+            }
+            pthread_mutex_unlock(&stage->forward_lock);
+        }
+        stage->input_seq = seq + 1;
+    }
+}
+
+static const char* replica_place_message(void* target, message_t* msg) {
+    replica_stage_t* stage = (replica_stage_t*)target;
+    skip_gaps(stage, &msg, 1);
+    const char* err = consumer_producer_put(stage->queue, msg);
+    if (err != NULL) {
+        message_free(msg);
+    }
+    return err;
+}
+
+static const char* replica_place_message_batch(void* target, message_t** msgs, int count) {
+    replica_stage_t* stage = (replica_stage_t*)target;
+    skip_gaps(stage, msgs, count);
+    int queued = 0;
+    const char* err = consumer_producer_put_batch(stage->queue, (void* const*)msgs, count, &queued);
+    if (err != NULL) {
+        for (int i = queued; i < count; i++) message_free(msgs[i]);
+    }
+    return err;
+}
+
+/* A dropped line leaves a hole in the window, or the lines after it would wait for it forever */
+static void message_release(void* context, void* item) {
+    replica_stage_t* stage = (replica_stage_t*)context;
+    message_t* msg = (message_t*)item;
+    uint64_t seq = msg->seq;
+    message_free(msg);
+    if (!stage->ordered) {
+        return;
+    }
+    pthread_mutex_lock(&stage->forward_lock);
+    mark_dropped(stage, seq);
+    pthread_mutex_unlock(&stage->forward_lock);
+}
+
+const char* replica_stage_create(replica_stage_t** out, const char* name,
+                                 const message_transform_t* transform, int replicas,
+                                 int queue_size, int ordered, const int* cpus,
+                                 const consumer_producer_policy_t* policy) {
+    if (replicas < 1 || replicas > REPLICA_MAX) {
+        return "Replica count out of range";
+    }
+    if (!transform || !transform->process) {
+        return "Stage has no transform to replicate";
+    }
+    replica_stage_t* stage = calloc(1, sizeof *stage);
+    if (!stage) {
+        return "Memory allocation failed";
+    }
+    stage->queue = aligned_alloc(CP_CACHE_LINE, sizeof *stage->queue);
+    if (!stage->queue) {
+        free(stage);
+        return "Memory allocation failed";
+    }
+    /* Several consumers share the queue, which rules out the SPSC ring */
+    const char* err = consumer_producer_init_backend(stage->queue, queue_size, CP_BACKEND_LOCKED);
+    if (err == NULL && policy && policy->overflow == CP_POLICY_SPILL) {
+        err = consumer_producer_set_spill(stage->queue, policy->spill_dir, &message_spill_ops);
+        if (err != NULL) {
+            consumer_producer_destroy(stage->queue);
+        }
+    }
+    if (err != NULL) {
+        free(stage->queue);
+        free(stage);
+        return err;
+    }
+    stage->name = name;
+    stage->transform = *transform;
+    stage->ordered = ordered;
+    stage->replicas = replicas;
+    /* Leave work in the queue for the other replicas rather than taking it all */
+    stage->batch = queue_size / replicas;
+    if (stage->batch < 1) stage->batch = 1;
+    if (stage->batch > REPLICA_BATCH_MAX) stage->batch = REPLICA_BATCH_MAX;
+    atomic_init(&stage->live, replicas);
+    atomic_init(&stage->next_slot, 0);
+    atomic_init(&stage->end, NULL);
+    pthread_mutex_init(&stage->forward_lock, NULL);
+    pthread_cond_init(&stage->window_moved, NULL);
+    if (policy && policy->overflow != CP_POLICY_SPILL) {
+        consumer_producer_set_policy(stage->queue, policy, message_droppable, message_release, stage);
+    }
+
+    for (int i = 0; i < replicas; i++) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        if (cpus) {
+            (void)placement_set_thread_attr(&attr, cpus[i]);   /* best effort: unpinned on failure */
+        }
+        int rc = pthread_create(&stage->threads[i], &attr, replica_thread, stage);
+        pthread_attr_destroy(&attr);
+        if (rc != 0) {
+            /* Let the started replicas exit; the ones never started count as done */
+            atomic_fetch_sub(&stage->live, replicas - i);
+            replica_stage_destroy(stage);
+            return "Failed to create replica thread";
+        }
+        stage->started++;
+    }
+    *out = stage;
+    return NULL;
+}
+
+void replica_stage_get_sink(replica_stage_t* stage, message_sink_t* sink) {
+    sink->place = replica_place_message;
+    sink->place_batch = replica_place_message_batch;
+    sink->target = stage;
+}
+
+void replica_stage_attach(replica_stage_t* stage, const message_sink_t* next_sink) {
+    stage->next = *next_sink;
+}
+
+const char* replica_stage_wait_finished(replica_stage_t* stage) {
+    if (!stage->joined) {
+        for (int i = 0; i < stage->started; i++) {
+            pthread_join(stage->threads[i], NULL);
+        }
+        stage->joined = 1;
+    }
+    return NULL;
+}
+
+void replica_stage_get_stats(replica_stage_t* stage, stage_stats_t* stats) {
+    memset(stats, 0, sizeof *stats);
+    int slots = atomic_load(&stage->next_slot);
+    for (int i = 0; i < slots; i++) {
+        stage_counters_read(&stage->counters[i], stats);
+    }
+    stats->threads = stage->replicas;
+    stats->has_queue = 1;
+    consumer_producer_get_stats(stage->queue, &stats->queue);
+}
+
+void replica_stage_destroy(replica_stage_t* stage) {
+    if (!stage) return;
+    consumer_producer_signal_finished(stage->queue);
+    (void)replica_stage_wait_finished(stage);
+    message_free(atomic_exchange(&stage->end, NULL));
+    consumer_producer_destroy(stage->queue);
+    free(stage->queue);
+    pthread_cond_destroy(&stage->window_moved);
+    pthread_mutex_destroy(&stage->forward_lock);
+    free(stage);
+}
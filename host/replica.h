@@ -0,0 +1,72 @@
+#ifndef REPLICA_H
+#define REPLICA_H
+
+#include "consumer_producer.h"
+#include "message.h"
+#include "stats.h"
+
+/**
+ * Replicated stage: N host threads run a pure plugin's transform, all
+ * pulling from one input queue. Messages leave in input (seq) order through
+ * a bounded reorder window unless the stage is unordered, in which case
+ * they leave as soon as they are processed. The <END> sentinel always
+ * leaves last, after every replica has drained.
+ */
+
+#define REPLICA_MAX 64
+
+typedef struct replica_stage replica_stage_t;
+
+/**
+ * Create a replicated stage and start its threads
+ * @param out Receives the stage
+ * @param name Stage name (for diagnosis; must outlive the stage)
+ * @param transform The plugin's transform (must be MESSAGE_TRANSFORM_PURE)
+ * @param replicas Number of threads, 1..REPLICA_MAX
+ * @param queue_size Capacity of the shared input queue
+ * @param ordered Non-zero to preserve input order
+ * @param cpus CPU for each replica thread (-1 entries run unpinned), or NULL
+ * @param policy Overflow policy of the input queue, or NULL to block when full
+ * @return NULL on success, error message on failure
+ */
+const char* replica_stage_create(replica_stage_t** out, const char* name,
+                                 const message_transform_t* transform, int replicas,
+                                 int queue_size, int ordered, const int* cpus,
+                                 const consumer_producer_policy_t* policy);
+
+/**
+ * Get the sink feeding the stage's input queue
+ * @param stage Stage
+ * @param sink Filled with the stage's sink
+ */
+void replica_stage_get_sink(replica_stage_t* stage, message_sink_t* sink);
+
+/**
+ * Forward processed messages to a sink. Must be called before the first
+ * message is placed.
+ * @param stage Stage
+ * @param next_sink Next stage's sink
+ */
+void replica_stage_attach(replica_stage_t* stage, const message_sink_t* next_sink);
+
+/**
+ * Wait until every replica has seen <END> and forwarded its work
+ * @param stage Stage
+ * @return NULL on success, error message on failure
+ */
+const char* replica_stage_wait_finished(replica_stage_t* stage);
+
+/**
+ * Sample the stage's counters (summed over replicas) and input queue
+ * @param stage Stage
+ * @param stats Filled with the snapshot
+ */
+void replica_stage_get_stats(replica_stage_t* stage, stage_stats_t* stats);
+
+/**
+ * Stop the replicas (if still running) and free the stage
+ * @param stage Stage (may be NULL)
+ */
+void replica_stage_destroy(replica_stage_t* stage);
+
+#endif /* REPLICA_H */
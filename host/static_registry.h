@@ -0,0 +1,56 @@
+#ifndef STATIC_REGISTRY_H
+#define STATIC_REGISTRY_H
+
+#include <stdio.h>
+#include "message.h"
+#include "host_services.h"
+#include "plugin_abi.h"
+
+/**
+ * Plugins linked into analyzer-static (built with -DANALYZER_STATIC).
+ * build.sh compiles every built-in plugin into the binary, with its
+ * exported functions renamed after it (uppercaser_plugin_get_descriptor,
+ * ...), and gen_static.sh writes the tables behind this interface: the
+ * plugins by name, and a specialized function for every sequence of one
+ * to STATIC_CHAIN_MAX pure plugins. Such a function runs each line
+ * through all of the sequence's transforms in one loop. It calls them by
+ * name (PLUGIN_TRANSFORM in plugin_common.h), so with LTO they inline
+ * into it.
+ * Plugins that are not built in still load from ./output/<name>.so.
+ */
+
+// Longest sequence with a specialized function (read by gen_static.sh)
+#define STATIC_CHAIN_MAX 3
+
+/* One line at a time through a fixed sequence of transforms */
+typedef void (*static_chain_fn)(message_t** msgs, int count);
+
+typedef struct {
+    const char* name;                                   /* as given on the command line */
+    const plugin_descriptor_t* (*get_descriptor)(void);
+    void (*set_host_services)(const host_services_t*);  /* shared by every built-in plugin */
+} static_plugin_t;
+
+/**
+ * Look up a built-in plugin
+ * @param name Plugin name
+ * @return Its entry, or NULL if it is not built in
+ */
+const static_plugin_t* static_registry_find(const char* name);
+
+/**
+ * Look up the specialized function for a sequence of built-in transforms
+ * @param descs Descriptors of the stages, in chain order
+ * @param count Number of stages, at most STATIC_CHAIN_MAX
+ * @return The function, or NULL if none was generated for the sequence
+ */
+static_chain_fn static_registry_find_chain(const plugin_descriptor_t* const* descs, int count);
+
+/* Used by the generated chains: report a transform's error as fused stages do */
+static inline void static_chain_check(const char* err, const char* name) {
+    if (err) {
+        fprintf(stderr, "[ERROR][%s] - %s\n", name, err);
+    }
+}
+
+#endif /* STATIC_REGISTRY_H */
@@ -0,0 +1,213 @@
+#define _POSIX_C_SOURCE 200809L
+#include "stats_report.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <string.h>
+
+static pthread_t signal_thread;
+static int signal_running;
+static atomic_int signal_stop;
+static void (*signal_dump)(void* arg);
+static void* signal_arg;
+
+int stats_format_parse(const char* name, stats_format_t* format) {
+    if (strcmp(name, "text") == 0) {
+        *format = STATS_FORMAT_TEXT;
+        return 0;
+    }
+    if (strcmp(name, "json") == 0) {
+        *format = STATS_FORMAT_JSON;
+        return 0;
+    }
+    return -1;
+}
+
+/* Upper bound (ns) of the histogram bucket holding the given fraction of items */
+static uint64_t percentile_ns(const stage_stats_t* s, double fraction) {
+    uint64_t total = 0;
+    for (int b = 0; b < STATS_HIST_BUCKETS; b++) {
+        total += s->hist[b];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t wanted = (uint64_t)(fraction * (double)total);
+    if (wanted == 0) wanted = 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < STATS_HIST_BUCKETS; b++) {
+        seen += s->hist[b];
+        if (seen >= wanted) {
+            return (uint64_t)2 << b;
+        }
+    }
+    return (uint64_t)2 << (STATS_HIST_BUCKETS - 1);
+}
+
+static double ms(uint64_t ns) {
+    return (double)ns / 1e6;
+}
+
+static double mib(uint64_t bytes) {
+    return (double)bytes / (1024.0 * 1024.0);
+}
+
+static void print_text(FILE* out, const stats_entry_t* entries, int count, const cache_stats_t* cache,
+                       uint64_t elapsed_ns) {
+    fprintf(out, "--- pipeline stats after %.3f s ---\n", (double)elapsed_ns / 1e9);
+    fprintf(out, "%-14s %-8s %3s %10s %9s %9s %10s %10s %8s %8s | %5s %5s %5s %8s %8s %11s %11s\n",
+            "stage", "mode", "thr", "items", "MiB in", "MiB out", "busy ms", "cpu ms",
+            "p50 ns", "p99 ns", "cap", "depth", "hwm", "dropped", "spilled", "put-wait ms", "get-wait ms");
+    for (int i = 0; i < count; i++) {
+        const stats_entry_t* e = &entries[i];
+        const stage_stats_t* s = &e->stats;
+        if (!e->available) {
+            fprintf(out, "%-14s %-8s (no statistics)\n", e->name, e->mode);
+            continue;
+        }
+        fprintf(out, "%-14s %-8s %3d %10llu %9.1f %9.1f %10.1f %10.1f %8llu %8llu |",
+                e->name, e->mode, s->threads, (unsigned long long)s->items,
+                mib(s->bytes_in), mib(s->bytes_out), ms(s->busy_ns), ms(s->cpu_ns),
+                (unsigned long long)percentile_ns(s, 0.50), (unsigned long long)percentile_ns(s, 0.99));
+        if (s->has_queue) {
+            fprintf(out, " %5llu %5llu %5llu %8llu %8llu %11.1f %11.1f\n",
+                    (unsigned long long)s->queue.capacity, (unsigned long long)s->queue.depth,
+                    (unsigned long long)s->queue.high_water, (unsigned long long)s->queue.dropped,
+                    (unsigned long long)s->queue.spilled, ms(s->queue.put_wait_ns),
+                    ms(s->queue.get_wait_ns));
+        } else {
+            fprintf(out, " %5s\n", "-");
+        }
+    }
+    if (cache) {
+        uint64_t lookups = cache->hits + cache->misses;
+        fprintf(out, "memo cache: %llu of %llu entries, %llu hits, %llu misses (%.1f%% hit rate), %llu evictions\n",
+                (unsigned long long)cache->entries, (unsigned long long)cache->capacity,
+                (unsigned long long)cache->hits, (unsigned long long)cache->misses,
+                lookups ? 100.0 * (double)cache->hits / (double)lookups : 0.0,
+                (unsigned long long)cache->evictions);
+    }
+}
+
+static void print_json_string(FILE* out, const char* str) {
+    fputc('"', out);
+    for (const char* p = str; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fputc('\\', out);
+            fputc(*p, out);
+        } else if ((unsigned char)*p < 0x20) {
+            fprintf(out, "\\u%04x", (unsigned char)*p);
+        } else {
+            fputc(*p, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void print_json(FILE* out, const stats_entry_t* entries, int count, const cache_stats_t* cache,
+                       uint64_t elapsed_ns) {
+    fprintf(out, "{\"elapsed_ns\":%llu,\"stages\":[", (unsigned long long)elapsed_ns);
+    for (int i = 0; i < count; i++) {
+        const stats_entry_t* e = &entries[i];
+        const stage_stats_t* s = &e->stats;
+        fprintf(out, "%s{\"name\":", i ? "," : "");
+        print_json_string(out, e->name);
+        fprintf(out, ",\"mode\":");
+        print_json_string(out, e->mode);
+        if (!e->available) {
+            fprintf(out, ",\"available\":false}");
+            continue;
+        }
+        fprintf(out, ",\"available\":true,\"threads\":%d,\"items\":%llu,\"bytes_in\":%llu,"
+                "\"bytes_out\":%llu,\"batches\":%llu,\"busy_ns\":%llu,\"cpu_ns\":%llu,"
+                "\"p50_ns\":%llu,\"p99_ns\":%llu,\"histogram_log2_ns\":[",
+                s->threads, (unsigned long long)s->items, (unsigned long long)s->bytes_in,
+                (unsigned long long)s->bytes_out, (unsigned long long)s->batches,
+                (unsigned long long)s->busy_ns, (unsigned long long)s->cpu_ns,
+                (unsigned long long)percentile_ns(s, 0.50), (unsigned long long)percentile_ns(s, 0.99));
+        for (int b = 0; b < STATS_HIST_BUCKETS; b++) {
+            fprintf(out, "%s%llu", b ? "," : "", (unsigned long long)s->hist[b]);
+        }
+        fprintf(out, "],\"queue\":");
+        if (s->has_queue) {
+            fprintf(out, "{\"capacity\":%llu,\"depth\":%llu,\"high_water\":%llu,\"puts\":%llu,"
+                    "\"gets\":%llu,\"dropped\":%llu,\"spilled\":%llu,\"put_wait_ns\":%llu,\"get_wait_ns\":%llu}}",
+                    (unsigned long long)s->queue.capacity, (unsigned long long)s->queue.depth,
+                    (unsigned long long)s->queue.high_water, (unsigned long long)s->queue.puts,
+                    (unsigned long long)s->queue.gets, (unsigned long long)s->queue.dropped,
+                    (unsigned long long)s->queue.spilled, (unsigned long long)s->queue.put_wait_ns,
+                    (unsigned long long)s->queue.get_wait_ns);
+        } else {
+            fprintf(out, "null}");
+        }
+    }
+    fprintf(out, "]");
+    if (cache) {
+        fprintf(out, ",\"memo\":{\"capacity\":%llu,\"entries\":%llu,\"hits\":%llu,\"misses\":%llu,\"evictions\":%llu}",
+                (unsigned long long)cache->capacity, (unsigned long long)cache->entries,
+                (unsigned long long)cache->hits, (unsigned long long)cache->misses,
+                (unsigned long long)cache->evictions);
+    }
+    fprintf(out, "}\n");
+}
+
+void stats_report_print(FILE* out, const stats_entry_t* entries, int count, const cache_stats_t* cache,
+                        uint64_t elapsed_ns, stats_format_t format) {
+    flockfile(out);
+    if (format == STATS_FORMAT_JSON) {
+        print_json(out, entries, count, cache, elapsed_ns);
+    } else {
+        print_text(out, entries, count, cache, elapsed_ns);
+    }
+    fflush(out);
+    funlockfile(out);
+}
+
+void stats_signal_block(void) {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+}
+
+static void* signal_main(void* arg) {
+    (void)arg;
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    for (;;) {
+        int sig = 0;
+        if (sigwait(&set, &sig) != 0) {
+            continue;
+        }
+        if (atomic_load(&signal_stop)) {
+            break;
+        }
+        signal_dump(signal_arg);
+    }
+    return NULL;
+}
+
+const char* stats_signal_start(void (*dump)(void* arg), void* arg) {
+    if (signal_running) {
+        return "Statistics reporter already running";
+    }
+    signal_dump = dump;
+    signal_arg = arg;
+    atomic_store(&signal_stop, 0);
+    if (pthread_create(&signal_thread, NULL, signal_main, NULL) != 0) {
+        return "Failed to start the statistics reporter";
+    }
+    signal_running = 1;
+    return NULL;
+}
+
+void stats_signal_stop(void) {
+    if (!signal_running) {
+        return;
+    }
+    atomic_store(&signal_stop, 1);
+    pthread_kill(signal_thread, SIGUSR1);
+    pthread_join(signal_thread, NULL);
+    signal_running = 0;
+}
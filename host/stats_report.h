@@ -0,0 +1,66 @@
+#ifndef STATS_REPORT_H
+#define STATS_REPORT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "stats.h"
+
+/**
+ * Pipeline statistics reports: a table for people, JSON for tools, and a
+ * thread that prints one whenever the process receives SIGUSR1.
+ */
+
+typedef enum {
+    STATS_FORMAT_TEXT,
+    STATS_FORMAT_JSON,
+} stats_format_t;
+
+/* One row of a report */
+typedef struct {
+    const char* name;
+    const char* mode;            /* how the stage runs: thread, replicas, task, fused, input, v1 */
+    int available;               /* the stage could report counters */
+    stage_stats_t stats;
+} stats_entry_t;
+
+/**
+ * Parse a report format ("text" or "json")
+ * @param name Format name
+ * @param format Filled on success
+ * @return 0 on success, -1 if unknown
+ */
+int stats_format_parse(const char* name, stats_format_t* format);
+
+/**
+ * Print a report
+ * @param out Destination stream
+ * @param entries Stages in chain order
+ * @param count Number of stages
+ * @param cache Result cache counters, or NULL without a cache
+ * @param elapsed_ns Time since the pipeline started
+ * @param format Layout
+ */
+void stats_report_print(FILE* out, const stats_entry_t* entries, int count, const cache_stats_t* cache,
+                        uint64_t elapsed_ns, stats_format_t format);
+
+/**
+ * Block SIGUSR1 in the calling thread. Call before any other thread is
+ * created so that all of them inherit the mask and only the report thread
+ * takes the signal.
+ */
+void stats_signal_block(void);
+
+/**
+ * Start the thread that calls dump on every SIGUSR1
+ * @param dump Report callback (runs on the report thread)
+ * @param arg Callback argument
+ * @return NULL on success, error message on failure
+ */
+const char* stats_signal_start(void (*dump)(void* arg), void* arg);
+
+/**
+ * Stop the report thread (no-op when it is not running)
+ */
+void stats_signal_stop(void);
+
+#endif /* STATS_REPORT_H */
@@ -0,0 +1,291 @@
+#include "topology.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Messages handed to a branch per call; each branch gets its own copy of the pointers
+#define TOPOLOGY_BATCH 64
+
+typedef struct {
+    topology_t* topo;
+    char** args;
+    int count;
+    int pos;
+    int edge_cap;
+} parser_t;
+
+static const char* add_edge(parser_t* p, int from, int to) {
+    topology_t* topo = p->topo;
+    if (topo->edge_count == p->edge_cap) {
+        int cap = p->edge_cap ? 2 * p->edge_cap : 16;
+        topology_edge_t* edges = realloc(topo->edges, (size_t)cap * sizeof *edges);
+        if (!edges) {
+            return "Memory allocation failed";
+        }
+        topo->edges = edges;
+        p->edge_cap = cap;
+    }
+    topo->edges[topo->edge_count++] = (topology_edge_t){ from, to };
+    return NULL;
+}
+
+static int is_token(const char* arg, const char* token) {
+    return strcmp(arg, token) == 0;
+}
+
+/*
+ * Parse elements until "/", "]" or the end of the arguments.
+ * heads holds the nodes feeding the first element; on return it holds the
+ * nodes whose output leaves the chain. A node is listed once however many
+ * branches end with it (an empty branch ends with the group's heads), so
+ * count + 1 entries (every stage and the input) always suffice.
+ */
+static const char* parse_chain(parser_t* p, int* heads, int* head_count, int depth) {
+    while (p->pos < p->count) {
+        const char* arg = p->args[p->pos];
+        if (is_token(arg, "/") || is_token(arg, "]")) {
+            return NULL;
+        }
+        p->pos++;
+        if (!is_token(arg, "[")) {
+            int stage = p->topo->count++;
+            p->topo->stages[stage] = p->args[p->pos - 1];
+            for (int h = 0; h < *head_count; h++) {
+                const char* err = add_edge(p, heads[h], stage);
+                if (err) {
+                    return err;
+                }
+            }
+            heads[0] = stage;
+            *head_count = 1;
+            continue;
+        }
+        if (depth >= TOPOLOGY_MAX_DEPTH) {
+            return "groups nested too deeply";
+        }
+        // Every branch starts from the same heads; their ends feed what follows the group
+        int* branch = malloc(2 * (size_t)(p->count + 1) * sizeof(int));
+        if (!branch) {
+            return "Memory allocation failed";
+        }
+        int* tails = branch + p->count + 1;
+        int tail_count = 0;
+        const char* err = NULL;
+        for (;;) {
+            int branch_count = *head_count;
+            memcpy(branch, heads, (size_t)branch_count * sizeof(int));
+            err = parse_chain(p, branch, &branch_count, depth + 1);
+            if (err) {
+                break;
+            }
+            for (int b = 0; b < branch_count; b++) {
+                int known = 0;
+                for (int t = 0; t < tail_count && !known; t++) {
+                    known = tails[t] == branch[b];
+                }
+                if (!known) {
+                    tails[tail_count++] = branch[b];
+                }
+            }
+            if (p->pos == p->count) {
+                err = "missing ']'";
+                break;
+            }
+            if (is_token(p->args[p->pos++], "]")) {
+                break;
+            }
+        }
+        if (!err) {
+            memcpy(heads, tails, (size_t)tail_count * sizeof(int));
+            *head_count = tail_count;
+        }
+        free(branch);
+        if (err) {
+            return err;
+        }
+    }
+    return NULL;
+}
+
+const char* topology_parse(topology_t* topo, char** args, int count) {
+    memset(topo, 0, sizeof *topo);
+    topo->stages = calloc((size_t)count + 1, sizeof(char*));
+    int* heads = malloc(((size_t)count + 1) * sizeof(int));
+    const char* err = topo->stages && heads ? NULL : "Memory allocation failed";
+    parser_t p = { topo, args, count, 0, 0 };
+    int head_count = 1;
+    if (!err) {
+        heads[0] = TOPOLOGY_INPUT;
+        err = parse_chain(&p, heads, &head_count, 0);
+    }
+    if (!err && p.pos < count) {
+        err = is_token(args[p.pos], "/") ? "'/' outside a group" : "unmatched ']'";
+    }
+    if (!err && topo->count == 0) {
+        err = "no plugins";
+    }
+    for (int h = 0; !err && h < head_count; h++) {
+        err = add_edge(&p, heads[h], TOPOLOGY_OUTPUT);
+    }
+    free(heads);
+    if (err) {
+        topology_free(topo);
+    }
+    return err;
+}
+
+void topology_free(topology_t* topo) {
+    free(topo->stages);
+    free(topo->edges);
+    memset(topo, 0, sizeof *topo);
+}
+
+int topology_inputs(const topology_t* topo, int node) {
+    int n = 0;
+    for (int e = 0; e < topo->edge_count; e++) {
+        n += topo->edges[e].to == node;
+    }
+    return n;
+}
+
+int topology_successors(const topology_t* topo, int node, int* out) {
+    int n = 0;
+    for (int e = 0; e < topo->edge_count; e++) {
+        if (topo->edges[e].from == node) {
+            out[n++] = topo->edges[e].to;
+        }
+    }
+    return n;
+}
+
+static int outputs(const topology_t* topo, int node) {
+    int n = 0;
+    for (int e = 0; e < topo->edge_count; e++) {
+        n += topo->edges[e].from == node;
+    }
+    return n;
+}
+
+int topology_follows(const topology_t* topo, int stage) {
+    int prev = stage > 0 ? stage - 1 : TOPOLOGY_INPUT;
+    if (topology_inputs(topo, stage) != 1 || outputs(topo, prev) != 1) {
+        return 0;
+    }
+    for (int e = 0; e < topo->edge_count; e++) {
+        if (topo->edges[e].to == stage) {
+            return topo->edges[e].from == prev;
+        }
+    }
+    return 0;
+}
+
+int topology_is_chain(const topology_t* topo) {
+    for (int i = 0; i < topo->count; i++) {
+        if (!topology_follows(topo, i)) {
+            return 0;
+        }
+    }
+    return topology_inputs(topo, TOPOLOGY_OUTPUT) == 1 && outputs(topo, topo->count - 1) == 1;
+}
+
+static const char* tee_place_batch(void* target, message_t** msgs, int count) {
+    topology_tee_t* tee = (topology_tee_t*)target;
+    // Every reference exists before the first branch can free its share
+    for (int i = 0; i < count; i++) {
+        message_share(msgs[i], (unsigned)(tee->count - 1));
+    }
+    const char* first_err = NULL;
+    message_t* batch[TOPOLOGY_BATCH];
+    for (int b = 0; b < tee->count; b++) {
+        for (int done = 0; done < count;) {
+            int n = count - done < TOPOLOGY_BATCH ? count - done : TOPOLOGY_BATCH;
+            memcpy(batch, msgs + done, (size_t)n * sizeof *batch);
+            const char* err = message_sink_place_batch(&tee->outs[b], batch, n);
+            if (err && !first_err) {
+                first_err = err;
+            }
+            done += n;
+        }
+    }
+    return first_err;
+}
+
+static const char* tee_place(void* target, message_t* msg) {
+    return tee_place_batch(target, &msg, 1);
+}
+
+void topology_tee_init(topology_tee_t* tee, const message_sink_t* outs, int count, message_sink_t* sink) {
+    tee->outs = outs;
+    tee->count = count;
+    sink->place = tee_place;
+    sink->place_batch = tee_place_batch;
+    sink->target = tee;
+}
+
+static const char* merge_place_batch(void* target, message_t** msgs, int count) {
+    topology_merge_t* merge = (topology_merge_t*)target;
+    const char* first_err = NULL;
+    int start = 0;
+    for (int i = 0; i < count; i++) {
+        if (!message_is_end(msgs[i]) || atomic_fetch_sub(&merge->ends, 1) == 1) {
+            continue;
+        }
+        // Another branch is still running: this <END> stops here
+        const char* err = i > start ? message_sink_place_batch(&merge->next, msgs + start, i - start) : NULL;
+        if (err && !first_err) {
+            first_err = err;
+        }
+        message_free(msgs[i]);
+        start = i + 1;
+    }
+    const char* err = count > start ? message_sink_place_batch(&merge->next, msgs + start, count - start) : NULL;
+    return first_err ? first_err : err;
+}
+
+static const char* merge_place(void* target, message_t* msg) {
+    return merge_place_batch(target, &msg, 1);
+}
+
+void topology_merge_init(topology_merge_t* merge, int inputs, const message_sink_t* next, message_sink_t* sink) {
+    merge->next = *next;
+    atomic_init(&merge->ends, inputs);
+    sink->place = merge_place;
+    sink->place_batch = merge_place_batch;
+    sink->target = merge;
+}
+
+static const char* cow_place_batch(void* target, message_t** msgs, int count) {
+    topology_cow_t* cow = (topology_cow_t*)target;
+    const char* first_err = NULL;
+    message_t* batch[TOPOLOGY_BATCH];
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        message_t* msg = msgs[i];
+        if (message_make_writable(&msg) != 0) {
+            message_free(msg);
+            first_err = first_err ? first_err : "Memory allocation failed";
+            continue;
+        }
+        batch[n++] = msg;
+        if (n == TOPOLOGY_BATCH) {
+            const char* err = message_sink_place_batch(&cow->next, batch, n);
+            first_err = first_err ? first_err : err;
+            n = 0;
+        }
+    }
+    if (n > 0) {
+        const char* err = message_sink_place_batch(&cow->next, batch, n);
+        first_err = first_err ? first_err : err;
+    }
+    return first_err;
+}
+
+static const char* cow_place(void* target, message_t* msg) {
+    return cow_place_batch(target, &msg, 1);
+}
+
+void topology_cow_init(topology_cow_t* cow, const message_sink_t* next, message_sink_t* sink) {
+    cow->next = *next;
+    sink->place = cow_place;
+    sink->place_batch = cow_place_batch;
+    sink->target = cow;
+}
@@ -0,0 +1,139 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stdatomic.h>
+#include "message.h"
+
+/**
+ * Stage graph given on the command line. A list of plugins is a chain.
+ * "[ a b / c ]" is a group: each branch (a b, and c) receives every line
+ * that comes out of the element in front of the group (a tee), and the
+ * element after "]" receives the output of every branch (a merge). An
+ * empty branch passes lines through unchanged (once, however many empty
+ * branches a group has), groups nest, and the branches of a group that
+ * ends the command line each feed the output.
+ * Brackets and slashes are arguments of their own.
+ *
+ * A tee does not copy: every branch gets the same message with one
+ * reference each (message_share). A stage whose transform may write its
+ * input gets it through a copy-on-write sink, which copies only a message
+ * that is still shared by the time it gets there. Stages in front of the
+ * tee run once for all branches.
+ */
+
+/* Nodes that are not stages */
+#define TOPOLOGY_INPUT  (-1)    /* the host's reader */
+#define TOPOLOGY_OUTPUT (-2)    /* the final sink */
+
+// Deepest nesting of groups
+#define TOPOLOGY_MAX_DEPTH 16
+
+typedef struct {
+    int from;                   /* stage index or TOPOLOGY_INPUT */
+    int to;                     /* stage index or TOPOLOGY_OUTPUT */
+} topology_edge_t;
+
+typedef struct {
+    char** stages;              /* stage specs in command-line order (the arguments themselves) */
+    int count;
+    topology_edge_t* edges;     /* in the order they were parsed */
+    int edge_count;
+} topology_t;
+
+/* Sink handing every message to several sinks (see topology_tee_init) */
+typedef struct {
+    const message_sink_t* outs;
+    int count;
+} topology_tee_t;
+
+/* Sink forwarding only the last of several <END>s (see topology_merge_init) */
+typedef struct {
+    message_sink_t next;
+    atomic_int ends;            /* <END>s still to come */
+} topology_merge_t;
+
+/* Sink giving the next one messages it may write (see topology_cow_init) */
+typedef struct {
+    message_sink_t next;
+} topology_cow_t;
+
+/**
+ * Parse the plugin arguments into a graph
+ * @param topo Filled with the graph
+ * @param args Plugin arguments and group tokens
+ * @param count Number of arguments
+ * @return NULL on success, error message on failure
+ */
+const char* topology_parse(topology_t* topo, char** args, int count);
+
+/**
+ * Free a parsed graph
+ * @param topo Graph
+ */
+void topology_free(topology_t* topo);
+
+/**
+ * Whether the graph is a plain chain: stage i feeds stage i + 1 only
+ * @param topo Graph
+ * @return Non-zero for a chain
+ */
+int topology_is_chain(const topology_t* topo);
+
+/**
+ * Number of edges into a node
+ * @param topo Graph
+ * @param node Stage index or TOPOLOGY_OUTPUT
+ * @return In-degree
+ */
+int topology_inputs(const topology_t* topo, int node);
+
+/**
+ * Successors of a node, one entry per edge
+ * @param topo Graph
+ * @param node Stage index or TOPOLOGY_INPUT
+ * @param out Filled with stage indices or TOPOLOGY_OUTPUT (room for edge_count)
+ * @return Number of successors
+ */
+int topology_successors(const topology_t* topo, int node, int* out);
+
+/**
+ * Whether a stage is fed by the node in front of it (stage - 1, or the
+ * input for stage 0) and nothing else, and that node feeds nothing else,
+ * so the two can share a thread
+ * @param topo Graph
+ * @param stage Stage index
+ * @return Non-zero if so
+ */
+int topology_follows(const topology_t* topo, int stage);
+
+/**
+ * Make a sink that hands every message to each of several sinks, adding a
+ * reference per extra branch instead of copying
+ * @param tee Tee storage (must live as long as the sink)
+ * @param outs Branch sinks (must live as long as the sink)
+ * @param count Number of branch sinks
+ * @param sink Filled with the tee's sink
+ */
+void topology_tee_init(topology_tee_t* tee, const message_sink_t* outs, int count, message_sink_t* sink);
+
+/**
+ * Make a sink in front of a stage fed by several branches. Each branch
+ * forwards an <END>; only the last one goes on.
+ * @param merge Merge storage (must live as long as the sink)
+ * @param inputs Number of edges into the stage
+ * @param next The stage's sink
+ * @param sink Filled with the merge's sink
+ */
+void topology_merge_init(topology_merge_t* merge, int inputs, const message_sink_t* next, message_sink_t* sink);
+
+/**
+ * Make a sink that replaces every shared message by a private copy
+ * (message_make_writable) before handing it on. A copy that cannot be
+ * allocated loses its line, as a full shedding queue would.
+ * @param cow Storage (must live as long as the sink)
+ * @param next Sink of a stage that writes its input
+ * @param sink Filled with the copy-on-write sink
+ */
+void topology_cow_init(topology_cow_t* cow, const message_sink_t* next, message_sink_t* sink);
+
+#endif /* TOPOLOGY_H */
@@ -0,0 +1,85 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+/**
+ * Minimal io_uring ring over the raw system calls (--io=uring).
+ * A ring serves one file descriptor, registered as fixed file 0, and a
+ * set of buffers registered once, so reads and writes are READ_FIXED and
+ * WRITE_FIXED on pinned memory with no per-call file or page lookups.
+ * The ring belongs to one thread at a time.
+ */
+
+typedef struct {
+    int fd;                     /* the ring */
+    void* sq_map;
+    size_t sq_map_size;
+    void* cq_map;               /* may be sq_map (single mmap) */
+    size_t cq_map_size;
+    void* sqes_map;
+    size_t sqes_map_size;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    unsigned queued;            /* SQEs not yet handed to the kernel */
+} uring_t;
+
+/**
+ * Set up a ring and register a file and buffers with it
+ * @param ring Ring to set up
+ * @param entries Submission queue size (a power of two)
+ * @param file File descriptor the ring reads or writes, as fixed file 0
+ * @param buffers Buffers to register, by index
+ * @param count Number of buffers
+ * @return NULL on success, or why io_uring cannot be used
+ */
+const char* uring_init(uring_t* ring, unsigned entries, int file, const struct iovec* buffers, unsigned count);
+
+/**
+ * Tear down a ring (waits for nothing: call it with no I/O in flight)
+ * @param ring Ring from uring_init
+ */
+void uring_free(uring_t* ring);
+
+/**
+ * Queue a READ_FIXED or WRITE_FIXED on fixed file 0
+ * @param ring Ring
+ * @param write Non-zero for a write
+ * @param buf_index Registered buffer the memory lies in
+ * @param addr Start of the transfer, inside that buffer
+ * @param len Bytes to transfer
+ * @param offset File offset, or (uint64_t)-1 for the file position
+ * @param user_data Returned with the completion
+ * @return 0, or -1 when the submission queue is full
+ */
+int uring_queue(uring_t* ring, int write, unsigned buf_index, void* addr, unsigned len, uint64_t offset,
+                uint64_t user_data);
+
+/**
+ * Hand queued requests to the kernel and wait for completions, in one call
+ * @param ring Ring
+ * @param wait Completions to wait for (0: just submit)
+ * @return 0 on success, negative errno on failure
+ */
+int uring_submit(uring_t* ring, unsigned wait);
+
+/**
+ * Take one completion, if there is one
+ * @param ring Ring
+ * @param user_data Set to the request's user_data
+ * @param res Set to the request's result (bytes, or negative errno)
+ * @return 1 if a completion was taken, 0 if none is ready
+ */
+int uring_complete(uring_t* ring, uint64_t* user_data, int* res);
+
+#endif /* URING_H */
@@ -1,8 +1,29 @@
 #define _POSIX_C_SOURCE 200809L
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <dlfcn.h>
+#include <unistd.h>
+#include "consumer_producer.h"
+#include "message.h"
+#include "host_services.h"
+#include "plugin_abi.h"
+#include "msg_alloc.h"
+#include "replica.h"
+#include "ingest.h"
+#include "file_input.h"
+#include "output.h"
+#include "stats_report.h"
+#include "latency.h"
+#include "placement.h"
+#include "executor.h"
+#include "topology.h"
+#include "memo.h"
+#include "pacer.h"
+#ifdef ANALYZER_STATIC
+#include "static_registry.h"
+#endif
 
 
 typedef const char* (*plugin_init_t)(int);
@@ -10,33 +31,1004 @@ typedef const char* (*plugin_fini_t)(void);
 typedef const char* (*plugin_place_work_t)(const char*);
 typedef void        (*plugin_attach_t)(const char* (*)(const char*));
 typedef const char* (*plugin_wait_finished_t)(void);
+typedef void        (*plugin_get_message_sink_t)(message_sink_t*);
+typedef void        (*plugin_attach_message_sink_t)(const message_sink_t*);
+typedef void        (*plugin_set_host_services_t)(const host_services_t*);
+typedef const plugin_descriptor_t* (*plugin_get_descriptor_t)(void);
+typedef void        (*plugin_get_stats_t)(stage_stats_t*);
 
 typedef struct {
     void* handle;
     char* name;
+    const plugin_descriptor_t* desc;                  /* v2 plugins; NULL for v1 */
+    plugin_instance_t* instance;                      /* this stage's v2 instance */
     plugin_init_t init;
     plugin_fini_t fini;
     plugin_place_work_t place_work;
     plugin_attach_t attach;
     plugin_wait_finished_t wait_finished;
+    plugin_get_message_sink_t get_message_sink;       /* optional */
+    plugin_attach_message_sink_t attach_message_sink; /* optional */
+    plugin_set_host_services_t set_host_services;     /* optional */
+    plugin_get_stats_t get_stats;                     /* optional */
+    message_sink_t sink;                              /* this plugin's input as a message sink */
+    message_transform_t transform;                    /* v2 only: process functions and capabilities */
+    int fused;                                        /* runs inline on the previous stage's thread,
+                                                         or on the --input workers */
+    int replicas;                                     /* threads running this stage (name@N) */
+    replica_stage_t* replica;                         /* host-run stage when replicas > 1 */
+    int queue_size;                                   /* capacity of its input queue */
+    const char* queue_policy;                         /* overflow policy text; NULL = block */
+    int queue_options;                                /* cap=, policy= or rate= given for this stage */
+    pacer_rate_t rate;                                /* rate= and burst=; rate.rate 0: not paced */
+    int tasked;                                       /* runs on the executor (--executor) */
+    executor_stage_t* task;                           /* its task stage */
+    int copy_input;                                   /* gets its input through a copy-on-write sink */
+    stage_counters_t stats;                           /* fused stages: work done inline */
 } plugin_handle_t;
 
+#ifndef ANALYZER_STATIC
+typedef void (*static_chain_fn)(message_t** msgs, int count);
+#endif
+
+// Lines a cached run looks up at a time
+#define FUSED_MEMO_BATCH 64
+
+/*
+ * Consecutive pure stages run on the thread of the stage in front of them.
+ * The run sits between that stage and the next real one as a message sink.
+ */
+typedef struct {
+    plugin_handle_t* stages;     /* fused stages, in chain order */
+    int count;
+    int first;                   /* chain index of stages[0] */
+    message_sink_t next;         /* where the run forwards */
+    char* memo_inputs;           /* --memo: inputs of the lines that missed, MEMO_MAX_LINE apart */
+    static_chain_fn chain;       /* analyzer-static: the stages specialized into one loop, or NULL */
+} fused_run_t;
+
+typedef struct {
+    const char* queue_backend;   /* "locked" or "spsc"; NULL keeps the plugin default */
+    const char* spin;            /* polls before a blocked queue endpoint parks; NULL = auto */
+    int malloc_messages;         /* use malloc instead of the slab allocator */
+    int fuse;                    /* fuse consecutive pure stages into one thread */
+    int unordered;               /* replicated stages may reorder their output */
+    const char* input;           /* file processed in parallel chunks instead of stdin */
+    int jobs;                    /* --input workers; 0 = one per CPU */
+    const char* flush;           /* output flush policy; NULL = default */
+    int stats;                   /* print statistics once the input is drained */
+    stats_format_t stats_format;
+    int latency;                 /* per-hop and end-to-end latency histograms */
+    const char* trace;           /* Chrome trace file for sampled lines */
+    uint64_t trace_sample;       /* trace one line in this many */
+    const char* pin;             /* "auto" or a CPU list; NULL leaves threads unpinned */
+    int executor;                /* pure stages run on a pool of this many workers; 0 = off, -1 = one per CPU */
+    const char* queue_policy;    /* overflow policy for stages without their own; NULL = block */
+    size_t memo;                 /* result cache entries for runs of pure stages; 0 = off */
+    int io_uring;                /* stdin and stdout go through io_uring */
+} host_options_t;
+
+/* Everything a statistics report reads, for --stats and SIGUSR1 */
+typedef struct {
+    plugin_handle_t* plugins;
+    int args_num;
+    int chunked;                 /* leading stages run by the --input workers */
+    int jobs;
+    stage_counters_t* input_counters; /* jobs * chunked, worker-major */
+    uint64_t start_ns;
+    stats_format_t format;
+} stats_source_t;
+
+/* CPU picked for the stage being created, -1 when --pin is off */
+static int creating_cpu = -1;
+
+/* Overflow policy of the stage being created */
+static const char* creating_policy;
+
+static int host_stage_cpu(void) {
+    return creating_cpu;
+}
+
+static const char* host_stage_queue_policy(void) {
+    return creating_policy;
+}
+
+/* Services handed to every plugin through plugin_set_host_services() */
+static host_services_t host_services = {
+    .size = sizeof(host_services_t),
+    .msg_alloc = msg_alloc,
+    .msg_free = msg_free,
+    .output_write = output_write,
+    .stage_cpu = host_stage_cpu,
+    .stage_queue_policy = host_stage_queue_policy,
+};
+
+static void* host_malloc(size_t size, size_t* usable) {
+    void* ptr = malloc(size);
+    if (ptr && usable) *usable = size;
+    return ptr;
+}
+
 static void print_usage(void) {
     fprintf(stdout,
-        "Usage: ./main <queue_size> plugin1 [plugin2 ...]\n"
+        "Usage: ./main [options] <queue_size> plugin1[@N][,cap=N][,policy=P][,rate=N[B][,burst=N]] [plugin2... ...]\n"
         "  queue_size: Maximum number of items in each plugin's queue\n"
         "  plugin1 [plugin2 ...]: Plugins to load (in order) from: logger,typewriter,uppercaser,rotator,flipper,expander\n"
+        "  [ a b / c ]: Branches a b and c each get every line; the plugin after ] gets the lines of all of them\n"
+        "  @N: Run a pure plugin on N threads sharing its queue (e.g. expander@4)\n"
+        "  ,cap=N: Capacity of this plugin's queue (default: queue_size)\n"
+        "  ,policy=P: What a full queue does with new lines (default: --queue-policy)\n"
+        "  ,rate=N[B]: Let at most N lines (NB: bytes) a second into this plugin; ,burst=N: bucket size\n"
+        "Options:\n"
+        "  --queue-backend=locked|spsc: Queue implementation between stages (default: locked)\n"
+        "  --spin=N: Polls before a blocked stage parks on its futex (default: 0 on one CPU, 256 otherwise)\n"
+        "  --allocator=slab|malloc: Message allocator shared by all stages (default: slab)\n"
+        "  --fuse: Run consecutive pure stages (uppercaser, rotator, flipper, expander) on one thread\n"
+        "  --unordered: Let replicated stages emit lines as soon as they are done\n"
+        "  --input=PATH: Read PATH instead of stdin, running the leading pure plugins on parallel chunks\n"
+        "  --jobs=N: Worker threads for --input (default: one per CPU)\n"
+        "  --flush=size:BYTES|linger:MS|end: When buffered logger/typewriter output is written (default: linger:10)\n"
+        "  --latency: Report per-stage and end-to-end line latency (p50/p99/p999) to stderr at the end\n"
+        "  --trace=PATH: Also write sampled lines' hops to PATH as Chrome trace-event JSON (implies --latency)\n"
+        "  --trace-sample=N: Trace one line in N (default: %d)\n"
+        "  --executor[=N]: Run pure stages as tasks on N work-stealing workers (default: one per CPU)\n"
+        "  --memo[=N]: Cache the output of each run of pure stages for N lines (default: %d) and replay repeats\n"
+        "  --queue-policy=block|timeout:MS|drop-newest|drop-oldest|sample[:N]|spill[:DIR]: Overflow policy of every queue (default: block)\n"
+        "  --io=sync|uring: Read stdin and write output with read()/writev() (default) or io_uring\n"
+        "  --pin=auto|LIST: Pin each stage thread to its own CPU (auto: cache-topology order, or e.g. 0-3,8)\n"
+        "  --stats[=text|json]: Print per-stage and per-queue statistics to stderr at the end (SIGUSR1 prints them any time)\n",
+        LATENCY_DEFAULT_SAMPLE, MEMO_DEFAULT_ENTRIES
     );
 }
 
+/*
+ * Parse leading --options.
+ * @return index of the first positional argument, or -1 on error
+ */
+static int parse_host_options(int argc, char** argv, host_options_t* opts) {
+    int i = 1;
+    for (; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--queue-backend=", 16) == 0) {
+            consumer_producer_backend_t backend;
+            opts->queue_backend = arg + 16;
+            if (consumer_producer_backend_parse(opts->queue_backend, &backend) != 0) {
+                fprintf(stderr, "Error: unknown queue backend '%s'.\n", opts->queue_backend);
+                return -1;
+            }
+        } else if (strncmp(arg, "--spin=", 7) == 0) {
+            char* end = NULL;
+            long spin = strtol(arg + 7, &end, 10);
+            if (end == arg + 7 || *end != '\0' || spin < 0) {
+                fprintf(stderr, "Error: --spin expects a non-negative integer.\n");
+                return -1;
+            }
+            opts->spin = arg + 7;
+        } else if (strcmp(arg, "--allocator=slab") == 0) {
+            opts->malloc_messages = 0;
+        } else if (strcmp(arg, "--allocator=malloc") == 0) {
+            opts->malloc_messages = 1;
+        } else if (strcmp(arg, "--fuse") == 0) {
+            opts->fuse = 1;
+        } else if (strcmp(arg, "--unordered") == 0) {
+            opts->unordered = 1;
+        } else if (strncmp(arg, "--input=", 8) == 0 && arg[8] != '\0') {
+            opts->input = arg + 8;
+        } else if (strncmp(arg, "--jobs=", 7) == 0) {
+            char* end = NULL;
+            long jobs = strtol(arg + 7, &end, 10);
+            if (end == arg + 7 || *end != '\0' || jobs < 1 || jobs > FILE_INPUT_MAX_JOBS) {
+                fprintf(stderr, "Error: --jobs expects an integer between 1 and %d.\n", FILE_INPUT_MAX_JOBS);
+                return -1;
+            }
+            opts->jobs = (int)jobs;
+        } else if (strncmp(arg, "--flush=", 8) == 0) {
+            output_policy_t policy;
+            if (output_policy_parse(arg + 8, &policy) != 0) {
+                fprintf(stderr, "Error: --flush expects size:BYTES, linger:MS or end.\n");
+                return -1;
+            }
+            opts->flush = arg + 8;
+        } else if (strcmp(arg, "--stats") == 0) {
+            opts->stats = 1;
+            opts->stats_format = STATS_FORMAT_TEXT;
+        } else if (strncmp(arg, "--stats=", 8) == 0) {
+            if (stats_format_parse(arg + 8, &opts->stats_format) != 0) {
+                fprintf(stderr, "Error: --stats expects text or json.\n");
+                return -1;
+            }
+            opts->stats = 1;
+        } else if (strcmp(arg, "--latency") == 0) {
+            opts->latency = 1;
+        } else if (strncmp(arg, "--trace=", 8) == 0 && arg[8] != '\0') {
+            opts->trace = arg + 8;
+            opts->latency = 1;
+        } else if (strncmp(arg, "--trace-sample=", 15) == 0) {
+            char* end = NULL;
+            long long every = strtoll(arg + 15, &end, 10);
+            if (end == arg + 15 || *end != '\0' || every < 1) {
+                fprintf(stderr, "Error: --trace-sample expects a positive integer.\n");
+                return -1;
+            }
+            opts->trace_sample = (uint64_t)every;
+        } else if (strcmp(arg, "--executor") == 0) {
+            opts->executor = -1;
+        } else if (strncmp(arg, "--executor=", 11) == 0) {
+            char* end = NULL;
+            long workers = strtol(arg + 11, &end, 10);
+            if (end == arg + 11 || *end != '\0' || workers < 1 || workers > EXECUTOR_MAX_WORKERS) {
+                fprintf(stderr, "Error: --executor expects an integer between 1 and %d.\n", EXECUTOR_MAX_WORKERS);
+                return -1;
+            }
+            opts->executor = (int)workers;
+        } else if (strncmp(arg, "--queue-policy=", 15) == 0) {
+            consumer_producer_policy_t policy;
+            if (consumer_producer_policy_parse(arg + 15, &policy) != 0) {
+                fprintf(stderr, "Error: unknown queue policy '%s'.\n", arg + 15);
+                return -1;
+            }
+            opts->queue_policy = policy.overflow == CP_POLICY_BLOCK ? NULL : arg + 15;
+        } else if (strcmp(arg, "--memo") == 0) {
+            opts->memo = MEMO_DEFAULT_ENTRIES;
+        } else if (strncmp(arg, "--memo=", 7) == 0) {
+            char* end = NULL;
+            long long entries = strtoll(arg + 7, &end, 10);
+            if (end == arg + 7 || *end != '\0' || entries < MEMO_SHARDS || entries > INT_MAX) {
+                fprintf(stderr, "Error: --memo expects an integer between %d and %d.\n", MEMO_SHARDS, INT_MAX);
+                return -1;
+            }
+            opts->memo = (size_t)entries;
+        } else if (strcmp(arg, "--io=sync") == 0) {
+            opts->io_uring = 0;
+        } else if (strcmp(arg, "--io=uring") == 0) {
+            opts->io_uring = 1;
+        } else if (strncmp(arg, "--pin=", 6) == 0 && arg[6] != '\0') {
+            opts->pin = arg + 6;
+        } else {
+            fprintf(stderr, "Error: unknown option '%s'.\n", arg);
+            return -1;
+        }
+    }
+    return i;
+}
+
+/* A v1 stage: the plugin's single default context, queue and consumer thread */
+static int runs_in_v1_plugin(const plugin_handle_t* plugin) {
+    return !plugin->desc && !plugin->fused && !plugin->tasked && plugin->replica == NULL && plugin->replicas <= 1;
+}
+
+/* Stage can forward messages (v2, or v1 with plugin_attach_message_sink) */
+static int speaks_messages(const plugin_handle_t* plugin) {
+    return plugin->desc || plugin->attach_message_sink;
+}
+
+/*
+ * The SPSC backend needs one producer and one consumer per queue. A v1 plugin
+ * listed twice shares one .so (and one queue) across two stages, so fall back
+ * to the locked backend in that case. v2 plugins get one instance per stage.
+ * A stage where branches merge has a producer per branch.
+ */
+static void apply_queue_backend(const host_options_t* opts, plugin_handle_t* plugins, int args_num,
+                                const topology_t* topo) {
+    const char* backend = opts->queue_backend;
+    if (backend == NULL) return;
+    if (strcmp(backend, "spsc") == 0) {
+        for (int i = 0; i < args_num; i++) {
+            if (topology_inputs(topo, i) > 1 && !plugins[i].fused && strcmp(backend, "spsc") == 0) {
+                fprintf(stderr, "Warning: plugin %s merges several branches, using the locked queue backend\n",
+                        plugins[i].name);
+                backend = "locked";
+            }
+            for (int k = i + 1; k < args_num; k++) {
+                if (runs_in_v1_plugin(&plugins[i]) && runs_in_v1_plugin(&plugins[k]) &&
+                    strcmp(plugins[i].name, plugins[k].name) == 0) {
+                    fprintf(stderr, "Warning: plugin %s is used twice, using the locked queue backend\n", plugins[i].name);
+                    backend = "locked";
+                }
+            }
+        }
+    }
+    setenv(CP_BACKEND_ENV, backend, 1);
+}
+
+#define STAGE_STR(x) #x
+#define STAGE_XSTR(x) STAGE_STR(x)
+
+/*
+ * Split "name[@N][,cap=N][,policy=P][,rate=N[B]][,burst=N]" into the plugin
+ * name, its replica count, its queue options and its rate. The name is cut
+ * off in place.
+ * @return NULL on success, error message on failure
+ */
+static const char* parse_stage_spec(char* spec, plugin_handle_t* plugin) {
+    char* options = strchr(spec, ',');
+    if (options) {
+        *options++ = '\0';
+    }
+    plugin->replicas = 1;
+    char* at = strchr(spec, '@');
+    if (at) {
+        char* end = NULL;
+        long n = strtol(at + 1, &end, 10);
+        if (end == at + 1 || *end != '\0' || n < 1 || n > REPLICA_MAX) {
+            return "bad replica count (expected 1.." STAGE_XSTR(REPLICA_MAX) ")";
+        }
+        *at = '\0';
+        plugin->replicas = (int)n;
+    }
+    while (options) {
+        char* option = options;
+        options = strchr(options, ',');
+        if (options) {
+            *options++ = '\0';
+        }
+        if (strncmp(option, "cap=", 4) == 0) {
+            char* end = NULL;
+            long cap = strtol(option + 4, &end, 10);
+            if (end == option + 4 || *end != '\0' || cap < 1 || cap > INT_MAX) {
+                return "cap= expects a positive integer";
+            }
+            plugin->queue_size = (int)cap;
+        } else if (strncmp(option, "policy=", 7) == 0) {
+            consumer_producer_policy_t policy;
+            if (consumer_producer_policy_parse(option + 7, &policy) != 0) {
+                return "unknown queue policy";
+            }
+            plugin->queue_policy = policy.overflow == CP_POLICY_BLOCK ? NULL : option + 7;
+        } else if (strncmp(option, "rate=", 5) == 0) {
+            if (pacer_rate_parse(option + 5, &plugin->rate) != 0) {
+                return "rate= expects a positive integer, with B for bytes";
+            }
+        } else if (strncmp(option, "burst=", 6) == 0) {
+            char* end = NULL;
+            long long burst = strtoll(option + 6, &end, 10);
+            if (end == option + 6 || *end != '\0' || burst < 1) {
+                return "burst= expects a positive integer";
+            }
+            plugin->rate.burst = (uint64_t)burst;
+        } else {
+            return "unknown stage option (expected cap=N, policy=P, rate=N[B] or burst=N)";
+        }
+        plugin->queue_options = 1;
+    }
+    if (plugin->rate.burst && !plugin->rate.rate) {
+        return "burst= without rate=";
+    }
+    return NULL;
+}
+
+/*
+ * Set up a plugin linked into the binary (analyzer-static): a v2 plugin
+ * with nothing to look up
+ * @param name Plugin name
+ * @param plugin Filled in when it is built in
+ * @return Non-zero if it is
+ */
+static int load_builtin_plugin(const char* name, plugin_handle_t* plugin) {
+#ifdef ANALYZER_STATIC
+    const static_plugin_t* builtin = static_registry_find(name);
+    if (builtin) {
+        plugin->desc = builtin->get_descriptor();
+        plugin->transform = plugin->desc->transform;
+        plugin->set_host_services = builtin->set_host_services;
+        return 1;
+    }
+#else
+    (void)name;
+    (void)plugin;
+#endif
+    return 0;
+}
+
 /* Sink for the last plugin: accept work and return NULL so the pipeline can drain */
 static const char* sink_place_work(const char* s) {
     (void)s; /* intentionally ignore */
     return NULL;
 }
 
+/*
+ * Message sink after the last plugin: the pipeline ends here, release the
+ * message. Everything in front of a FLUSH or BARRIER has been written to
+ * the output buffers by now, so it is drained (FLUSH) or handed to the
+ * writer (BARRIER) here.
+ */
+static const char* sink_place_message(void* target, message_t* msg) {
+    (void)target;
+    if (msg->kind == MESSAGE_FLUSH) {
+        output_flush();
+    } else if (msg->kind == MESSAGE_BARRIER) {
+        output_cut();
+    }
+    message_free(msg);
+    return NULL;
+}
+
+static const char* sink_place_message_batch(void* target, message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        (void)sink_place_message(target, msgs[i]);
+    }
+    return NULL;
+}
+
+/* Adapter for plugins without a message sink: their place_work copies the string */
+static const char* v1_place_message(void* target, message_t* msg) {
+    plugin_handle_t* plugin = (plugin_handle_t*)target;
+    const char* err = plugin->place_work(msg->data);
+    message_free(msg);
+    return err;
+}
+
+/*
+ * Resolve the message sink feeding a plugin: its own zero-copy sink when it
+ * exports one (and shares our allocator), otherwise the copying place_work
+ * adapter
+ */
+static void resolve_message_sink(plugin_handle_t* plugin) {
+    if (plugin->replica) {
+        replica_stage_get_sink(plugin->replica, &plugin->sink);
+    } else if (plugin->task) {
+        executor_stage_get_sink(plugin->task, &plugin->sink);
+    } else if (plugin->desc) {
+        plugin->desc->get_message_sink(plugin->instance, &plugin->sink);
+    } else if (plugin->get_message_sink && plugin->set_host_services) {
+        plugin->get_message_sink(&plugin->sink);
+    } else {
+        plugin->sink.place = v1_place_message;
+        plugin->sink.place_batch = NULL;
+        plugin->sink.target = plugin;
+    }
+}
+
+/*
+ * Apply a specialized run: every stage on each line in turn. Its stages
+ * are not timed apart, so the run's work is counted on its first stage.
+ */
+static void fused_process_chain(fused_run_t* run, message_t** msgs, int data, uint64_t bytes) {
+    uint64_t start = stats_now_ns();
+    run->chain(msgs, data);
+    uint64_t busy = stats_now_ns() - start;
+    uint64_t bytes_out = 0;
+    for (int i = 0; i < data; i++) {
+        bytes_out += msgs[i]->len;
+    }
+    stage_counters_record(&run->stages[0].stats, (uint64_t)data, bytes, bytes_out, busy);
+}
+
+/* Apply every fused stage to a run of lines */
+static void fused_process(fused_run_t* run, message_t** msgs, int data) {
+    uint64_t bytes = 0;
+    for (int i = 0; i < data; i++) {
+        bytes += msgs[i]->len;
+    }
+    // --latency times every hop, which needs the stages one at a time
+    if (run->chain && !latency_enabled()) {
+        fused_process_chain(run, msgs, data, bytes);
+        return;
+    }
+    for (int s = 0; s < run->count; s++) {
+        const message_transform_t* t = &run->stages[s].transform;
+        uint64_t start = stats_now_ns();
+        if (t->process_batch) {
+            t->process_batch(msgs, data);
+        } else {
+            for (int i = 0; i < data; i++) {
+                const char* err = t->process(msgs[i]);
+                if (err) {
+                    fprintf(stderr, "[ERROR][%s] - %s\n", run->stages[s].name, err);
+                }
+            }
+        }
+        uint64_t busy = stats_now_ns() - start;
+        uint64_t bytes_out = 0;
+        for (int i = 0; i < data; i++) {
+            bytes_out += msgs[i]->len;
+        }
+        stage_counters_record(&run->stages[s].stats, (uint64_t)data, bytes, bytes_out, busy);
+        bytes = bytes_out;
+        if (latency_enabled()) {
+            latency_record_hop(run->first + s, msgs, data);
+        }
+    }
+}
+
+/*
+ * With --memo, lines the run has seen before take their cached output; the
+ * rest go through the stages, and what comes out is cached
+ */
+static void fused_process_memo(fused_run_t* run, message_t** msgs, int data) {
+    message_t* missed[FUSED_MEMO_BATCH];
+    uint64_t hashes[FUSED_MEMO_BATCH];
+    size_t lens[FUSED_MEMO_BATCH];
+    for (int start = 0; start < data; start += FUSED_MEMO_BATCH) {
+        int n = data - start < FUSED_MEMO_BATCH ? data - start : FUSED_MEMO_BATCH;
+        int misses = 0;
+        for (int i = start; i < start + n; i++) {
+            message_t* msg = msgs[i];
+            lens[misses] = msg->len;
+            if (msg->len <= MEMO_MAX_LINE) {
+                hashes[misses] = memo_hash(msg->data, msg->len);
+                if (memo_lookup(run->first, hashes[misses], msg)) {
+                    continue;
+                }
+                // The stages rewrite the line in place: keep the key
+                memcpy(run->memo_inputs + (size_t)misses * MEMO_MAX_LINE, msg->data, msg->len);
+            }
+            missed[misses++] = msg;
+        }
+        if (misses == 0) {
+            continue;
+        }
+        fused_process(run, missed, misses);
+        for (int m = 0; m < misses; m++) {
+            if (lens[m] <= MEMO_MAX_LINE) {
+                memo_store(run->first, hashes[m], run->memo_inputs + (size_t)m * MEMO_MAX_LINE, lens[m],
+                           missed[m]);
+            }
+        }
+    }
+}
+
+/* Process a batch's lines through the fused stages, then forward it in one handoff */
+static const char* fused_place_batch(void* target, message_t** msgs, int count) {
+    fused_run_t* run = (fused_run_t*)target;
+    for (int i = 0; i < count;) {
+        int data = message_data_run(msgs + i, count - i);
+        if (data > 0 && run->memo_inputs) {
+            fused_process_memo(run, msgs + i, data);
+        } else if (data > 0) {
+            fused_process(run, msgs + i, data);
+        }
+        i += data + 1;          /* past the control message, if any */
+    }
+    return message_sink_place_batch(&run->next, msgs, count);
+}
+
+static const char* fused_place_message(void* target, message_t* msg) {
+    return fused_place_batch(target, &msg, 1);
+}
+
+/*
+ * Set up a fused run of count stages from first on, forwarding to *sink,
+ * and make *sink the run's own sink. Runs are cached under --memo.
+ */
+static void fused_run_init(fused_run_t* run, plugin_handle_t* plugins, int first, int count, message_sink_t* sink) {
+    run->stages = &plugins[first];
+    run->count = count;
+    run->first = first;
+    run->next = *sink;
+    // Without its key buffer the run still works, uncached
+    run->memo_inputs = memo_enabled() ? malloc((size_t)FUSED_MEMO_BATCH * MEMO_MAX_LINE) : NULL;
+    run->chain = NULL;
+#ifdef ANALYZER_STATIC
+    const plugin_descriptor_t* descs[STATIC_CHAIN_MAX];
+    for (int s = 0; s < count && count <= STATIC_CHAIN_MAX; s++) {
+        descs[s] = run->stages[s].desc;
+    }
+    run->chain = count <= STATIC_CHAIN_MAX ? static_registry_find_chain(descs, count) : NULL;
+#endif
+    sink->place = fused_place_message;
+    sink->place_batch = fused_place_batch;
+    sink->target = run;
+}
+
+/*
+ * A stage can be fused when it is pure and speaks messages, so it can run
+ * on the previous stage's thread without a queue in between
+ */
+static int fusible(const plugin_handle_t* plugin) {
+    return plugin->desc && (plugin->transform.flags & MESSAGE_TRANSFORM_PURE) && plugin->replicas <= 1;
+}
+
+/* Whether a stage sees the lines of several branches, which share their seqs */
+static int after_merge(const topology_t* topo, int stage) {
+    if (topology_inputs(topo, stage) > 1) {
+        return 1;
+    }
+    for (int e = 0; e < topo->edge_count; e++) {
+        if (topo->edges[e].to == stage && topo->edges[e].from != TOPOLOGY_INPUT) {
+            return after_merge(topo, topo->edges[e].from);
+        }
+    }
+    return 0;
+}
+
+/*
+ * Replicas run the plugin's transform on host threads, which needs it to be
+ * pure (order-independent) and thread-safe. The messages must keep their seq
+ * on the way in, so the stage in front has to hand over messages rather than
+ * copies, and each seq has to arrive once.
+ */
+static void plan_replicas(plugin_handle_t* plugins, int args_num, const topology_t* topo) {
+    const unsigned needed = MESSAGE_TRANSFORM_PURE | MESSAGE_TRANSFORM_THREAD_SAFE;
+    for (int i = 0; i < args_num; i++) {
+        if (plugins[i].replicas <= 1) continue;
+        if (!plugins[i].desc || (plugins[i].transform.flags & needed) != needed) {
+            fprintf(stderr, "Warning: plugin %s is not stateless, running it on one thread\n", plugins[i].name);
+            plugins[i].replicas = 1;
+        } else if (after_merge(topo, i)) {
+            fprintf(stderr, "Warning: plugin %s gets the lines of several branches, running it on one thread\n",
+                    plugins[i].name);
+            plugins[i].replicas = 1;
+        } else if (i > 0 && !speaks_messages(&plugins[i - 1]) && plugins[i - 1].replicas <= 1) {
+            fprintf(stderr, "Warning: plugin %s cannot hand messages to %s@%d, running it on one thread\n",
+                    plugins[i - 1].name, plugins[i].name, plugins[i].replicas);
+            plugins[i].replicas = 1;
+        }
+    }
+}
+
+/*
+ * A v1 plugin without message sinks can only hand strings to a v1
+ * place_work, so a v2 plugin behind it runs through its v1 entry points
+ * (and its default instance) instead.
+ * @return index of a plugin that has to but cannot run as v1, or -1
+ */
+static int link_v1_plugins(plugin_handle_t* plugins, int args_num) {
+    for (int i = 0; i + 1 < args_num; i++) {
+        plugin_handle_t* next = &plugins[i + 1];
+        if (speaks_messages(&plugins[i]) || !next->desc) {
+            continue;
+        }
+        if (!next->init || !next->fini || !next->place_work || !next->attach || !next->wait_finished) {
+            return i + 1;
+        }
+        next->desc = NULL;
+    }
+    return -1;
+}
+
+/*
+ * Paced stages get a token bucket in front of their message sink, which a
+ * v1 plugin in front of them bypasses (it hands strings to place_work)
+ * @return number of paced stages
+ */
+static int plan_pacing(plugin_handle_t* plugins, int args_num) {
+    int paced = 0;
+    for (int i = 0; i < args_num; i++) {
+        if (!plugins[i].rate.rate) continue;
+        if (i > 0 && !speaks_messages(&plugins[i - 1])) {
+            fprintf(stderr, "Warning: plugin %s cannot hand messages to %s, which runs unpaced\n",
+                    plugins[i - 1].name, plugins[i].name);
+            plugins[i].rate.rate = 0;
+            continue;
+        }
+        paced++;
+    }
+    return paced;
+}
+
+/*
+ * Mark every pure stage that directly follows another pure stage as fused.
+ * A stage with its own queue options keeps its queue, and so does a stage
+ * next to a tee or a merge.
+ */
+static void plan_fusion(plugin_handle_t* plugins, int args_num, const topology_t* topo) {
+    for (int i = 1; i < args_num; i++) {
+        plugins[i].fused = fusible(&plugins[i]) && fusible(&plugins[i - 1]) && !plugins[i].queue_options &&
+                           topology_follows(topo, i);
+    }
+}
+
+/*
+ * With --input, the leading pure, thread-safe stages run on the chunk
+ * workers (one copy of them per worker), so they get no thread of their own.
+ * @return number of stages handed to the workers
+ */
+static int plan_file_input(plugin_handle_t* plugins, int args_num, const topology_t* topo) {
+    const unsigned needed = MESSAGE_TRANSFORM_PURE | MESSAGE_TRANSFORM_THREAD_SAFE;
+    int prefix = 0;
+    while (prefix < args_num && plugins[prefix].desc && plugins[prefix].replicas <= 1 &&
+           !plugins[prefix].queue_options && topology_follows(topo, prefix) &&
+           (plugins[prefix].transform.flags & needed) == needed) {
+        plugins[prefix++].fused = 1;
+    }
+    // The first remaining stage receives the merged chunks itself
+    if (prefix < args_num) {
+        plugins[prefix].fused = 0;
+    }
+    return prefix;
+}
+
+/*
+ * With --memo, each run of pure stages is fused onto the thread in front of
+ * it (the stdin reader for the first stages), so the cache sits in front of
+ * the whole run and a hit skips all of it. Replicas hand on lines from
+ * several threads at once, so a stage behind them keeps its thread.
+ */
+static void plan_memo(plugin_handle_t* plugins, int args_num, int chunked, const topology_t* topo) {
+    for (int i = chunked; i < args_num; i++) {
+        if (fusible(&plugins[i]) && !plugins[i].queue_options && topology_follows(topo, i) &&
+            (i == 0 || plugins[i - 1].replicas <= 1)) {
+            plugins[i].fused = 1;
+        }
+    }
+}
+
+/*
+ * With --executor, pure stages with a thread of their own become tasks on
+ * the worker pool. Stages with side effects keep their thread: their output
+ * leaves through per-thread buffers, which keep order only within a thread.
+ * Task inboxes always block when full, so stages with an overflow policy
+ * keep their queue and thread too, and they take one producer, so stages
+ * where branches merge do as well.
+ * @return number of task stages
+ */
+static int plan_executor(plugin_handle_t* plugins, int args_num, const topology_t* topo) {
+    int tasks = 0;
+    for (int i = 0; i < args_num; i++) {
+        plugins[i].tasked = plugins[i].desc && !plugins[i].fused && plugins[i].replicas <= 1 &&
+                            !plugins[i].queue_policy && topology_inputs(topo, i) <= 1 &&
+                            (plugins[i].transform.flags & MESSAGE_TRANSFORM_PURE);
+        tasks += plugins[i].tasked;
+    }
+    return tasks;
+}
+
+/*
+ * Whether a stage may change the messages it is given. Under --latency
+ * every stage does: the probe on its output restamps them.
+ */
+static int writes_input(const plugin_handle_t* plugin) {
+    return latency_enabled() || !(plugin->transform.flags & MESSAGE_TRANSFORM_READ_ONLY);
+}
+
+/*
+ * A stage right behind a tee may be handed a message another branch holds
+ * too, and so may a stage behind one that passed such a message on without
+ * writing it. Stages that write their input get those through a
+ * copy-on-write sink; the others read the shared message.
+ */
+static void plan_copies(plugin_handle_t* plugins, int args_num, const topology_t* topo) {
+    int* shared = calloc(args_num, sizeof(int));
+    int* succ = malloc((size_t)topo->edge_count * sizeof(int));
+    for (int e = 0; shared && succ && e < topo->edge_count; e++) {
+        // Edges are parsed in command-line order, so every stage's inputs are known before it is
+        int from = topo->edges[e].from;
+        int to = topo->edges[e].to;
+        if (to == TOPOLOGY_OUTPUT) {
+            continue;
+        }
+        if (topology_successors(topo, from, succ) > 1 ||
+            (from != TOPOLOGY_INPUT && shared[from] && !writes_input(&plugins[from]))) {
+            shared[to] = 1;
+        }
+    }
+    for (int i = 0; i < args_num; i++) {
+        // Without the scratch memory, copy whatever might be shared
+        plugins[i].copy_input = (!shared || !succ || shared[i]) && writes_input(&plugins[i]);
+    }
+    free(shared);
+    free(succ);
+}
+
+/* Sinks the topology puts between stages, kept for the life of the pipeline */
+typedef struct {
+    const topology_t* topo;
+    message_sink_t last;         /* the final sink */
+    message_sink_t* inputs;      /* per stage: its sink behind its merge, copy-on-write and pacing sinks */
+    topology_merge_t* merges;    /* per stage */
+    topology_cow_t* cows;        /* per stage */
+    pacer_stage_t** paces;       /* per stage, NULL: not paced */
+    topology_tee_t* tees;        /* per node, the input at 0 */
+    message_sink_t* tee_outs;    /* one per edge */
+    int tee_outs_used;
+    int* succ;                   /* scratch, one per edge */
+    int args_num;
+} graph_sinks_t;
+
+static const char* graph_sinks_init(graph_sinks_t* g, const topology_t* topo, plugin_handle_t* plugins,
+                                    int args_num, const message_sink_t* last) {
+    memset(g, 0, sizeof *g);
+    g->topo = topo;
+    g->last = *last;
+    g->inputs = calloc(args_num, sizeof(message_sink_t));
+    g->merges = calloc(args_num, sizeof(topology_merge_t));
+    g->cows = calloc(args_num, sizeof(topology_cow_t));
+    g->paces = calloc(args_num, sizeof(pacer_stage_t*));
+    g->args_num = args_num;
+    g->tees = calloc(args_num + 1, sizeof(topology_tee_t));
+    g->tee_outs = calloc(topo->edge_count, sizeof(message_sink_t));
+    g->succ = calloc(topo->edge_count, sizeof(int));
+    if (!g->inputs || !g->merges || !g->cows || !g->paces || !g->tees || !g->tee_outs || !g->succ) {
+        return "Memory allocation failed";
+    }
+    for (int i = 0; i < args_num; i++) {
+        if (plugins[i].fused) {
+            continue;
+        }
+        g->inputs[i] = plugins[i].sink;
+        if (plugins[i].rate.rate) {
+            const char* err = pacer_stage_create(&g->paces[i], &plugins[i].rate, plugins[i].queue_size,
+                                                 &g->inputs[i], &g->inputs[i]);
+            if (err) {
+                return err;
+            }
+        }
+        int inputs = topology_inputs(topo, i);
+        if (inputs > 1) {
+            topology_merge_init(&g->merges[i], inputs, &g->inputs[i], &g->inputs[i]);
+        }
+        if (plugins[i].copy_input) {
+            topology_cow_init(&g->cows[i], &g->inputs[i], &g->inputs[i]);
+        }
+    }
+    return NULL;
+}
+
+/* Sink for everything a node hands on: its one successor's, or a tee over all of them */
+static message_sink_t graph_node_output(graph_sinks_t* g, int node) {
+    int n = topology_successors(g->topo, node, g->succ);
+    message_sink_t* outs = g->tee_outs + g->tee_outs_used;
+    for (int k = 0; k < n; k++) {
+        outs[k] = g->succ[k] == TOPOLOGY_OUTPUT ? g->last : g->inputs[g->succ[k]];
+    }
+    if (n == 1) {
+        return outs[0];
+    }
+    g->tee_outs_used += n;
+    message_sink_t sink;
+    topology_tee_init(&g->tees[node + 1], outs, n, &sink);
+    return sink;
+}
+
+static void graph_sinks_free(graph_sinks_t* g) {
+    for (int i = 0; g->paces && i < g->args_num; i++) {
+        pacer_stage_destroy(g->paces[i]);
+    }
+    free(g->paces);
+    free(g->inputs);
+    free(g->merges);
+    free(g->cows);
+    free(g->tees);
+    free(g->tee_outs);
+    free(g->succ);
+}
+
+/* Shut down one stage, whichever way it runs (task stages after executor_stop()) */
+static const char* stage_fini(plugin_handle_t* plugin) {
+    if (plugin->replica) {
+        replica_stage_destroy(plugin->replica);
+        plugin->replica = NULL;
+        return NULL;
+    }
+    if (plugin->tasked) {
+        executor_stage_destroy(plugin->task);
+        plugin->task = NULL;
+        return NULL;
+    }
+    if (plugin->fused) {
+        return NULL;
+    }
+    if (plugin->desc) {
+        const char* err = plugin->instance ? plugin->desc->destroy(plugin->instance) : NULL;
+        plugin->instance = NULL;
+        return err;
+    }
+    return plugin->fini ? plugin->fini() : NULL;
+}
+
+/**
+ * Back out of a failed start-up: stop the shared workers, shut down the
+ * stages created so far and unload every plugin
+ * @param plugins Plugin handles (freed)
+ * @param created Number of leading stages that were created
+ * @param args_num Number of plugins
+ * @param topo Topology (freed)
+ */
+static void abort_startup(plugin_handle_t* plugins, int created, int args_num, topology_t* topo) {
+    executor_stop();
+    pacer_stop();
+    for (int k = created - 1; k >= 0; k--) {
+        (void)stage_fini(&plugins[k]);
+    }
+    for (int k = 0; k < args_num; k++) {
+        if (plugins[k].handle) dlclose(plugins[k].handle);
+        free(plugins[k].name);
+    }
+    free(plugins);
+    topology_free(topo);
+    memo_stop();
+}
+
+/* Snapshot one stage, wherever it runs */
+static void collect_stage_stats(const stats_source_t* src, int i, stats_entry_t* entry) {
+    plugin_handle_t* plugin = &src->plugins[i];
+    memset(entry, 0, sizeof *entry);
+    entry->name = plugin->name;
+    entry->available = 1;
+    if (i < src->chunked) {
+        entry->mode = "input";
+        for (int w = 0; src->input_counters && w < src->jobs; w++) {
+            stage_counters_read(&src->input_counters[w * src->chunked + i], &entry->stats);
+        }
+    } else if (plugin->fused) {
+        entry->mode = "fused";
+        stage_counters_read(&plugin->stats, &entry->stats);
+    } else if (plugin->replica) {
+        entry->mode = "replicas";
+        replica_stage_get_stats(plugin->replica, &entry->stats);
+    } else if (plugin->task) {
+        entry->mode = "task";
+        executor_stage_get_stats(plugin->task, &entry->stats);
+    } else if (plugin->desc) {
+        entry->mode = "thread";
+        if (PLUGIN_DESCRIPTOR_HAS(plugin->desc, get_stats)) {
+            plugin->desc->get_stats(plugin->instance, &entry->stats);
+        } else {
+            entry->available = 0;
+        }
+    } else {
+        entry->mode = "v1";
+        if (plugin->get_stats) {
+            plugin->get_stats(&entry->stats);
+        } else {
+            entry->available = 0;
+        }
+    }
+}
+
+static void print_stats(void* arg) {
+    const stats_source_t* src = (const stats_source_t*)arg;
+    stats_entry_t* entries = calloc(src->args_num, sizeof(stats_entry_t));
+    if (!entries) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return;
+    }
+    for (int i = 0; i < src->args_num; i++) {
+        collect_stage_stats(src, i, &entries[i]);
+    }
+    cache_stats_t cache;
+    memo_get_stats(&cache);
+    stats_report_print(stderr, entries, src->args_num, memo_enabled() ? &cache : NULL,
+                       stats_now_ns() - src->start_ns, src->format);
+    free(entries);
+}
+
+/* Say how many lines the overflow policies shed, stage by stage */
+static void report_dropped(const stats_source_t* src) {
+    for (int i = 0; i < src->args_num; i++) {
+        if (!src->plugins[i].queue_policy || src->plugins[i].fused) {
+            continue;
+        }
+        stats_entry_t entry;
+        collect_stage_stats(src, i, &entry);
+        if (entry.available && entry.stats.queue.dropped > 0) {
+            fprintf(stderr, "Warning: plugin %s dropped %llu lines (queue policy %s)\n", entry.name,
+                    (unsigned long long)entry.stats.queue.dropped, src->plugins[i].queue_policy);
+        }
+    }
+}
+
+/* Feed the <END> sentinel into the first stage, numbered after the last line */
+static const char* place_end(const message_sink_t* first, uint64_t seq) {
+    message_t* msg = message_control(MESSAGE_END);
+    if (!msg) {
+        return "Memory allocation failed";
+    }
+    msg->seq = seq;
+    return first->place(first->target, msg);
+}
+
 
 int main(int argc, char** argv) {
+    host_options_t opts = {0};
+    int first = parse_host_options(argc, argv, &opts);
+    if (first < 0) {
+        print_usage();
+        return 1;
+    }
+    if (opts.pin) {
+        const char* pin_err = placement_init(opts.pin);
+        if (pin_err) {
+            fprintf(stderr, "Error: --pin=%s: %s.\n", opts.pin, pin_err);
+            return 1;
+        }
+    }
+    // Before any thread exists, so only the stats reporter ever takes SIGUSR1
+    stats_signal_block();
+    uint64_t start_ns = stats_now_ns();
+    argc -= first - 1;
+    argv += first - 1;
     if (argc < 3) {
         fprintf(stderr, "Error: Missing arguments.\n");
         print_usage();
@@ -48,18 +1040,50 @@ int main(int argc, char** argv) {
         print_usage();
         return 1;
     }
-    int args_num = argc - 2;
+    topology_t topo;
+    const char* topo_err = topology_parse(&topo, argv + 2, argc - 2);
+    if (topo_err) {
+        fprintf(stderr, "Error: %s in the plugin list.\n", topo_err);
+        print_usage();
+        return 1;
+    }
+    int chain = topology_is_chain(&topo);
+    int args_num = topo.count;
+    if (opts.malloc_messages) {
+        host_services.msg_alloc = host_malloc;
+        host_services.msg_free = free;
+    }
+    message_set_allocator(host_services.msg_alloc, host_services.msg_free);
+    if (opts.spin != NULL) {
+        setenv(EVENTCOUNT_SPIN_ENV, opts.spin, 1);
+    }
     plugin_handle_t* plugins = calloc(args_num, sizeof(plugin_handle_t));
     if (!plugins) {
         fprintf(stderr, "Error: Memory allocation failed\n");
+        topology_free(&topo);
         return 1;
     }
     for (int i = 0; i < args_num; i++) {
-        const char* plugin_name = argv[i + 2];
+        char* plugin_name = topo.stages[i];
+        plugins[i].queue_size = queue_size;
+        plugins[i].queue_policy = opts.queue_policy;
+        const char* spec_err = parse_stage_spec(plugin_name, &plugins[i]);
+        if (spec_err) {
+            fprintf(stderr, "Error: %s in %s\n", spec_err, topo.stages[i]);
+            print_usage();
+            for (int k = 0; k < i; k++) {
+                if (plugins[k].handle) dlclose(plugins[k].handle);
+                free(plugins[k].name);
+            }
+            free(plugins);
+            topology_free(&topo);
+            return 1;
+        }
         char so_name[256];
         snprintf(so_name, sizeof(so_name), "./output/%s.so", plugin_name);
-        plugins[i].handle = dlopen(so_name, RTLD_NOW | RTLD_LOCAL);
-        if (!plugins[i].handle) {
+        int builtin = load_builtin_plugin(plugin_name, &plugins[i]);
+        plugins[i].handle = builtin ? NULL : dlopen(so_name, RTLD_NOW | RTLD_LOCAL);
+        if (!builtin && !plugins[i].handle) {
             fprintf(stderr, "Error loading plugin %s\n", plugin_name);
             print_usage();
 
@@ -70,6 +1094,7 @@ int main(int argc, char** argv) {
                 free( plugins[k].name );
             }
             free(plugins);
+            topology_free(&topo);
             return 1;
         }
         plugins[i].name = strdup(plugin_name);
@@ -84,18 +1109,37 @@ int main(int argc, char** argv) {
                 }
             }
             free(plugins);
+            topology_free(&topo);
             return 1;
         }
+        if (builtin) {
+            continue;
+        }
         plugins[i].init = (plugin_init_t)dlsym(plugins[i].handle, "plugin_init");
         plugins[i].fini = (plugin_fini_t)dlsym(plugins[i].handle, "plugin_fini");
         plugins[i].place_work = (plugin_place_work_t)dlsym(plugins[i].handle, "plugin_place_work");
         plugins[i].attach = (plugin_attach_t)dlsym(plugins[i].handle, "plugin_attach");
         plugins[i].wait_finished = (plugin_wait_finished_t)dlsym(plugins[i].handle, "plugin_wait_finished");
+        /* Message entry points are optional; plugins without them get copies through place_work */
+        plugins[i].get_message_sink = (plugin_get_message_sink_t)dlsym(plugins[i].handle, "plugin_get_message_sink");
+        plugins[i].attach_message_sink = (plugin_attach_message_sink_t)dlsym(plugins[i].handle, "plugin_attach_message_sink");
+        plugins[i].set_host_services = (plugin_set_host_services_t)dlsym(plugins[i].handle, "plugin_set_host_services");
+        plugins[i].get_stats = (plugin_get_stats_t)dlsym(plugins[i].handle, "plugin_get_stats");
+        if (!plugins[i].set_host_services) {
+            plugins[i].attach_message_sink = NULL;
+        }
+        /* v2: per-instance entry points; needs the host allocator to exchange messages */
+        plugin_get_descriptor_t get_descriptor =
+            (plugin_get_descriptor_t)dlsym(plugins[i].handle, "plugin_get_descriptor");
+        const plugin_descriptor_t* desc = get_descriptor ? get_descriptor() : NULL;
+        if (desc && plugins[i].set_host_services && desc->abi_version == PLUGIN_ABI_VERSION &&
+            desc->size >= PLUGIN_DESCRIPTOR_MIN_SIZE) {
+            plugins[i].desc = desc;
+            plugins[i].transform = desc->transform;
+        }
 
-        
-
-        if (!plugins[i].init || !plugins[i].fini || !plugins[i].place_work ||
-            !plugins[i].attach || !plugins[i].wait_finished) {
+        if (!plugins[i].desc && (!plugins[i].init || !plugins[i].fini || !plugins[i].place_work ||
+            !plugins[i].attach || !plugins[i].wait_finished)) {
             fprintf(stderr, "dlsym() failed for plugin %s: %s\n", so_name, dlerror());
             for ( int k = 0; k <= i; k++ ) {
                 if ( plugins[k].handle ) {
@@ -106,91 +1150,367 @@ int main(int argc, char** argv) {
                 }
             }
             free(plugins);
+            topology_free(&topo);
             return 1;
         }
     } 
 
-    
-    for (int i = 0; i < args_num; i++) {
-        const char* err = plugins[i].init(queue_size);
-        if (err) {
-            fprintf(stderr, "Plugin %s init() failed: %s\n", plugins[i].name, err);
-            for (int k = 0; k < i; k++) {
-                if (plugins[k].fini) plugins[k].fini();
+    // Strings cannot be shared between branches: off a chain, every stage hands on messages
+    for (int i = 0; !chain && i < args_num; i++) {
+        if (!speaks_messages(&plugins[i])) {
+            fprintf(stderr, "Error: plugin %s only supports the v1 string interface and cannot be used in branches\n",
+                    plugins[i].name);
+            for (int k = 0; k < args_num; k++) {
+                if (plugins[k].handle) dlclose(plugins[k].handle);
+                free(plugins[k].name);
             }
-            
-            for (int k = 0; k <= i; k++) {
+            free(plugins);
+            topology_free(&topo);
+            return 1;
+        }
+    }
+    int unlinkable = link_v1_plugins(plugins, args_num);
+    if (unlinkable >= 0) {
+        fprintf(stderr, "Error: plugin %s only supports the v1 string interface and cannot feed %s\n",
+                plugins[unlinkable - 1].name, plugins[unlinkable].name);
+        for (int k = 0; k < args_num; k++) {
+            if (plugins[k].handle) dlclose(plugins[k].handle);
+            free(plugins[k].name);
+        }
+        free(plugins);
+        topology_free(&topo);
+        return 1;
+    }
+    plan_replicas(plugins, args_num, &topo);
+    if (plan_pacing(plugins, args_num) > 0) {
+        const char* pacer_err = pacer_start();
+        if (pacer_err) {
+            fprintf(stderr, "Warning: rate limits disabled: %s\n", pacer_err);
+            for (int i = 0; i < args_num; i++) {
+                plugins[i].rate.rate = 0;
+            }
+        }
+    }
+    if (opts.fuse) {
+        plan_fusion(plugins, args_num, &topo);
+    }
+    int chunked = opts.input ? plan_file_input(plugins, args_num, &topo) : 0;
+    if (opts.memo) {
+        const char* memo_err = memo_start(opts.memo);
+        if (memo_err) {
+            fprintf(stderr, "Warning: result cache disabled: %s\n", memo_err);
+        } else {
+            plan_memo(plugins, args_num, chunked, &topo);
+        }
+    }
+    int tasks = opts.executor ? plan_executor(plugins, args_num, &topo) : 0;
+    apply_queue_backend(&opts, plugins, args_num, &topo);
+
+    // With --pin the stdin reader takes the first CPU, then the executor workers and stage threads
+    int ingest_cpu = opts.input ? -1 : placement_next_cpu();
+    int first_stage_cpu = -1;
+    if (tasks > 0) {
+        int workers = opts.executor;
+        if (workers < 0) {
+            long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+            workers = cpus < 1 ? 1 : cpus > EXECUTOR_MAX_WORKERS ? EXECUTOR_MAX_WORKERS : (int)cpus;
+        }
+        int worker_cpus[EXECUTOR_MAX_WORKERS];
+        for (int w = 0; w < workers; w++) {
+            worker_cpus[w] = placement_next_cpu();
+        }
+        const char* executor_err = executor_start(workers, worker_cpus);
+        if (executor_err) {
+            fprintf(stderr, "Error: %s\n", executor_err);
+            pacer_stop();
+            for (int k = 0; k < args_num; k++) {
                 if (plugins[k].handle) dlclose(plugins[k].handle);
-                if (plugins[k].name)   free(plugins[k].name);
+                free(plugins[k].name);
             }
             free(plugins);
+            topology_free(&topo);
+            return 1;
+        }
+    }
+    for (int i = 0; i < args_num; i++) {
+        if (plugins[i].set_host_services) {
+            plugins[i].set_host_services(&host_services);
+        }
+        if (plugins[i].fused) {
+            continue;
+        }
+        if (plugins[i].tasked) {
+            const char* err = executor_stage_create(&plugins[i].task, plugins[i].name, &plugins[i].transform,
+                                                    plugins[i].queue_size);
+            if (!err) {
+                continue;
+            }
+            fprintf(stderr, "Plugin %s init() failed: %s\n", plugins[i].name, err);
+            abort_startup(plugins, i, args_num, &topo);
+            return 1;
+        }
+        int cpus[REPLICA_MAX];
+        for (int r = 0; r < plugins[i].replicas; r++) {
+            cpus[r] = placement_next_cpu();
+        }
+        if (first_stage_cpu < 0) {
+            first_stage_cpu = cpus[0];
+        }
+        // Queues and instance state the stage allocates now land on its CPU's node
+        creating_cpu = cpus[0];
+        creating_policy = plugins[i].queue_policy;
+        placement_prefer_node(creating_cpu);
+        const char* err;
+        if (plugins[i].replicas > 1) {
+            consumer_producer_policy_t policy;
+            int shed = plugins[i].queue_policy &&
+                       consumer_producer_policy_parse(plugins[i].queue_policy, &policy) == 0;
+            err = replica_stage_create(&plugins[i].replica, plugins[i].name, &plugins[i].transform,
+                                       plugins[i].replicas, plugins[i].queue_size, !opts.unordered, cpus,
+                                       shed ? &policy : NULL);
+        } else if (plugins[i].desc) {
+            err = plugins[i].desc->create(&plugins[i].instance, plugins[i].queue_size);
+        } else {
+            err = plugins[i].init(plugins[i].queue_size);
+        }
+        creating_cpu = -1;
+        creating_policy = NULL;
+        placement_prefer_node(-1);
+        if (err) {
+            fprintf(stderr, "Plugin %s init() failed: %s\n", plugins[i].name, err);
+            abort_startup(plugins, i, args_num, &topo);
             return 1;
         }
     }
 
-    // Chain the plugins together
-    for (int i = 0; i + 1 < args_num; i++) {
-        plugins[i].attach(plugins[i + 1].place_work);
+    // Chain the plugins together; message-aware plugins hand messages over without copying.
+    // Fused stages are skipped: the stage in front of them runs them inline.
+    fused_run_t* runs = calloc(args_num, sizeof(fused_run_t));
+    if (!runs) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        abort_startup(plugins, args_num, args_num, &topo);
+        return 1;
     }
-    plugins[args_num - 1].attach(sink_place_work);
-     char line[1025];
-    int sent_end = 0;
+    for (int i = 0; i < args_num; i++) {
+        resolve_message_sink(&plugins[i]);
+    }
+    message_sink_t end = { sink_place_message, sink_place_message_batch, NULL };
 
-    while (fgets(line, sizeof(line), stdin) != NULL) {
-        // Trim \n or \r\n
-        size_t len = strlen(line);
-        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
-            line[--len] = '\0';
+    // With --latency every stage's output goes through a probe; the last one measures end to end
+    const char** stage_names = calloc(args_num, sizeof(const char*));
+    latency_probe_t* probes = calloc(args_num + 2, sizeof(latency_probe_t));
+    if (!stage_names || !probes) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        abort_startup(plugins, args_num, args_num, &topo);
+        free(runs);
+        free(probes);
+        free(stage_names);
+        return 1;
+    }
+    for (int i = 0; i < args_num; i++) {
+        stage_names[i] = plugins[i].name;
+    }
+    message_sink_t last_sink = end;
+    if (opts.latency) {
+        const char* latency_err = latency_start(args_num, stage_names, opts.trace,
+                                                opts.trace_sample ? opts.trace_sample : LATENCY_DEFAULT_SAMPLE);
+        if (latency_err) {
+            fprintf(stderr, "Warning: latency tracing disabled: %s\n", latency_err);
+        } else {
+            latency_probe_init(&probes[args_num], LATENCY_PROBE_EXIT, &end, &last_sink);
         }
-
-        // If sentinel, forward it into the pipeline and stop reading
-        if (strcmp(line, "<END>") == 0 || strcmp(line, "END") == 0) {
-            const char* err = plugins[0].place_work("<END>");
-            if (err) {
-                fprintf(stderr, "Error sending <END> to first plugin: %s\n", err);
+    }
+    // Tees share messages between branches, merges pass on one <END>, and stages that
+    // write their input get a copy of whatever is still shared
+    plan_copies(plugins, args_num, &topo);
+    graph_sinks_t graph;
+    const char* graph_err = graph_sinks_init(&graph, &topo, plugins, args_num, &last_sink);
+    if (graph_err) {
+        fprintf(stderr, "Error: %s\n", graph_err);
+        abort_startup(plugins, args_num, args_num, &topo);
+        graph_sinks_free(&graph);
+        latency_stop();
+        free(runs);
+        free(probes);
+        free(stage_names);
+        return 1;
+    }
+    for (int i = 0; i < args_num; i++) {
+        if (plugins[i].fused) {
+            continue;
+        }
+        int next = i + 1;
+        while (next < args_num && plugins[next].fused) {
+            next++;
+        }
+        message_sink_t next_sink = graph_node_output(&graph, next - 1);
+        if (plugins[i].replica) {
+            if (latency_enabled()) {
+                latency_probe_init(&probes[i], i, &next_sink, &next_sink);
             }
-            sent_end = 1;
-            break;
+            replica_stage_attach(plugins[i].replica, &next_sink);
+            continue;
+        }
+        if (!plugins[i].desc) {
+            plugins[i].attach(chain && next < args_num ? plugins[next].place_work : sink_place_work);
+        }
+        if (next > i + 1) {
+            fused_run_init(&runs[i], plugins, i + 1, next - i - 1, &next_sink);
+            if (plugins[i + 1].copy_input) {
+                topology_cow_init(&graph.cows[i + 1], &next_sink, &next_sink);
+            }
+        }
+        if (latency_enabled()) {
+            latency_probe_init(&probes[i], i, &next_sink, &next_sink);
+        }
+        if (plugins[i].task) {
+            executor_stage_attach(plugins[i].task, &next_sink);
+        } else if (plugins[i].desc) {
+            plugins[i].desc->attach(plugins[i].instance, &next_sink);
+        } else if (plugins[i].attach_message_sink) {
+            plugins[i].attach_message_sink(&next_sink);
         }
+    }
 
-        // Normal line: duplicate because plugins take ownership
-        char* copy = strdup(line);
-        if (!copy) {
-            fprintf(stderr, "Error: Memory allocation failed\n");
-            break;
+    int jobs = opts.jobs;
+    if (opts.input && jobs == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = cpus < 1 ? 1 : cpus > FILE_INPUT_MAX_JOBS ? FILE_INPUT_MAX_JOBS : (int)cpus;
+    }
+    stats_source_t stats_source = {
+        .plugins = plugins,
+        .args_num = args_num,
+        .chunked = chunked,
+        .jobs = jobs,
+        .input_counters = chunked ? calloc((size_t)jobs * chunked, sizeof(stage_counters_t)) : NULL,
+        .start_ns = start_ns,
+        .format = opts.stats_format,
+    };
+    const char* stats_err = stats_signal_start(print_stats, &stats_source);
+    if (stats_err) {
+        fprintf(stderr, "Warning: %s\n", stats_err);
+    }
+
+    // Logging stages write through the buffered output writer from here on
+    output_policy_t flush_policy;
+    const output_policy_t* policy = NULL;
+    if (opts.flush && output_policy_parse(opts.flush, &flush_policy) == 0) {
+        policy = &flush_policy;
+    }
+    // --io=uring falls back to read()/writev() wherever the ring cannot be set up
+    if (opts.io_uring) {
+        const char* uring_err = output_use_uring(STDOUT_FILENO);
+        if (uring_err) {
+            fprintf(stderr, "Warning: io_uring output unavailable: %s, using writev()\n", uring_err);
         }
-        const char* err = plugins[0].place_work(copy);
-        if (err) {
-            free(copy);
-            fprintf(stderr, "Error placing work in plugin %s: %s\n", plugins[0].name, err);
-            break;
+        uring_err = opts.input ? NULL : ingest_use_uring(STDIN_FILENO);
+        if (uring_err) {
+            fprintf(stderr, "Warning: io_uring input unavailable: %s, using read()\n", uring_err);
         }
     }
+    const char* output_err = output_start(STDOUT_FILENO, policy);
+    if (output_err) {
+        fprintf(stderr, "Warning: %s, writing output directly\n", output_err);
+    }
+    // The stdin reader moves to its CPU only now, so the helper threads above stay unpinned;
+    // the slabs it fills are read by the first stage, so they go to that stage's node
+    if (ingest_cpu >= 0) {
+        (void)placement_pin_self(ingest_cpu);
+        placement_prefer_node(first_stage_cpu);
+    }
 
-    // If EOF happened without <END>, inject it now so workers can exit cleanly
-    if (!sent_end) {
-        const char* err = plugins[0].place_work("<END>");
-        if (err) {
-            fprintf(stderr, "Error sending <END> to first plugin: %s\n", err);
+    uint64_t next_seq = 0;
+    // Under --memo the first run of pure stages runs on the reader
+    int input_end = chunked;
+    while (input_end < args_num && plugins[input_end].fused) {
+        input_end++;
+    }
+    message_sink_t first_sink = graph_node_output(&graph, input_end > 0 ? input_end - 1 : TOPOLOGY_INPUT);
+    fused_run_t input_run = {0};
+    if (input_end > chunked) {
+        fused_run_init(&input_run, plugins, chunked, input_end - chunked, &first_sink);
+        if (plugins[chunked].copy_input) {
+            topology_cow_init(&graph.cows[chunked], &first_sink, &first_sink);
+        }
+    }
+    const message_sink_t* input_sink = &first_sink;
+    message_sink_t traced_input;
+    if (latency_enabled()) {
+        latency_probe_init(&probes[args_num + 1], LATENCY_PROBE_INGEST, input_sink, &traced_input);
+        input_sink = &traced_input;
+    }
+    if (opts.input) {
+        // Chunks of the mapped file go through the leading stages in parallel, merged in order
+        message_transform_t* transforms = calloc(chunked ? chunked : 1, sizeof(message_transform_t));
+        const char** names = calloc(chunked ? chunked : 1, sizeof(const char*));
+        const char* input_err = transforms && names ? NULL : "Memory allocation failed";
+        for (int i = 0; !input_err && i < chunked; i++) {
+            transforms[i] = plugins[i].transform;
+            names[i] = plugins[i].name;
+        }
+        if (!input_err) {
+            input_err = file_input_run(opts.input, jobs, transforms, names, chunked,
+                                       stats_source.input_counters, input_sink, &next_seq);
+        }
+        if (input_err) {
+            fprintf(stderr, "Error reading %s: %s\n", opts.input, input_err);
+        }
+        free(transforms);
+        free(names);
+    } else {
+        // Lines are carved from large read() blocks and placed in batches
+        int saw_end = 0;
+        const char* ingest_err = ingest_fd(STDIN_FILENO, input_sink, &next_seq, &saw_end);
+        if (ingest_err) {
+            fprintf(stderr, "Error placing work in plugin %s: %s\n", plugins[0].name, ingest_err);
         }
     }
-    
+
+    // Forward the sentinel, or inject it on EOF, so workers can exit cleanly
+    const char* end_err = place_end(input_sink, next_seq);
+    if (end_err) {
+        fprintf(stderr, "Error sending <END> to first plugin: %s\n", end_err);
+    }
+
 
     // Wait for all plugins to finish processing
     for (int i = 0; i < args_num; i++) {
-        const char* err = plugins[i].wait_finished();
+        if (plugins[i].fused) {
+            continue;
+        }
+        const char* err;
+        if (plugins[i].replica) {
+            err = replica_stage_wait_finished(plugins[i].replica);
+        } else if (plugins[i].task) {
+            err = executor_stage_wait_finished(plugins[i].task);
+        } else if (plugins[i].desc) {
+            err = plugins[i].desc->wait_finished(plugins[i].instance);
+        } else {
+            err = plugins[i].wait_finished();
+        }
         if (err) {
             fprintf(stderr, "Plugin %s wait_finished() failed: %s\n", plugins[i].name, err);
         }
     }
+    // Every task stage is done: the workers can go before the stages are freed
+    executor_stop();
+    // So is every paced one, but the pacer may still be returning from handing on its <END>
+    pacer_stop();
+    stats_signal_stop();
+    if (opts.stats) {
+        print_stats(&stats_source);
+    }
+    report_dropped(&stats_source);
+    const char* trace_err = latency_finish(stderr);
+    if (trace_err) {
+        fprintf(stderr, "Error writing %s: %s\n", opts.trace, trace_err);
+    }
 
     // Shutdown all plugins
     for (int i = args_num - 1; i >= 0; --i) {
-        if ( plugins[i].fini ) {
-            const char* err = plugins[i].fini();
-            if (err) {
-                fprintf(stderr, "Plugin %s fini() failed: %s\n", plugins[i].name, err);
-            }
+        const char* err = stage_fini(&plugins[i]);
+        if (err) {
+            fprintf(stderr, "Plugin %s fini() failed: %s\n", plugins[i].name, err);
         }
         if ( plugins[i].handle ) {
             dlclose( plugins[i].handle );
@@ -199,7 +1519,21 @@ int main(int argc, char** argv) {
             free( plugins[i].name );
         }
     }
+    free(stats_source.input_counters);
+    for (int i = 0; i < args_num; i++) {
+        free(runs[i].memo_inputs);
+    }
+    free(input_run.memo_inputs);
+    free(runs);
     free(plugins);
+    graph_sinks_free(&graph);
+    topology_free(&topo);
+    // Every stage thread is gone: write out what is still buffered
+    output_stop();
+    latency_stop();
+    memo_stop();
+    free(probes);
+    free(stage_names);
     printf("Pipeline shutdown complete\n");
     return 0;
 }
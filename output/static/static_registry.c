@@ -0,0 +1,786 @@
+/* Generated by gen_static.sh; do not edit */
+#define _POSIX_C_SOURCE 200809L
+#include <string.h>
+#include "static_registry.h"
+
+const plugin_descriptor_t* logger_plugin_get_descriptor(void);
+const plugin_descriptor_t* uppercaser_plugin_get_descriptor(void);
+const plugin_descriptor_t* rotator_plugin_get_descriptor(void);
+const plugin_descriptor_t* flipper_plugin_get_descriptor(void);
+const plugin_descriptor_t* expander_plugin_get_descriptor(void);
+const plugin_descriptor_t* typewriter_plugin_get_descriptor(void);
+const char* uppercaser_transform(message_t* msg);
+const char* rotator_transform(message_t* msg);
+const char* flipper_transform(message_t* msg);
+const char* expander_transform(message_t* msg);
+void plugin_set_host_services(const host_services_t* services);
+
+static const static_plugin_t plugins[] = {
+    { "logger", logger_plugin_get_descriptor, plugin_set_host_services },
+    { "uppercaser", uppercaser_plugin_get_descriptor, plugin_set_host_services },
+    { "rotator", rotator_plugin_get_descriptor, plugin_set_host_services },
+    { "flipper", flipper_plugin_get_descriptor, plugin_set_host_services },
+    { "expander", expander_plugin_get_descriptor, plugin_set_host_services },
+    { "typewriter", typewriter_plugin_get_descriptor, plugin_set_host_services },
+};
+
+static void chain_uppercaser(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+    }
+}
+
+static void chain_uppercaser_uppercaser(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+    }
+}
+
+static void chain_uppercaser_uppercaser_uppercaser(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+    }
+}
+
+static void chain_uppercaser_uppercaser_rotator(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+    }
+}
+
+static void chain_uppercaser_uppercaser_flipper(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+    }
+}
+
+static void chain_uppercaser_uppercaser_expander(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+    }
+}
+
+static void chain_uppercaser_rotator(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+    }
+}
+
+static void chain_uppercaser_rotator_uppercaser(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+    }
+}
+
+static void chain_uppercaser_rotator_rotator(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+    }
+}
+
+static void chain_uppercaser_rotator_flipper(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+    }
+}
+
+static void chain_uppercaser_rotator_expander(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+    }
+}
+
+static void chain_uppercaser_flipper(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+    }
+}
+
+static void chain_uppercaser_flipper_uppercaser(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+    }
+}
+
+static void chain_uppercaser_flipper_rotator(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+    }
+}
+
+static void chain_uppercaser_flipper_flipper(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+    }
+}
+
+static void chain_uppercaser_flipper_expander(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+    }
+}
+
+static void chain_uppercaser_expander(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+    }
+}
+
+static void chain_uppercaser_expander_uppercaser(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+    }
+}
+
+static void chain_uppercaser_expander_rotator(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+    }
+}
+
+static void chain_uppercaser_expander_flipper(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+    }
+}
+
+static void chain_uppercaser_expander_expander(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+    }
+}
+
+static void chain_rotator(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+    }
+}
+
+static void chain_rotator_uppercaser(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+    }
+}
+
+static void chain_rotator_uppercaser_uppercaser(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+    }
+}
+
+static void chain_rotator_uppercaser_rotator(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+    }
+}
+
+static void chain_rotator_uppercaser_flipper(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+    }
+}
+
+static void chain_rotator_uppercaser_expander(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+    }
+}
+
+static void chain_rotator_rotator(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+    }
+}
+
+static void chain_rotator_rotator_uppercaser(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+    }
+}
+
+static void chain_rotator_rotator_rotator(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+    }
+}
+
+static void chain_rotator_rotator_flipper(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+    }
+}
+
+static void chain_rotator_rotator_expander(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+    }
+}
+
+static void chain_rotator_flipper(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+    }
+}
+
+static void chain_rotator_flipper_uppercaser(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+    }
+}
+
+static void chain_rotator_flipper_rotator(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+    }
+}
+
+static void chain_rotator_flipper_flipper(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+    }
+}
+
+static void chain_rotator_flipper_expander(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+    }
+}
+
+static void chain_rotator_expander(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+    }
+}
+
+static void chain_rotator_expander_uppercaser(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+    }
+}
+
+static void chain_rotator_expander_rotator(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+    }
+}
+
+static void chain_rotator_expander_flipper(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+    }
+}
+
+static void chain_rotator_expander_expander(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+    }
+}
+
+static void chain_flipper(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+    }
+}
+
+static void chain_flipper_uppercaser(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+    }
+}
+
+static void chain_flipper_uppercaser_uppercaser(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+    }
+}
+
+static void chain_flipper_uppercaser_rotator(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+    }
+}
+
+static void chain_flipper_uppercaser_flipper(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+    }
+}
+
+static void chain_flipper_uppercaser_expander(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+    }
+}
+
+static void chain_flipper_rotator(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+    }
+}
+
+static void chain_flipper_rotator_uppercaser(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+    }
+}
+
+static void chain_flipper_rotator_rotator(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+    }
+}
+
+static void chain_flipper_rotator_flipper(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+    }
+}
+
+static void chain_flipper_rotator_expander(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+    }
+}
+
+static void chain_flipper_flipper(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+    }
+}
+
+static void chain_flipper_flipper_uppercaser(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+    }
+}
+
+static void chain_flipper_flipper_rotator(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+    }
+}
+
+static void chain_flipper_flipper_flipper(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+    }
+}
+
+static void chain_flipper_flipper_expander(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+    }
+}
+
+static void chain_flipper_expander(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+    }
+}
+
+static void chain_flipper_expander_uppercaser(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+    }
+}
+
+static void chain_flipper_expander_rotator(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+    }
+}
+
+static void chain_flipper_expander_flipper(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+    }
+}
+
+static void chain_flipper_expander_expander(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+    }
+}
+
+static void chain_expander(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(expander_transform(msgs[i]), "expander");
+    }
+}
+
+static void chain_expander_uppercaser(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+    }
+}
+
+static void chain_expander_uppercaser_uppercaser(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+    }
+}
+
+static void chain_expander_uppercaser_rotator(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+    }
+}
+
+static void chain_expander_uppercaser_flipper(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+    }
+}
+
+static void chain_expander_uppercaser_expander(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+    }
+}
+
+static void chain_expander_rotator(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+    }
+}
+
+static void chain_expander_rotator_uppercaser(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+    }
+}
+
+static void chain_expander_rotator_rotator(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+    }
+}
+
+static void chain_expander_rotator_flipper(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+    }
+}
+
+static void chain_expander_rotator_expander(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+    }
+}
+
+static void chain_expander_flipper(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+    }
+}
+
+static void chain_expander_flipper_uppercaser(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+    }
+}
+
+static void chain_expander_flipper_rotator(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+    }
+}
+
+static void chain_expander_flipper_flipper(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+    }
+}
+
+static void chain_expander_flipper_expander(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+    }
+}
+
+static void chain_expander_expander(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+    }
+}
+
+static void chain_expander_expander_uppercaser(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(uppercaser_transform(msgs[i]), "uppercaser");
+    }
+}
+
+static void chain_expander_expander_rotator(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(rotator_transform(msgs[i]), "rotator");
+    }
+}
+
+static void chain_expander_expander_flipper(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(flipper_transform(msgs[i]), "flipper");
+    }
+}
+
+static void chain_expander_expander_expander(message_t** msgs, int count) {
+    for (int i = 0; i < count; i++) {
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+        static_chain_check(expander_transform(msgs[i]), "expander");
+    }
+}
+
+static const struct {
+    int count;
+    const plugin_descriptor_t* (*stages[STATIC_CHAIN_MAX])(void);
+    static_chain_fn run;
+} chains[] = {
+    { 1, { uppercaser_plugin_get_descriptor }, chain_uppercaser },
+    { 2, { uppercaser_plugin_get_descriptor, uppercaser_plugin_get_descriptor }, chain_uppercaser_uppercaser },
+    { 3, { uppercaser_plugin_get_descriptor, uppercaser_plugin_get_descriptor, uppercaser_plugin_get_descriptor }, chain_uppercaser_uppercaser_uppercaser },
+    { 3, { uppercaser_plugin_get_descriptor, uppercaser_plugin_get_descriptor, rotator_plugin_get_descriptor }, chain_uppercaser_uppercaser_rotator },
+    { 3, { uppercaser_plugin_get_descriptor, uppercaser_plugin_get_descriptor, flipper_plugin_get_descriptor }, chain_uppercaser_uppercaser_flipper },
+    { 3, { uppercaser_plugin_get_descriptor, uppercaser_plugin_get_descriptor, expander_plugin_get_descriptor }, chain_uppercaser_uppercaser_expander },
+    { 2, { uppercaser_plugin_get_descriptor, rotator_plugin_get_descriptor }, chain_uppercaser_rotator },
+    { 3, { uppercaser_plugin_get_descriptor, rotator_plugin_get_descriptor, uppercaser_plugin_get_descriptor }, chain_uppercaser_rotator_uppercaser },
+    { 3, { uppercaser_plugin_get_descriptor, rotator_plugin_get_descriptor, rotator_plugin_get_descriptor }, chain_uppercaser_rotator_rotator },
+    { 3, { uppercaser_plugin_get_descriptor, rotator_plugin_get_descriptor, flipper_plugin_get_descriptor }, chain_uppercaser_rotator_flipper },
+    { 3, { uppercaser_plugin_get_descriptor, rotator_plugin_get_descriptor, expander_plugin_get_descriptor }, chain_uppercaser_rotator_expander },
+    { 2, { uppercaser_plugin_get_descriptor, flipper_plugin_get_descriptor }, chain_uppercaser_flipper },
+    { 3, { uppercaser_plugin_get_descriptor, flipper_plugin_get_descriptor, uppercaser_plugin_get_descriptor }, chain_uppercaser_flipper_uppercaser },
+    { 3, { uppercaser_plugin_get_descriptor, flipper_plugin_get_descriptor, rotator_plugin_get_descriptor }, chain_uppercaser_flipper_rotator },
+    { 3, { uppercaser_plugin_get_descriptor, flipper_plugin_get_descriptor, flipper_plugin_get_descriptor }, chain_uppercaser_flipper_flipper },
+    { 3, { uppercaser_plugin_get_descriptor, flipper_plugin_get_descriptor, expander_plugin_get_descriptor }, chain_uppercaser_flipper_expander },
+    { 2, { uppercaser_plugin_get_descriptor, expander_plugin_get_descriptor }, chain_uppercaser_expander },
+    { 3, { uppercaser_plugin_get_descriptor, expander_plugin_get_descriptor, uppercaser_plugin_get_descriptor }, chain_uppercaser_expander_uppercaser },
+    { 3, { uppercaser_plugin_get_descriptor, expander_plugin_get_descriptor, rotator_plugin_get_descriptor }, chain_uppercaser_expander_rotator },
+    { 3, { uppercaser_plugin_get_descriptor, expander_plugin_get_descriptor, flipper_plugin_get_descriptor }, chain_uppercaser_expander_flipper },
+    { 3, { uppercaser_plugin_get_descriptor, expander_plugin_get_descriptor, expander_plugin_get_descriptor }, chain_uppercaser_expander_expander },
+    { 1, { rotator_plugin_get_descriptor }, chain_rotator },
+    { 2, { rotator_plugin_get_descriptor, uppercaser_plugin_get_descriptor }, chain_rotator_uppercaser },
+    { 3, { rotator_plugin_get_descriptor, uppercaser_plugin_get_descriptor, uppercaser_plugin_get_descriptor }, chain_rotator_uppercaser_uppercaser },
+    { 3, { rotator_plugin_get_descriptor, uppercaser_plugin_get_descriptor, rotator_plugin_get_descriptor }, chain_rotator_uppercaser_rotator },
+    { 3, { rotator_plugin_get_descriptor, uppercaser_plugin_get_descriptor, flipper_plugin_get_descriptor }, chain_rotator_uppercaser_flipper },
+    { 3, { rotator_plugin_get_descriptor, uppercaser_plugin_get_descriptor, expander_plugin_get_descriptor }, chain_rotator_uppercaser_expander },
+    { 2, { rotator_plugin_get_descriptor, rotator_plugin_get_descriptor }, chain_rotator_rotator },
+    { 3, { rotator_plugin_get_descriptor, rotator_plugin_get_descriptor, uppercaser_plugin_get_descriptor }, chain_rotator_rotator_uppercaser },
+    { 3, { rotator_plugin_get_descriptor, rotator_plugin_get_descriptor, rotator_plugin_get_descriptor }, chain_rotator_rotator_rotator },
+    { 3, { rotator_plugin_get_descriptor, rotator_plugin_get_descriptor, flipper_plugin_get_descriptor }, chain_rotator_rotator_flipper },
+    { 3, { rotator_plugin_get_descriptor, rotator_plugin_get_descriptor, expander_plugin_get_descriptor }, chain_rotator_rotator_expander },
+    { 2, { rotator_plugin_get_descriptor, flipper_plugin_get_descriptor }, chain_rotator_flipper },
+    { 3, { rotator_plugin_get_descriptor, flipper_plugin_get_descriptor, uppercaser_plugin_get_descriptor }, chain_rotator_flipper_uppercaser },
+    { 3, { rotator_plugin_get_descriptor, flipper_plugin_get_descriptor, rotator_plugin_get_descriptor }, chain_rotator_flipper_rotator },
+    { 3, { rotator_plugin_get_descriptor, flipper_plugin_get_descriptor, flipper_plugin_get_descriptor }, chain_rotator_flipper_flipper },
+    { 3, { rotator_plugin_get_descriptor, flipper_plugin_get_descriptor, expander_plugin_get_descriptor }, chain_rotator_flipper_expander },
+    { 2, { rotator_plugin_get_descriptor, expander_plugin_get_descriptor }, chain_rotator_expander },
+    { 3, { rotator_plugin_get_descriptor, expander_plugin_get_descriptor, uppercaser_plugin_get_descriptor }, chain_rotator_expander_uppercaser },
+    { 3, { rotator_plugin_get_descriptor, expander_plugin_get_descriptor, rotator_plugin_get_descriptor }, chain_rotator_expander_rotator },
+    { 3, { rotator_plugin_get_descriptor, expander_plugin_get_descriptor, flipper_plugin_get_descriptor }, chain_rotator_expander_flipper },
+    { 3, { rotator_plugin_get_descriptor, expander_plugin_get_descriptor, expander_plugin_get_descriptor }, chain_rotator_expander_expander },
+    { 1, { flipper_plugin_get_descriptor }, chain_flipper },
+    { 2, { flipper_plugin_get_descriptor, uppercaser_plugin_get_descriptor }, chain_flipper_uppercaser },
+    { 3, { flipper_plugin_get_descriptor, uppercaser_plugin_get_descriptor, uppercaser_plugin_get_descriptor }, chain_flipper_uppercaser_uppercaser },
+    { 3, { flipper_plugin_get_descriptor, uppercaser_plugin_get_descriptor, rotator_plugin_get_descriptor }, chain_flipper_uppercaser_rotator },
+    { 3, { flipper_plugin_get_descriptor, uppercaser_plugin_get_descriptor, flipper_plugin_get_descriptor }, chain_flipper_uppercaser_flipper },
+    { 3, { flipper_plugin_get_descriptor, uppercaser_plugin_get_descriptor, expander_plugin_get_descriptor }, chain_flipper_uppercaser_expander },
+    { 2, { flipper_plugin_get_descriptor, rotator_plugin_get_descriptor }, chain_flipper_rotator },
+    { 3, { flipper_plugin_get_descriptor, rotator_plugin_get_descriptor, uppercaser_plugin_get_descriptor }, chain_flipper_rotator_uppercaser },
+    { 3, { flipper_plugin_get_descriptor, rotator_plugin_get_descriptor, rotator_plugin_get_descriptor }, chain_flipper_rotator_rotator },
+    { 3, { flipper_plugin_get_descriptor, rotator_plugin_get_descriptor, flipper_plugin_get_descriptor }, chain_flipper_rotator_flipper },
+    { 3, { flipper_plugin_get_descriptor, rotator_plugin_get_descriptor, expander_plugin_get_descriptor }, chain_flipper_rotator_expander },
+    { 2, { flipper_plugin_get_descriptor, flipper_plugin_get_descriptor }, chain_flipper_flipper },
+    { 3, { flipper_plugin_get_descriptor, flipper_plugin_get_descriptor, uppercaser_plugin_get_descriptor }, chain_flipper_flipper_uppercaser },
+    { 3, { flipper_plugin_get_descriptor, flipper_plugin_get_descriptor, rotator_plugin_get_descriptor }, chain_flipper_flipper_rotator },
+    { 3, { flipper_plugin_get_descriptor, flipper_plugin_get_descriptor, flipper_plugin_get_descriptor }, chain_flipper_flipper_flipper },
+    { 3, { flipper_plugin_get_descriptor, flipper_plugin_get_descriptor, expander_plugin_get_descriptor }, chain_flipper_flipper_expander },
+    { 2, { flipper_plugin_get_descriptor, expander_plugin_get_descriptor }, chain_flipper_expander },
+    { 3, { flipper_plugin_get_descriptor, expander_plugin_get_descriptor, uppercaser_plugin_get_descriptor }, chain_flipper_expander_uppercaser },
+    { 3, { flipper_plugin_get_descriptor, expander_plugin_get_descriptor, rotator_plugin_get_descriptor }, chain_flipper_expander_rotator },
+    { 3, { flipper_plugin_get_descriptor, expander_plugin_get_descriptor, flipper_plugin_get_descriptor }, chain_flipper_expander_flipper },
+    { 3, { flipper_plugin_get_descriptor, expander_plugin_get_descriptor, expander_plugin_get_descriptor }, chain_flipper_expander_expander },
+    { 1, { expander_plugin_get_descriptor }, chain_expander },
+    { 2, { expander_plugin_get_descriptor, uppercaser_plugin_get_descriptor }, chain_expander_uppercaser },
+    { 3, { expander_plugin_get_descriptor, uppercaser_plugin_get_descriptor, uppercaser_plugin_get_descriptor }, chain_expander_uppercaser_uppercaser },
+    { 3, { expander_plugin_get_descriptor, uppercaser_plugin_get_descriptor, rotator_plugin_get_descriptor }, chain_expander_uppercaser_rotator },
+    { 3, { expander_plugin_get_descriptor, uppercaser_plugin_get_descriptor, flipper_plugin_get_descriptor }, chain_expander_uppercaser_flipper },
+    { 3, { expander_plugin_get_descriptor, uppercaser_plugin_get_descriptor, expander_plugin_get_descriptor }, chain_expander_uppercaser_expander },
+    { 2, { expander_plugin_get_descriptor, rotator_plugin_get_descriptor }, chain_expander_rotator },
+    { 3, { expander_plugin_get_descriptor, rotator_plugin_get_descriptor, uppercaser_plugin_get_descriptor }, chain_expander_rotator_uppercaser },
+    { 3, { expander_plugin_get_descriptor, rotator_plugin_get_descriptor, rotator_plugin_get_descriptor }, chain_expander_rotator_rotator },
+    { 3, { expander_plugin_get_descriptor, rotator_plugin_get_descriptor, flipper_plugin_get_descriptor }, chain_expander_rotator_flipper },
+    { 3, { expander_plugin_get_descriptor, rotator_plugin_get_descriptor, expander_plugin_get_descriptor }, chain_expander_rotator_expander },
+    { 2, { expander_plugin_get_descriptor, flipper_plugin_get_descriptor }, chain_expander_flipper },
+    { 3, { expander_plugin_get_descriptor, flipper_plugin_get_descriptor, uppercaser_plugin_get_descriptor }, chain_expander_flipper_uppercaser },
+    { 3, { expander_plugin_get_descriptor, flipper_plugin_get_descriptor, rotator_plugin_get_descriptor }, chain_expander_flipper_rotator },
+    { 3, { expander_plugin_get_descriptor, flipper_plugin_get_descriptor, flipper_plugin_get_descriptor }, chain_expander_flipper_flipper },
+    { 3, { expander_plugin_get_descriptor, flipper_plugin_get_descriptor, expander_plugin_get_descriptor }, chain_expander_flipper_expander },
+    { 2, { expander_plugin_get_descriptor, expander_plugin_get_descriptor }, chain_expander_expander },
+    { 3, { expander_plugin_get_descriptor, expander_plugin_get_descriptor, uppercaser_plugin_get_descriptor }, chain_expander_expander_uppercaser },
+    { 3, { expander_plugin_get_descriptor, expander_plugin_get_descriptor, rotator_plugin_get_descriptor }, chain_expander_expander_rotator },
+    { 3, { expander_plugin_get_descriptor, expander_plugin_get_descriptor, flipper_plugin_get_descriptor }, chain_expander_expander_flipper },
+    { 3, { expander_plugin_get_descriptor, expander_plugin_get_descriptor, expander_plugin_get_descriptor }, chain_expander_expander_expander },
+};
+
+const static_plugin_t* static_registry_find(const char* name) {
+    for (size_t p = 0; p < sizeof plugins / sizeof plugins[0]; p++) {
+        if (strcmp(plugins[p].name, name) == 0) {
+            return &plugins[p];
+        }
+    }
+    return NULL;
+}
+
+static_chain_fn static_registry_find_chain(const plugin_descriptor_t* const* descs, int count) {
+    for (size_t c = 0; c < sizeof chains / sizeof chains[0]; c++) {
+        int match = chains[c].count == count;
+        for (int s = 0; match && s < count; s++) {
+            match = chains[c].stages[s]() == descs[s];
+        }
+        if (match) {
+            return chains[c].run;
+        }
+    }
+    return NULL;
+}
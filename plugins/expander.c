@@ -4,31 +4,28 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include "kernels/text_kernels.h"
 
 /**
  * Transformation function for the expander.
- * Inserts a single white space between each character.
+ * Inserts a single white space between each character. The message grows
+ * to twice its length and is expanded back to front, so each character is
+ * moved exactly once (a vector at a time).
  */
-static const char* expander_transform(const char* input) {
-    
-    size_t len = strlen(input);
-    if (len == 0) {
-        return strdup(input);
+PLUGIN_TRANSFORM const char* expander_transform(message_t* msg) {
+    size_t len = msg->len;
+    if (len < 2) {
+        return NULL;
     }
 
     size_t new_len = 2 * len - 1;
-    char* expanded = (char*)malloc(new_len + 1);
-    if (!expanded) {
-        return NULL;
+    if (message_reserve(msg, new_len) != 0) {
+        return "Memory allocation failed in expander";
     }
-    for (size_t i = 0, j = 0; i < len; i++) {
-        expanded[j++] = input[i];
-        if (i < len - 1) {
-            expanded[j++] = ' '; /* Insert space */
-        }
-    }
-    expanded[new_len] = '\0';
-    return expanded;
+    text_kernels()->expand(msg->data, len);
+    msg->data[new_len] = '\0';
+    msg->len = new_len;
+    return NULL;
 }
 
 /**
@@ -40,7 +37,7 @@ static const char* expander_transform(const char* input) {
  */
 __attribute__((visibility("default")))
 const char* plugin_init(int queue_size) {
-    return common_plugin_init(expander_transform, "EXPANDER", queue_size);
+    return common_plugin_init_message(expander_transform, NULL, "EXPANDER", queue_size);
 }
 
 /**
@@ -67,15 +64,8 @@ const char* plugin_fini(void){
  */
 __attribute__((visibility("default")))
 const char* plugin_place_work(const char* str) {
-    plugin_context_t* context = get_plugin_context();
-    char* item_copy = strdup(str);
-    if (item_copy == NULL) return "Memory allocation failed in plugin_place_work";
-    const char* err = consumer_producer_put(context->queue, item_copy);
-    if (err != NULL) {
-        free(item_copy);
-        return err;
-    }
-    return NULL;
+    // Control lines ("<END>" from a v1 plugin upstream) become typed messages
+    return common_plugin_place_work(get_plugin_context(), str);
 }
 
 /**
@@ -107,6 +97,38 @@ const char* plugin_wait_finished(void){
     return NULL;
 }
 
+static const char* expander_create(plugin_instance_t** instance, int queue_size) {
+    return common_plugin_create(instance, expander_transform, NULL, "EXPANDER", queue_size);
+}
+
+static const plugin_descriptor_t expander_descriptor = {
+    .abi_version = PLUGIN_ABI_VERSION,
+    .size = sizeof(plugin_descriptor_t),
+    .name = "EXPANDER",
+    .transform = {
+        .process = expander_transform,
+        .process_batch = NULL,
+        .flags = MESSAGE_TRANSFORM_PURE | MESSAGE_TRANSFORM_THREAD_SAFE,
+    },
+    .create = expander_create,
+    .destroy = common_plugin_destroy,
+    .place_work = common_plugin_place_work,
+    .attach = common_plugin_attach,
+    .get_message_sink = common_plugin_get_message_sink,
+    .wait_finished = common_plugin_wait_finished,
+    .get_stats = common_plugin_get_stats,
+};
+
+/**
+ * Describe the plugin for the v2 ABI: per-instance entry points and the
+ * transform's capabilities
+ * @return Pointer to the static descriptor
+ */
+__attribute__((visibility("default")))
+const plugin_descriptor_t* plugin_get_descriptor(void) {
+    return &expander_descriptor;
+}
+
 /**
  * Return the plugin's display name.
  * Used for identification and debugging.
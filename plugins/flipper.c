@@ -5,31 +5,15 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include "kernels/text_kernels.h"
 
 /**
  * Transformation function for the flipper.
- * Reverses the order of characters in the string.
+ * Reverses the order of characters in the string, in place.
  */
-static const char* flipper_transform(const char* input) {
-    if (!input) return NULL;                
-    size_t len = strlen(input);
-    if (len == 0) {
-        char* out = malloc(1);
-        if (!out) return NULL;
-        out[0] = '\0';
-        return out;
-    }
-    char* new_str = malloc(len + 1);
-    if (!new_str) {
-        return NULL;
-    }
-    
-    for (size_t i = 0; i < len; i++) {
-        new_str[i] = input[len - 1 - i]; /* */
-    }
-    new_str[len] = '\0';
-    
-    return new_str;
+PLUGIN_TRANSFORM const char* flipper_transform(message_t* msg) {
+    text_kernels()->reverse(msg->data, msg->len);
+    return NULL;
 }
 
 /**
@@ -41,7 +25,7 @@ static const char* flipper_transform(const char* input) {
  */
 __attribute__((visibility("default")))
 const char* plugin_init(int queue_size) {
-    return common_plugin_init(flipper_transform, "FLIPPER", queue_size);
+    return common_plugin_init_message(flipper_transform, NULL, "FLIPPER", queue_size);
 }
 
 /**
@@ -68,15 +52,8 @@ const char* plugin_fini(void){
  */
 __attribute__((visibility("default")))
 const char* plugin_place_work(const char* str) {
-    plugin_context_t* context = get_plugin_context();
-    char* item_copy = strdup(str);
-    if (item_copy == NULL) return "Memory allocation failed in plugin_place_work";
-    const char* err = consumer_producer_put(context->queue, item_copy);
-    if (err != NULL) {
-        free(item_copy);
-        return err;
-    }
-    return NULL;
+    // Control lines ("<END>" from a v1 plugin upstream) become typed messages
+    return common_plugin_place_work(get_plugin_context(), str);
 }
 
 /**
@@ -108,6 +85,39 @@ const char* plugin_wait_finished(void){
     return NULL;
 }
 
+static const char* flipper_create(plugin_instance_t** instance, int queue_size) {
+    return common_plugin_create(instance, flipper_transform, NULL, "FLIPPER", queue_size);
+}
+
+static const plugin_descriptor_t flipper_descriptor = {
+    .abi_version = PLUGIN_ABI_VERSION,
+    .size = sizeof(plugin_descriptor_t),
+    .name = "FLIPPER",
+    .transform = {
+        .process = flipper_transform,
+        .process_batch = NULL,
+        .flags = MESSAGE_TRANSFORM_PURE | MESSAGE_TRANSFORM_IN_PLACE |
+                 MESSAGE_TRANSFORM_LENGTH_PRESERVING | MESSAGE_TRANSFORM_THREAD_SAFE,
+    },
+    .create = flipper_create,
+    .destroy = common_plugin_destroy,
+    .place_work = common_plugin_place_work,
+    .attach = common_plugin_attach,
+    .get_message_sink = common_plugin_get_message_sink,
+    .wait_finished = common_plugin_wait_finished,
+    .get_stats = common_plugin_get_stats,
+};
+
+/**
+ * Describe the plugin for the v2 ABI: per-instance entry points and the
+ * transform's capabilities
+ * @return Pointer to the static descriptor
+ */
+__attribute__((visibility("default")))
+const plugin_descriptor_t* plugin_get_descriptor(void) {
+    return &flipper_descriptor;
+}
+
 /**
  * Return the plugin's display name.
  * Used for identification and debugging.
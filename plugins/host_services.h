@@ -0,0 +1,58 @@
+#ifndef HOST_SERVICES_H
+#define HOST_SERVICES_H
+
+#include <stddef.h>
+#include <sys/uio.h>
+
+/**
+ * Services the host offers to every plugin.
+ * Handed over once through plugin_set_host_services() before plugin_init().
+ * New members are only ever appended; a plugin must check size before
+ * using a member past the ones it was built against.
+ */
+typedef struct host_services {
+    size_t size;    /* sizeof(host_services_t) as seen by the host */
+
+    /**
+     * Allocate message memory from the pipeline-wide allocator
+     * @param size Requested bytes
+     * @param usable Receives the usable size of the block (may be NULL)
+     * @return Block or NULL on failure
+     */
+    void* (*msg_alloc)(size_t size, size_t* usable);
+
+    /**
+     * Return a block obtained from msg_alloc (any thread may free)
+     * @param ptr Block (may be NULL)
+     */
+    void  (*msg_free)(void* ptr);
+
+    /**
+     * Append one record (the concatenation of parts) to the host's buffered
+     * stdout writer. Records from one thread keep their order.
+     * @param parts Record pieces
+     * @param count Number of pieces
+     */
+    void  (*output_write)(const struct iovec* parts, int count);
+
+    /**
+     * CPU the stage being created should run its thread on (--pin).
+     * Only meaningful during plugin_init()/plugin_create().
+     * @return CPU number, or -1 to leave the thread unpinned
+     */
+    int   (*stage_cpu)(void);
+
+    /**
+     * Overflow policy of the input queue of the stage being created
+     * (block, timeout:MS, drop-newest, drop-oldest, sample[:N]). Only
+     * meaningful during plugin_init()/plugin_create().
+     * @return Policy text, or NULL to block when the queue is full
+     */
+    const char* (*stage_queue_policy)(void);
+} host_services_t;
+
+/* Member is present in a services table of the given size */
+#define HOST_SERVICES_HAS(services, member) \
+    ((services)->size >= offsetof(host_services_t, member) + sizeof((services)->member))
+
+#endif /* HOST_SERVICES_H */
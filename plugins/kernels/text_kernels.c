@@ -0,0 +1,292 @@
+#define _POSIX_C_SOURCE 200809L
+#include "text_kernels.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TEXT_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+/* ---- scalar ---------------------------------------------------------- */
+
+static void upper_scalar(char* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)data[i];
+        if ((unsigned char)(c - 'a') < 26u) {
+            data[i] = (char)(c - ('a' - 'A'));
+        }
+    }
+}
+
+static void reverse_scalar(char* data, size_t len) {
+    if (len < 2) return;
+    for (size_t i = 0, j = len - 1; i < j; i++, j--) {
+        char tmp = data[i];
+        data[i] = data[j];
+        data[j] = tmp;
+    }
+}
+
+/*
+ * glibc's memmove is itself picked per CPU and beat hand-written SSE2, AVX2
+ * and AVX-512 shift loops from 16 KiB up (tying below), so every variant
+ * rotates through it.
+ */
+static void rotate_right_memmove(char* data, size_t len) {
+    if (len < 2) return;
+    char last = data[len - 1];
+    memmove(data + 1, data, len - 1);
+    data[0] = last;
+}
+
+/*
+ * Expand input bytes [begin, end) to positions 2*i. Runs back to front, so
+ * every byte is read before its slot is overwritten; bytes from end on must
+ * already have been moved.
+ */
+static void expand_range_scalar(char* data, size_t begin, size_t end) {
+    for (size_t i = end; i-- > begin;) {
+        data[2 * i + 1] = ' ';
+        data[2 * i] = data[i];
+    }
+}
+
+static void expand_scalar(char* data, size_t len) {
+    expand_range_scalar(data, 0, len);
+}
+
+static const text_kernels_t scalar_kernels = {
+    "scalar", upper_scalar, reverse_scalar, rotate_right_memmove, expand_scalar,
+};
+
+#ifdef TEXT_KERNELS_X86
+
+/* ---- SSE2 (16 bytes) -------------------------------------------------- */
+
+__attribute__((target("sse2")))
+static void upper_sse2(char* data, size_t len) {
+    const __m128i below = _mm_set1_epi8('a' - 1);
+    const __m128i above = _mm_set1_epi8('z' + 1);
+    const __m128i delta = _mm_set1_epi8('a' - 'A');
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        /* Signed compares: bytes >= 0x80 are negative and never match */
+        __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(v, below), _mm_cmplt_epi8(v, above));
+        v = _mm_sub_epi8(v, _mm_and_si128(lower, delta));
+        _mm_storeu_si128((__m128i*)(data + i), v);
+    }
+    upper_scalar(data + i, len - i);
+}
+
+/* SSE2 has no byte shuffle: reverse dwords, then words, then bytes */
+__attribute__((target("sse2")))
+static inline __m128i reverse16_sse2(__m128i v) {
+    v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+__attribute__((target("sse2")))
+static void reverse_sse2(char* data, size_t len) {
+    size_t i = 0, j = len;
+    while (j - i >= 32) {
+        __m128i head = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i tail = _mm_loadu_si128((const __m128i*)(data + j - 16));
+        _mm_storeu_si128((__m128i*)(data + i), reverse16_sse2(tail));
+        _mm_storeu_si128((__m128i*)(data + j - 16), reverse16_sse2(head));
+        i += 16;
+        j -= 16;
+    }
+    reverse_scalar(data + i, j - i);
+}
+
+__attribute__((target("sse2")))
+static void expand_range_sse2(char* data, size_t begin, size_t end) {
+    const __m128i space = _mm_set1_epi8(' ');
+    size_t blocks = begin + ((end - begin) & ~(size_t)15);
+    expand_range_scalar(data, blocks, end);
+    for (size_t i = blocks; i > begin;) {
+        i -= 16;
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        _mm_storeu_si128((__m128i*)(data + 2 * i), _mm_unpacklo_epi8(v, space));
+        _mm_storeu_si128((__m128i*)(data + 2 * i + 16), _mm_unpackhi_epi8(v, space));
+    }
+}
+
+__attribute__((target("sse2")))
+static void expand_sse2(char* data, size_t len) {
+    expand_range_sse2(data, 0, len);
+}
+
+static const text_kernels_t sse2_kernels = {
+    "sse2", upper_sse2, reverse_sse2, rotate_right_memmove, expand_sse2,
+};
+
+/* ---- AVX2 (32 bytes) -------------------------------------------------- */
+
+__attribute__((target("avx2")))
+static void upper_avx2(char* data, size_t len) {
+    const __m256i below = _mm256_set1_epi8('a' - 1);
+    const __m256i above = _mm256_set1_epi8('z' + 1);
+    const __m256i delta = _mm256_set1_epi8('a' - 'A');
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(v, below), _mm256_cmpgt_epi8(above, v));
+        v = _mm256_sub_epi8(v, _mm256_and_si256(lower, delta));
+        _mm256_storeu_si256((__m256i*)(data + i), v);
+    }
+    upper_sse2(data + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i reverse32_avx2(__m256i v) {
+    const __m256i lane_reverse = _mm256_setr_epi8(
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    v = _mm256_shuffle_epi8(v, lane_reverse);
+    return _mm256_permute4x64_epi64(v, _MM_SHUFFLE(1, 0, 3, 2));
+}
+
+__attribute__((target("avx2")))
+static void reverse_avx2(char* data, size_t len) {
+    size_t i = 0, j = len;
+    while (j - i >= 64) {
+        __m256i head = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i tail = _mm256_loadu_si256((const __m256i*)(data + j - 32));
+        _mm256_storeu_si256((__m256i*)(data + i), reverse32_avx2(tail));
+        _mm256_storeu_si256((__m256i*)(data + j - 32), reverse32_avx2(head));
+        i += 32;
+        j -= 32;
+    }
+    reverse_sse2(data + i, j - i);
+}
+
+/* unpack works per 128-bit lane, so first line the quadwords up as 0 2 1 3 */
+__attribute__((target("avx2")))
+static void expand_range_avx2(char* data, size_t begin, size_t end) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    size_t blocks = begin + ((end - begin) & ~(size_t)31);
+    expand_range_sse2(data, blocks, end);
+    for (size_t i = blocks; i > begin;) {
+        i -= 32;
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        v = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i*)(data + 2 * i), _mm256_unpacklo_epi8(v, space));
+        _mm256_storeu_si256((__m256i*)(data + 2 * i + 32), _mm256_unpackhi_epi8(v, space));
+    }
+}
+
+__attribute__((target("avx2")))
+static void expand_avx2(char* data, size_t len) {
+    expand_range_avx2(data, 0, len);
+}
+
+static const text_kernels_t avx2_kernels = {
+    "avx2", upper_avx2, reverse_avx2, rotate_right_memmove, expand_avx2,
+};
+
+/* ---- AVX-512BW (64 bytes, masked tails) ------------------------------- */
+
+__attribute__((target("avx512f,avx512bw")))
+static void upper_avx512(char* data, size_t len) {
+    const __m512i below = _mm512_set1_epi8('a' - 1);
+    const __m512i above = _mm512_set1_epi8('z' + 1);
+    const __m512i delta = _mm512_set1_epi8('a' - 'A');
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m512i v = _mm512_loadu_si512(data + i);
+        __mmask64 lower = _mm512_cmpgt_epi8_mask(v, below) & _mm512_cmplt_epi8_mask(v, above);
+        _mm512_storeu_si512(data + i, _mm512_mask_sub_epi8(v, lower, v, delta));
+    }
+    if (i < len) {
+        __mmask64 live = ((__mmask64)1 << (len - i)) - 1;
+        __m512i v = _mm512_maskz_loadu_epi8(live, data + i);
+        __mmask64 lower = _mm512_cmpgt_epi8_mask(v, below) & _mm512_cmplt_epi8_mask(v, above);
+        _mm512_mask_storeu_epi8(data + i, live & lower, _mm512_sub_epi8(v, delta));
+    }
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static inline __m512i reverse64_avx512(__m512i v) {
+    const __m512i lane_reverse = _mm512_set_epi64(
+        0x0001020304050607LL, 0x08090a0b0c0d0e0fLL, 0x0001020304050607LL, 0x08090a0b0c0d0e0fLL,
+        0x0001020304050607LL, 0x08090a0b0c0d0e0fLL, 0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+    v = _mm512_shuffle_epi8(v, lane_reverse);
+    return _mm512_shuffle_i64x2(v, v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void reverse_avx512(char* data, size_t len) {
+    size_t i = 0, j = len;
+    while (j - i >= 128) {
+        __m512i head = _mm512_loadu_si512(data + i);
+        __m512i tail = _mm512_loadu_si512(data + j - 64);
+        _mm512_storeu_si512(data + i, reverse64_avx512(tail));
+        _mm512_storeu_si512(data + j - 64, reverse64_avx512(head));
+        i += 64;
+        j -= 64;
+    }
+    reverse_avx2(data + i, j - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void expand_avx512(char* data, size_t len) {
+    const __m512i space = _mm512_set1_epi8(' ');
+    const __m512i order = _mm512_setr_epi64(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t blocks = len & ~(size_t)63;
+    expand_range_avx2(data, blocks, len);
+    for (size_t i = blocks; i > 0;) {
+        i -= 64;
+        __m512i v = _mm512_permutexvar_epi64(order, _mm512_loadu_si512(data + i));
+        _mm512_storeu_si512(data + 2 * i, _mm512_unpacklo_epi8(v, space));
+        _mm512_storeu_si512(data + 2 * i + 64, _mm512_unpackhi_epi8(v, space));
+    }
+}
+
+static const text_kernels_t avx512_kernels = {
+    "avx512", upper_avx512, reverse_avx512, rotate_right_memmove, expand_avx512,
+};
+
+#endif /* TEXT_KERNELS_X86 */
+
+const text_kernels_t* text_kernels_by_name(const char* name) {
+    if (name == NULL) return NULL;
+    if (strcmp(name, "scalar") == 0) return &scalar_kernels;
+#ifdef TEXT_KERNELS_X86
+    __builtin_cpu_init();
+    if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) return &sse2_kernels;
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) return &avx2_kernels;
+    if (strcmp(name, "avx512") == 0 && __builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512bw")) {
+        return &avx512_kernels;
+    }
+#endif
+    return NULL;
+}
+
+static const text_kernels_t* select_kernels(void) {
+    const text_kernels_t* forced = text_kernels_by_name(getenv(TEXT_KERNELS_ENV));
+    if (forced) return forced;
+    static const char* const preference[] = { "avx512", "avx2", "sse2" };
+    for (size_t i = 0; i < sizeof(preference) / sizeof(preference[0]); i++) {
+        const text_kernels_t* kernels = text_kernels_by_name(preference[i]);
+        if (kernels) return kernels;
+    }
+    return &scalar_kernels;
+}
+
+const text_kernels_t* text_kernels(void) {
+    /* Racing first calls pick the same table, so a plain publish is enough */
+    static _Atomic(const text_kernels_t*) active;
+    const text_kernels_t* kernels = atomic_load_explicit(&active, memory_order_acquire);
+    if (kernels == NULL) {
+        kernels = select_kernels();
+        atomic_store_explicit(&active, kernels, memory_order_release);
+    }
+    return kernels;
+}
@@ -0,0 +1,64 @@
+#ifndef TEXT_KERNELS_H
+#define TEXT_KERNELS_H
+
+#include <stddef.h>
+
+/**
+ * Vectorized in-place kernels behind the built-in transforms.
+ * Every instruction set variant produces exactly the output of the scalar
+ * one; the best variant the CPU supports is picked once (cpuid) on first
+ * use. Plugins run in the "C" locale, so upper-casing only touches a-z.
+ */
+
+// Forces a variant by name ("scalar", "sse2", "avx2", "avx512")
+#define TEXT_KERNELS_ENV "ANALYZER_KERNELS"
+
+typedef struct text_kernels {
+    const char* name;
+
+    /**
+     * Upper-case ASCII letters
+     * @param data Bytes to rewrite
+     * @param len Number of bytes
+     */
+    void (*upper)(char* data, size_t len);
+
+    /**
+     * Reverse the byte order
+     * @param data Bytes to rewrite
+     * @param len Number of bytes
+     */
+    void (*reverse)(char* data, size_t len);
+
+    /**
+     * Rotate one position to the right (the last byte moves to the front)
+     * @param data Bytes to rewrite
+     * @param len Number of bytes
+     */
+    void (*rotate_right)(char* data, size_t len);
+
+    /**
+     * Spread len bytes in place so a space follows every byte, producing
+     * 2*len-1 bytes of output
+     * @param data Bytes to rewrite; must have room for 2*len bytes (the
+     *        last one is scratch and left as a space)
+     * @param len Number of input bytes
+     */
+    void (*expand)(char* data, size_t len);
+} text_kernels_t;
+
+/**
+ * Kernels for this CPU, or the ones named by TEXT_KERNELS_ENV when this
+ * CPU supports them
+ * @return Kernel table (never NULL)
+ */
+const text_kernels_t* text_kernels(void);
+
+/**
+ * Look up one variant
+ * @param name "scalar", "sse2", "avx2" or "avx512"
+ * @return Kernel table, or NULL when unknown or not supported by this CPU
+ */
+const text_kernels_t* text_kernels_by_name(const char* name);
+
+#endif /* TEXT_KERNELS_H */
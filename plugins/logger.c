@@ -5,20 +5,45 @@
 #include <stdlib.h>
 #include <string.h>
 
+static const char logger_prefix[] = "[logger] ";
+
 /**
  * Transformation function for the logger.
  * Logs all strings that pass through to standard output.
  */
-static const char* logger_transform(const char* input) {
-    if (input == NULL) {
-        return NULL;
-    } else {
-        printf("[logger] %s\n", input);
-    }
-    
+static const char* logger_transform(message_t* msg) {
+    struct iovec record[3] = {
+        { (void*)logger_prefix, sizeof(logger_prefix) - 1 },
+        { msg->data, msg->len },
+        { "\n", 1 },
+    };
+    common_output_write(record, 3);
     return NULL; 
 }
 
+/**
+ * Batch transformation function for the logger.
+ * Hands the whole batch to the output writer as one record, so the
+ * writer's buffer is taken once per batch instead of once per line.
+ */
+static void logger_transform_batch(message_t** msgs, int count) {
+    struct iovec parts[3 * PLUGIN_BATCH_MAX];
+    while (count > 0) {
+        int n = count > PLUGIN_BATCH_MAX ? PLUGIN_BATCH_MAX : count;
+        for (int i = 0; i < n; i++) {
+            parts[3 * i].iov_base = (void*)logger_prefix;
+            parts[3 * i].iov_len = sizeof(logger_prefix) - 1;
+            parts[3 * i + 1].iov_base = msgs[i]->data;
+            parts[3 * i + 1].iov_len = msgs[i]->len;
+            parts[3 * i + 2].iov_base = "\n";
+            parts[3 * i + 2].iov_len = 1;
+        }
+        common_output_write(parts, 3 * n);
+        msgs += n;
+        count -= n;
+    }
+}
+
 /**
  * Initialize the plugin with the specified queue size - calls
  * common_plugin_init
@@ -28,7 +53,7 @@ static const char* logger_transform(const char* input) {
  */
 __attribute__((visibility("default")))
 const char* plugin_init(int queue_size) {
-    return common_plugin_init(logger_transform, "LOGGER", queue_size);
+    return common_plugin_init_message(logger_transform, logger_transform_batch, "LOGGER", queue_size);
 }
 
 /**
@@ -55,15 +80,8 @@ const char* plugin_fini(void){
  */
 __attribute__((visibility("default")))
 const char* plugin_place_work(const char* str) {
-    plugin_context_t* context = get_plugin_context();
-    char* item_copy = strdup(str);
-    if (item_copy == NULL) return "Memory allocation failed in plugin_place_work";
-    const char* err = consumer_producer_put(context->queue, item_copy);
-    if (err != NULL) {
-        free(item_copy);
-        return err;
-    }
-    return NULL;
+    // Control lines ("<END>" from a v1 plugin upstream) become typed messages
+    return common_plugin_place_work(get_plugin_context(), str);
 }
 
 /**
@@ -95,6 +113,39 @@ const char* plugin_wait_finished(void){
     return NULL;
 }
 
+static const char* logger_create(plugin_instance_t** instance, int queue_size) {
+    return common_plugin_create(instance, logger_transform, logger_transform_batch, "LOGGER", queue_size);
+}
+
+static const plugin_descriptor_t logger_descriptor = {
+    .abi_version = PLUGIN_ABI_VERSION,
+    .size = sizeof(plugin_descriptor_t),
+    .name = "LOGGER",
+    .transform = {
+        .process = logger_transform,
+        .process_batch = logger_transform_batch,
+        .flags = MESSAGE_TRANSFORM_IN_PLACE | MESSAGE_TRANSFORM_LENGTH_PRESERVING |
+                 MESSAGE_TRANSFORM_BATCH | MESSAGE_TRANSFORM_READ_ONLY,
+    },
+    .create = logger_create,
+    .destroy = common_plugin_destroy,
+    .place_work = common_plugin_place_work,
+    .attach = common_plugin_attach,
+    .get_message_sink = common_plugin_get_message_sink,
+    .wait_finished = common_plugin_wait_finished,
+    .get_stats = common_plugin_get_stats,
+};
+
+/**
+ * Describe the plugin for the v2 ABI: per-instance entry points and the
+ * transform's capabilities
+ * @return Pointer to the static descriptor
+ */
+__attribute__((visibility("default")))
+const plugin_descriptor_t* plugin_get_descriptor(void) {
+    return &logger_descriptor;
+}
+
 /**
  * Return the plugin's display name.
  * Used for identification and debugging.
@@ -0,0 +1,198 @@
+#define _POSIX_C_SOURCE 200809L
+#include "message.h"
+#include <stdlib.h>
+#include <string.h>
+#include "sync/consumer_producer.h"
+
+static void* default_alloc(size_t size, size_t* usable) {
+    void* ptr = malloc(size);
+    if (ptr && usable) *usable = size;
+    return ptr;
+}
+
+/* Message memory comes from the host allocator once the host provides one */
+static void* (*alloc_fn)(size_t size, size_t* usable) = default_alloc;
+static void (*free_fn)(void* ptr) = free;
+
+void message_set_allocator(void* (*alloc)(size_t size, size_t* usable), void (*release)(void* ptr)) {
+    alloc_fn = alloc ? alloc : default_alloc;
+    free_fn = release ? release : free;
+}
+
+/* Flat form of a message's fields, followed by the payload (message_record_*) */
+typedef struct {
+    uint64_t seq;
+    uint64_t born_ns;
+    uint64_t stamp_ns;
+    uint32_t kind;
+    uint32_t reserved;
+} message_record_t;
+
+/* Payload stored in the same allocation, right after the header */
+static char* inline_data(message_t* msg) {
+    return (char*)(msg + 1);
+}
+
+message_t* message_new(size_t cap) {
+    size_t usable = 0;
+    message_t* msg = alloc_fn(sizeof(message_t) + cap + 1, &usable);
+    if (!msg) return NULL;
+    msg->data = inline_data(msg);
+    msg->data[0] = '\0';
+    msg->len = 0;
+    msg->cap = usable - sizeof(message_t);
+    msg->seq = 0;
+    msg->kind = MESSAGE_DATA;
+    msg->born_ns = 0;
+    msg->stamp_ns = 0;
+    atomic_init(&msg->refs, 1);
+    return msg;
+}
+
+message_t* message_from_string(const char* str, size_t len) {
+    message_t* msg = message_new(len);
+    if (!msg) return NULL;
+    memcpy(msg->data, str, len);
+    msg->data[len] = '\0';
+    msg->len = len;
+    return msg;
+}
+
+int message_reserve(message_t* msg, size_t cap) {
+    if (cap + 1 <= msg->cap) return 0;
+    size_t usable = 0;
+    char* data = alloc_fn(cap + 1, &usable);
+    if (!data) return -1;
+    memcpy(data, msg->data, msg->len + 1);
+    if (msg->data != inline_data(msg)) {
+        free_fn(msg->data);
+    }
+    msg->data = data;
+    msg->cap = usable;
+    return 0;
+}
+
+void message_adopt(message_t* msg, char* str) {
+    size_t len = strlen(str);
+    if (message_reserve(msg, len) == 0) {
+        memcpy(msg->data, str, len + 1);
+        msg->len = len;
+    }
+    free(str);
+}
+
+static const char* const control_names[] = {
+    [MESSAGE_END] = "<END>",
+    [MESSAGE_FLUSH] = "<FLUSH>",
+    [MESSAGE_BARRIER] = "<BARRIER>",
+};
+
+message_t* message_control(unsigned kind) {
+    if (kind == MESSAGE_DATA || kind >= sizeof(control_names) / sizeof(control_names[0])) {
+        return NULL;
+    }
+    const char* name = control_names[kind];
+    message_t* msg = message_from_string(name, strlen(name));
+    if (msg) {
+        msg->kind = kind;
+    }
+    return msg;
+}
+
+unsigned message_control_kind(const char* text, size_t len) {
+    if (len < 5 || text[0] != '<') {
+        return MESSAGE_DATA;
+    }
+    for (unsigned kind = MESSAGE_END; kind < sizeof(control_names) / sizeof(control_names[0]); kind++) {
+        if (len == strlen(control_names[kind]) && memcmp(text, control_names[kind], len) == 0) {
+            return kind;
+        }
+    }
+    return MESSAGE_DATA;
+}
+
+void message_free(message_t* msg) {
+    if (!msg) return;
+    // A message nobody shares skips the atomic read-modify-write
+    if (atomic_load_explicit(&msg->refs, memory_order_acquire) != 1 &&
+        atomic_fetch_sub_explicit(&msg->refs, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+    if (msg->data != inline_data(msg)) {
+        free_fn(msg->data);
+    }
+    free_fn(msg);
+}
+
+int message_make_writable(message_t** msg) {
+    message_t* shared = *msg;
+    if (atomic_load_explicit(&shared->refs, memory_order_acquire) == 1) return 0;
+    message_t* copy = message_from_string(shared->data, shared->len);
+    if (!copy) return -1;
+    copy->seq = shared->seq;
+    copy->kind = shared->kind;
+    copy->born_ns = shared->born_ns;
+    copy->stamp_ns = shared->stamp_ns;
+    message_free(shared);
+    *msg = copy;
+    return 0;
+}
+
+size_t message_record_size(const message_t* msg) {
+    return sizeof(message_record_t) + msg->len;
+}
+
+void message_record_save(const message_t* msg, void* record) {
+    message_record_t header = { msg->seq, msg->born_ns, msg->stamp_ns, msg->kind, 0 };
+    memcpy(record, &header, sizeof header);
+    memcpy((char*)record + sizeof header, msg->data, msg->len);
+}
+
+message_t* message_record_load(const void* record, size_t size) {
+    message_record_t header;
+    if (size < sizeof header) return NULL;
+    memcpy(&header, record, sizeof header);
+    message_t* msg = message_from_string((const char*)record + sizeof header, size - sizeof header);
+    if (!msg) return NULL;
+    msg->seq = header.seq;
+    msg->born_ns = header.born_ns;
+    msg->stamp_ns = header.stamp_ns;
+    msg->kind = header.kind;
+    return msg;
+}
+
+int message_droppable(void* item) {
+    return ((message_t*)item)->kind == MESSAGE_DATA;
+}
+
+static size_t message_spill_size(void* item) {
+    return message_record_size((message_t*)item);
+}
+
+static void message_spill_save(void* item, void* record) {
+    message_record_save((message_t*)item, record);
+}
+
+static void* message_spill_load(const void* record, size_t size) {
+    return message_record_load(record, size);
+}
+
+static void message_spill_release(void* item) {
+    message_free((message_t*)item);
+}
+
+const consumer_producer_spill_ops_t message_spill_ops = {
+    message_spill_size, message_spill_save, message_spill_load, message_spill_release
+};
+
+const char* message_sink_place_batch(const message_sink_t* sink, message_t** msgs, int count) {
+    if (sink->place_batch) {
+        return sink->place_batch(sink->target, msgs, count);
+    }
+    const char* first_err = NULL;
+    for (int i = 0; i < count; i++) {
+        const char* err = sink->place(sink->target, msgs[i]);
+        if (err != NULL && first_err == NULL) first_err = err;
+    }
+    return first_err;
+}
@@ -0,0 +1,212 @@
+#ifndef MESSAGE_H
+#define MESSAGE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Message kinds (message_t.kind). Control messages travel in line order
+ * but out of band: stages tell them apart by kind, never by payload. */
+#define MESSAGE_DATA    0u  /* a line */
+#define MESSAGE_END     1u  /* end of stream: forward it and stop */
+#define MESSAGE_FLUSH   2u  /* write out everything before it, and wait until it is out */
+#define MESSAGE_BARRIER 3u  /* cut batches here: hand on buffered work now, without waiting */
+
+/**
+ * Message handle passed between pipeline stages.
+ * Ownership moves with the pointer: whoever receives a message through a
+ * message sink either forwards it or frees it, and nobody copies the payload
+ * on the way. The payload is always NUL-terminated at data[len].
+ * A tee hands one message to several branches at once (refs > 1): each
+ * holder may read it and must free it, but only a holder that has called
+ * message_make_writable may change it.
+ */
+typedef struct message {
+    char* data;     /* payload; inline after the header until it outgrows it */
+    size_t len;     /* payload length, excluding the NUL */
+    size_t cap;     /* bytes available at data, including the NUL */
+    uint64_t seq;   /* input order, assigned by the host when the line is read */
+    unsigned kind;  /* MESSAGE_*; the payload of a control message is its name, e.g. "<END>" */
+    uint64_t born_ns;   /* latency tracing: when the line entered the chain (0 = untraced) */
+    uint64_t stamp_ns;  /* latency tracing: when the last stage handed it on */
+    atomic_uint refs;   /* holders; the last message_free releases it */
+} message_t;
+
+/**
+ * Where a stage forwards its messages.
+ * place and place_batch always take ownership: a message the target cannot
+ * accept is freed by the target, and the error is reported to the caller.
+ * place_batch is optional.
+ */
+typedef struct message_sink {
+    const char* (*place)(void* target, message_t* msg);
+    const char* (*place_batch)(void* target, message_t** msgs, int count);
+    void* target;
+} message_sink_t;
+
+/* Transform properties (message_transform_t.flags) */
+#define MESSAGE_TRANSFORM_PURE              0x01u  /* output depends only on the input, no side effects */
+#define MESSAGE_TRANSFORM_IN_PLACE          0x02u  /* rewrites the payload without reallocating it */
+#define MESSAGE_TRANSFORM_LENGTH_PRESERVING 0x04u  /* output length equals input length */
+#define MESSAGE_TRANSFORM_BATCH             0x08u  /* process_batch is provided */
+#define MESSAGE_TRANSFORM_THREAD_SAFE       0x10u  /* process may run on several threads at once */
+#define MESSAGE_TRANSFORM_READ_ONLY         0x20u  /* never writes the message, so it may read a shared one */
+
+/**
+ * A stage's processing step, exported so the host can run it inline on
+ * another stage's thread (stage fusion).
+ * process rewrites the message in place; process_batch is optional.
+ */
+typedef struct message_transform {
+    const char* (*process)(message_t* msg);
+    void (*process_batch)(message_t** msgs, int count);
+    unsigned flags;     /* MESSAGE_TRANSFORM_* */
+} message_transform_t;
+
+/**
+ * Route message memory through an allocator (the host's, see
+ * host_services_t). Must be set before the first message is created.
+ * @param alloc Allocation function; NULL restores malloc
+ * @param release Matching free function; NULL restores free
+ */
+void message_set_allocator(void* (*alloc)(size_t size, size_t* usable), void (*release)(void* ptr));
+
+/**
+ * Allocate an empty message with room for at least cap payload bytes
+ * @param cap Payload capacity, excluding the NUL
+ * @return New message or NULL on allocation failure
+ */
+message_t* message_new(size_t cap);
+
+/**
+ * Allocate a message holding a copy of a string
+ * @param str Bytes to copy
+ * @param len Number of bytes
+ * @return New message or NULL on allocation failure
+ */
+message_t* message_from_string(const char* str, size_t len);
+
+/**
+ * Make room for at least cap payload bytes, preserving the contents
+ * @param msg Message
+ * @param cap Payload capacity, excluding the NUL
+ * @return 0 on success, -1 on allocation failure (msg unchanged)
+ */
+int message_reserve(message_t* msg, size_t cap);
+
+/**
+ * Replace the payload with a malloc'd string (the result of a v1
+ * process_function) and free the string
+ * @param msg Message
+ * @param str malloc'd NUL-terminated string
+ */
+void message_adopt(message_t* msg, char* str);
+
+/**
+ * Allocate a control message
+ * @param kind MESSAGE_END, MESSAGE_FLUSH or MESSAGE_BARRIER
+ * @return New message or NULL on allocation failure
+ */
+message_t* message_control(unsigned kind);
+
+/**
+ * Recognize a line that spells a control message (<END>, <FLUSH> or
+ * <BARRIER>). Only input boundaries (the host's readers and the v1 string
+ * interface) look at text; everything past them checks message_t.kind.
+ * @param text Line bytes
+ * @param len Line length
+ * @return The control kind, or MESSAGE_DATA for an ordinary line
+ */
+unsigned message_control_kind(const char* text, size_t len);
+
+/**
+ * Whether a message is the end-of-stream signal
+ * @param msg Message
+ * @return Non-zero for MESSAGE_END
+ */
+static inline int message_is_end(const message_t* msg) {
+    return msg->kind == MESSAGE_END;
+}
+
+/**
+ * Length of the run of data messages at the start of a batch
+ * @param msgs Messages
+ * @param count Number of messages
+ * @return Index of the first control message, or count
+ */
+static inline int message_data_run(message_t* const* msgs, int count) {
+    int data = 0;
+    while (data < count && msgs[data]->kind == MESSAGE_DATA) {
+        data++;
+    }
+    return data;
+}
+
+/**
+ * Drop a reference to a message; the last one frees it and its payload
+ * @param msg Message (may be NULL)
+ */
+void message_free(message_t* msg);
+
+/**
+ * Add references, one for each extra holder a message is handed to
+ * @param msg Message
+ * @param holders Number of references to add
+ */
+static inline void message_share(message_t* msg, unsigned holders) {
+    atomic_fetch_add_explicit(&msg->refs, holders, memory_order_relaxed);
+}
+
+/**
+ * Make sure nobody else holds a message before changing it: a shared
+ * message is replaced by a private copy and the reference to it dropped
+ * @param msg Message; replaced by the copy when one is made
+ * @return 0 on success, -1 on allocation failure (*msg unchanged)
+ */
+int message_make_writable(message_t** msg);
+
+/**
+ * Bytes a message takes as a flat record (message_record_save)
+ * @param msg Message
+ * @return Record size
+ */
+size_t message_record_size(const message_t* msg);
+
+/**
+ * Write a message as a flat record: its fields, then the payload. Used to
+ * move messages through memory that is not the allocator's (queue spills).
+ * @param msg Message (unchanged)
+ * @param record Destination with room for message_record_size(msg) bytes
+ */
+void message_record_save(const message_t* msg, void* record);
+
+/**
+ * Rebuild a message from a record written by message_record_save
+ * @param record Record bytes
+ * @param size Record size
+ * @return New message or NULL on allocation failure or a short record
+ */
+message_t* message_record_load(const void* record, size_t size);
+
+/**
+ * Whether a queue's overflow policy may shed a message: lines, never control messages
+ * @param item Message
+ * @return Non-zero for a data message
+ */
+int message_droppable(void* item);
+
+/* Queue spill callbacks that store messages as flat records (message_record_save) */
+struct consumer_producer_spill_ops;
+extern const struct consumer_producer_spill_ops message_spill_ops;
+
+/**
+ * Place a batch of messages through a sink, one call when the sink has
+ * place_batch and one place per message otherwise
+ * @param sink Destination (takes ownership of every message)
+ * @param msgs Messages
+ * @param count Number of messages
+ * @return NULL on success, first error message on failure
+ */
+const char* message_sink_place_batch(const message_sink_t* sink, message_t** msgs, int count);
+
+#endif /* MESSAGE_H */
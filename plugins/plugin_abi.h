@@ -0,0 +1,96 @@
+#ifndef PLUGIN_ABI_H
+#define PLUGIN_ABI_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "message.h"
+#include "stats.h"
+
+/**
+ * Plugin ABI v2.
+ * A v2 plugin exports plugin_get_descriptor(). Every stage the host builds
+ * from it is a separate instance with its own queue and consumer thread, so
+ * one .so can appear in a chain any number of times. The v1 entry points
+ * (plugin_init, plugin_place_work, ...) keep driving a single default
+ * instance for hosts that predate v2.
+ */
+
+#define PLUGIN_ABI_VERSION 2
+
+/* One running stage built from a plugin (opaque to the host) */
+typedef struct plugin_instance plugin_instance_t;
+
+typedef struct plugin_descriptor {
+    uint32_t abi_version;   /* PLUGIN_ABI_VERSION the plugin was built against */
+    uint32_t size;          /* sizeof(plugin_descriptor_t) as seen by the plugin */
+    const char* name;       /* display name */
+
+    /**
+     * The plugin's processing step. transform.flags declares its
+     * capabilities (MESSAGE_TRANSFORM_*), which let the host fuse or
+     * replicate the stage.
+     */
+    message_transform_t transform;
+
+    /**
+     * Create an instance and start its consumer thread
+     * @param instance Receives the instance
+     * @param queue_size Maximum number of items that can be queued
+     * @return NULL on success, error message on failure
+     */
+    const char* (*create)(plugin_instance_t** instance, int queue_size);
+
+    /**
+     * Drain the instance, join its thread and free it
+     * @param instance Instance
+     * @return NULL on success, error message on failure
+     */
+    const char* (*destroy)(plugin_instance_t* instance);
+
+    /**
+     * Place work (a copy of str) into the instance's queue
+     * @param instance Instance
+     * @param str The string to process
+     * @return NULL on success, error message on failure
+     */
+    const char* (*place_work)(plugin_instance_t* instance, const char* str);
+
+    /**
+     * Forward the instance's processed messages to a sink
+     * @param instance Instance
+     * @param next_sink Next stage's sink (copied)
+     */
+    void (*attach)(plugin_instance_t* instance, const message_sink_t* next_sink);
+
+    /**
+     * Get the sink feeding the instance's queue without copying
+     * @param instance Instance
+     * @param sink Filled with the instance's sink
+     */
+    void (*get_message_sink)(plugin_instance_t* instance, message_sink_t* sink);
+
+    /**
+     * Wait until the instance has forwarded <END>
+     * @param instance Instance
+     * @return NULL on success, error message on failure
+     */
+    const char* (*wait_finished)(plugin_instance_t* instance);
+
+    /* Members below were appended after v2 shipped; check PLUGIN_DESCRIPTOR_HAS */
+
+    /**
+     * Sample the instance's counters and input queue (optional, may be NULL)
+     * @param instance Instance
+     * @param stats Filled with the snapshot
+     */
+    void (*get_stats)(plugin_instance_t* instance, stage_stats_t* stats);
+} plugin_descriptor_t;
+
+/* Smallest descriptor a v2 plugin may hand over */
+#define PLUGIN_DESCRIPTOR_MIN_SIZE offsetof(plugin_descriptor_t, get_stats)
+
+/* Member is present (and set) in a descriptor of the given size */
+#define PLUGIN_DESCRIPTOR_HAS(desc, member) \
+    ((desc)->size >= offsetof(plugin_descriptor_t, member) + sizeof((desc)->member) && (desc)->member)
+
+#endif /* PLUGIN_ABI_H */
@@ -1,54 +1,107 @@
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 #include "plugin_common.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <sched.h>
+
+static const host_services_t* host_services;
 
 plugin_context_t* get_plugin_context(void) {
     static plugin_context_t context;
     return &context;
 }
 
+/**
+ * Hand messages to the next stage. A message sink takes ownership; the v1
+ * place_work copies, so the messages are released here after the call.
+ */
+static void forward_batch(plugin_context_t* context, message_t** msgs, int count) {
+    if (context->next_sink.place) {
+        (void)message_sink_place_batch(&context->next_sink, msgs, count);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        if (context->next_place_work) {
+            (void)context->next_place_work(msgs[i]->data);
+        }
+        message_free(msgs[i]);
+    }
+}
+
+/**
+ * Run the process function(s) over a batch of data messages and forward
+ * the results downstream in one handoff
+ */
+static void process_batch(plugin_context_t* context, message_t** msgs, int count) {
+    uint64_t bytes_in = 0, bytes_out = 0;
+    for (int i = 0; i < count; i++) {
+        bytes_in += msgs[i]->len;
+    }
+    uint64_t start = stats_now_ns();
+    if (context->process_batch_function) {
+        context->process_batch_function(msgs, count);
+    } else if (context->process_message) {
+        for (int i = 0; i < count; i++) {
+            const char* err = context->process_message(msgs[i]);
+            if (err) log_error(context, err);
+        }
+    } else if (context->process_function) {
+        for (int i = 0; i < count; i++) {
+            const char* out = context->process_function(msgs[i]->data);
+            if (out != NULL && out != msgs[i]->data) {
+                message_adopt(msgs[i], (char*)out);
+            }
+        }
+    }
+    uint64_t busy = stats_now_ns() - start;
+    for (int i = 0; i < count; i++) {
+        bytes_out += msgs[i]->len;
+    }
+    stage_counters_record(&context->stats, (uint64_t)count, bytes_in, bytes_out, busy);
+    forward_batch(context, msgs, count);
+}
+
 void* plugin_consumer_thread(void* arg) {
     plugin_context_t* context = (plugin_context_t*)arg;
     if (!context || !context->queue) {
         return NULL;
     }
+    message_t* msgs[PLUGIN_BATCH_MAX];
+    stage_counters_begin(&context->stats);
     while (1){
-        char* item = consumer_producer_get(context->queue);
-        if (item == NULL) {
+        int count = consumer_producer_get_batch(context->queue, (void**)msgs, PLUGIN_BATCH_MAX);
+        if (count == 0) {
+            stage_counters_end(&context->stats);
             break;
         }
 
-        // Check for <END> signal - if found, pass it through and break
-        if ((strcmp(item, "<END>") == 0) || (strcmp(item, "END") == 0)) {
-            if (context->next_place_work) {
-                (void)context->next_place_work(item);
+        // Process each run of lines; a control message goes on as soon as the run in front of it has
+        int i = 0;
+        int ended = 0;
+        while (i < count && !ended) {
+            int data = message_data_run(msgs + i, count - i);
+            if (data > 0) {
+                process_batch(context, msgs + i, data);
+                i += data;
+                continue;
             }
-            free(item);
-            // Signal that this plugin is finished
-            consumer_producer_signal_finished(context->queue);
-            break;
+            ended = message_is_end(msgs[i]);
+            forward_batch(context, &msgs[i++], 1);
         }
-
-        const char* out = NULL;
-        if (context->process_function) {
-            out = context->process_function(item);
+        if (!ended) {
+            continue;
         }
-        const char* pass = (out != NULL) ? out : item;
 
-        if (context->next_place_work) {
-            (void)context->next_place_work(pass);
-            if (out != NULL && out != item) {
-                free(item);
-            }
-        } else {
-            if (out != NULL && out != item) {
-                free((void*)out);
-            }
-            free(item);
+        // <END> has been passed through - stop
+        for (; i < count; i++) {
+            message_free(msgs[i]);
         }
+        // Signal that this plugin is finished, with its CPU time final
+        stage_counters_end(&context->stats);
+        consumer_producer_signal_finished(context->queue);
+        break;
     }
     return NULL;
 }
@@ -67,30 +120,91 @@ void log_info(plugin_context_t* context, const char* message) {
     
 }
 
-const char* common_plugin_init(const char* (*process_function)(const char*),const char* name, int queue_size) {
-    plugin_context_t* context = get_plugin_context();
-    if (process_function == NULL) {
-        return "Process function cannot be NULL";
+/**
+ * Start the consumer thread, on the CPU the host picked for this stage if
+ * it picked one. Pinning is best effort: the thread runs unpinned if the
+ * affinity cannot be set.
+ */
+static int start_consumer_thread(plugin_context_t* context) {
+    int cpu = -1;
+    if (host_services && HOST_SERVICES_HAS(host_services, stage_cpu) && host_services->stage_cpu) {
+        cpu = host_services->stage_cpu();
+    }
+    if (cpu >= 0) {
+        pthread_attr_t attr;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (pthread_attr_init(&attr) == 0) {
+            int rc = pthread_attr_setaffinity_np(&attr, sizeof set, &set) == 0
+                ? pthread_create(&context->consumer_thread, &attr, plugin_consumer_thread, context)
+                : -1;
+            pthread_attr_destroy(&attr);
+            if (rc == 0) {
+                return 0;
+            }
+        }
     }
+    return pthread_create(&context->consumer_thread, NULL, plugin_consumer_thread, context);
+}
+
+static void message_release(void* context, void* item) {
+    (void)context;
+    message_free((message_t*)item);
+}
+
+/*
+ * Apply the overflow policy the host picked for this stage, if any
+ * @return NULL on success, error message if the queue cannot spill
+ */
+static const char* apply_queue_policy(plugin_context_t* context) {
+    if (!host_services || !HOST_SERVICES_HAS(host_services, stage_queue_policy) ||
+        !host_services->stage_queue_policy) {
+        return NULL;
+    }
+    const char* text = host_services->stage_queue_policy();
+    consumer_producer_policy_t policy;
+    if (text == NULL) {
+        return NULL;
+    }
+    if (consumer_producer_policy_parse(text, &policy) != 0) {
+        log_error(context, "Unknown queue policy, blocking when full");
+        return NULL;
+    }
+    if (policy.overflow == CP_POLICY_SPILL) {
+        return consumer_producer_set_spill(context->queue, policy.spill_dir, &message_spill_ops);
+    }
+    consumer_producer_set_policy(context->queue, &policy, message_droppable, message_release, NULL);
+    return NULL;
+}
+
+static const char* common_plugin_setup(plugin_context_t* context, const char* name, int queue_size) {
     if (queue_size <= 0) {
         return "Queue size must be greater than 0";
     }
     context->name = name ? name : "plugin";
-    context->process_function = process_function;
     context->next_place_work = NULL; 
+    memset(&context->next_sink, 0, sizeof(context->next_sink));
 
     if (context->queue == NULL) {
-        context->queue = malloc(sizeof *context->queue);
+        /* Over-aligned so the SPSC head/tail lines do not share with the heap neighbour */
+        context->queue = aligned_alloc(CP_CACHE_LINE, sizeof *context->queue);
         if (!context->queue) {
             return "malloc failed for queue";
         }
     }
-    const char* err = consumer_producer_init(context->queue, queue_size);
+    const char* err = consumer_producer_init_backend(context->queue, queue_size,
+                                                     consumer_producer_backend_from_env());
     if (err != NULL) {
         return err;
     }
+    err = apply_queue_policy(context);
+    if (err != NULL) {
+        consumer_producer_destroy(context->queue);
+        return err;
+    }
 
-    int rc = pthread_create(&context->consumer_thread, NULL, plugin_consumer_thread, context);
+    int rc = start_consumer_thread(context);
     if (rc != 0) {
         log_error(context, "Failed to create consumer thread");
         consumer_producer_destroy(context->queue);
@@ -98,3 +212,155 @@ const char* common_plugin_init(const char* (*process_function)(const char*),cons
     }    
     return NULL;
 }
+
+const char* common_plugin_init(const char* (*process_function)(const char*),const char* name, int queue_size) {
+    plugin_context_t* context = get_plugin_context();
+    if (process_function == NULL) {
+        return "Process function cannot be NULL";
+    }
+    context->process_function = process_function;
+    context->process_message = NULL;
+    context->process_batch_function = NULL;
+    return common_plugin_setup(context, name, queue_size);
+}
+
+const char* common_plugin_init_message(plugin_message_process_t process_message,
+plugin_batch_process_t process_batch_function, const char* name, int queue_size) {
+    plugin_context_t* context = get_plugin_context();
+    if (process_message == NULL) {
+        return "Process function cannot be NULL";
+    }
+    context->process_function = NULL;
+    context->process_message = process_message;
+    context->process_batch_function = process_batch_function;
+    return common_plugin_setup(context, name, queue_size);
+}
+
+const char* common_plugin_place_message(plugin_context_t* context, message_t* msg) {
+    const char* err = consumer_producer_put(context->queue, msg);
+    if (err != NULL) {
+        message_free(msg);
+    }
+    return err;
+}
+
+static const char* context_place_message(void* target, message_t* msg) {
+    return common_plugin_place_message((plugin_context_t*)target, msg);
+}
+
+static const char* context_place_message_batch(void* target, message_t** msgs, int count) {
+    plugin_context_t* context = (plugin_context_t*)target;
+    int queued = 0;
+    const char* err = consumer_producer_put_batch(context->queue, (void* const*)msgs, count, &queued);
+    if (err != NULL) {
+        for (int i = queued; i < count; i++) message_free(msgs[i]);
+    }
+    return err;
+}
+
+const char* common_plugin_create(plugin_instance_t** instance, plugin_message_process_t process_message,
+plugin_batch_process_t process_batch_function, const char* name, int queue_size) {
+    if (process_message == NULL) {
+        return "Process function cannot be NULL";
+    }
+    plugin_context_t* context = calloc(1, sizeof *context);
+    if (!context) {
+        return "malloc failed for plugin instance";
+    }
+    context->process_message = process_message;
+    context->process_batch_function = process_batch_function;
+    const char* err = common_plugin_setup(context, name, queue_size);
+    if (err != NULL) {
+        free(context->queue);
+        free(context);
+        return err;
+    }
+    *instance = context;
+    return NULL;
+}
+
+const char* common_plugin_destroy(plugin_instance_t* instance) {
+    if (!instance) return NULL;
+    consumer_producer_signal_finished(instance->queue);
+    pthread_join(instance->consumer_thread, NULL);
+    consumer_producer_destroy(instance->queue);
+    free(instance->queue);
+    free(instance);
+    return NULL;
+}
+
+const char* common_plugin_place_work(plugin_instance_t* instance, const char* str) {
+    size_t len = strlen(str);
+    unsigned kind = message_control_kind(str, len);
+    message_t* msg = kind == MESSAGE_DATA ? message_from_string(str, len) : message_control(kind);
+    if (msg == NULL) return "Memory allocation failed in plugin_place_work";
+    return common_plugin_place_message(instance, msg);
+}
+
+void common_plugin_attach(plugin_instance_t* instance, const message_sink_t* next_sink) {
+    if (!instance || !next_sink) return;
+    instance->next_sink = *next_sink;
+}
+
+void common_plugin_get_message_sink(plugin_instance_t* instance, message_sink_t* sink) {
+    if (!sink) return;
+    sink->place = context_place_message;
+    sink->place_batch = context_place_message_batch;
+    sink->target = instance;
+}
+
+const char* common_plugin_wait_finished(plugin_instance_t* instance) {
+    if (!instance) return "Plugin context is NULL";
+    if (consumer_producer_wait_finished(instance->queue) != 0) {
+        return "plugin_wait_finished: wait failed";
+    }
+    return NULL;
+}
+
+void common_plugin_get_stats(plugin_instance_t* instance, stage_stats_t* stats) {
+    memset(stats, 0, sizeof *stats);
+    if (!instance || !instance->queue) return;
+    stage_counters_read(&instance->stats, stats);
+    stats->threads = 1;
+    stats->has_queue = 1;
+    consumer_producer_get_stats(instance->queue, &stats->queue);
+}
+
+__attribute__((visibility("default")))
+void plugin_get_stats(stage_stats_t* stats) {
+    common_plugin_get_stats(get_plugin_context(), stats);
+}
+
+__attribute__((visibility("default")))
+void plugin_get_message_sink(message_sink_t* sink) {
+    common_plugin_get_message_sink(get_plugin_context(), sink);
+}
+
+__attribute__((visibility("default")))
+void plugin_attach_message_sink(const message_sink_t* next_sink) {
+    common_plugin_attach(get_plugin_context(), next_sink);
+}
+
+const host_services_t* common_host_services(void) {
+    return host_services;
+}
+
+void common_output_write(const struct iovec* parts, int count) {
+    if (host_services && HOST_SERVICES_HAS(host_services, output_write) && host_services->output_write) {
+        host_services->output_write(parts, count);
+        return;
+    }
+    flockfile(stdout);
+    for (int i = 0; i < count; i++) {
+        fwrite(parts[i].iov_base, 1, parts[i].iov_len, stdout);
+    }
+    funlockfile(stdout);
+}
+
+__attribute__((visibility("default")))
+void plugin_set_host_services(const host_services_t* services) {
+    host_services = services;
+    if (services && HOST_SERVICES_HAS(services, msg_free)) {
+        message_set_allocator(services->msg_alloc, services->msg_free);
+    }
+}
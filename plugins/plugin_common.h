@@ -3,6 +3,9 @@
 
 
 #include <pthread.h>
+#include "host_services.h"
+#include "message.h"
+#include "plugin_abi.h"
 #include "sync/consumer_producer.h"
 #include "sync/monitor.h"
 
@@ -11,24 +14,56 @@
  * Common SDK structures and functions for plugin implementation 
  * Header from PDF.
  */ 
- 
-// Plugin context structure 
-typedef struct 
+
+// Maximum number of items a consumer thread takes from its queue at once
+#define PLUGIN_BATCH_MAX 64
+
+/** 
+ * In-place message processing function.
+ * May rewrite msg->data/len (growing it with message_reserve when needed).
+ * @return NULL on success, error message on failure (the message is still
+ * forwarded)
+ */ 
+typedef const char* (*plugin_message_process_t)(message_t* msg);
+
+/** 
+ * Batch variant of plugin_message_process_t, called with every data message
+ * the consumer thread drained in one queue acquisition
+ */ 
+typedef void (*plugin_batch_process_t)(message_t** msgs, int count);
+
+/*
+ * Linkage of a pure plugin's transform (<name>_transform). analyzer-static
+ * calls the transforms of its built-in plugins by name (gen_static.sh),
+ * so they can inline into its specialized chains.
+ */
+#ifdef ANALYZER_STATIC
+#define PLUGIN_TRANSFORM
+#else
+#define PLUGIN_TRANSFORM static
+#endif
+
+// Plugin context structure (one per instance; v1 entry points use a static default one)
+typedef struct plugin_instance
 { 
     const char* name;                         // Plugin name (for diagnosis) 
-    consumer_producer_t* queue;                    // Input queue 
+    consumer_producer_t* queue;                    // Input queue (holds message_t*)
     pthread_t consumer_thread;                     // Consumer thread 
     const char* (*next_place_work)(const char*);   // Next plugin's place_work function 
+    message_sink_t next_sink;                      // Next stage's message sink (preferred when set)
     const char* (*process_function)(const char*);  // Plugin-specific processing function 
+    plugin_message_process_t process_message;      // In-place variant of process_function
+    plugin_batch_process_t process_batch_function; // Batch variant of process_message (optional)
     int initialized;                               // Initialization flag 
     int finished;                                  // Finished processing flag 
+    stage_counters_t stats;                        // Written by the consumer thread only
 } plugin_context_t; 
 
-/**
+/** 
  * Helper func
- */
+ */ 
 plugin_context_t* get_plugin_context(void);
- 
+
 /** 
  * Generic consumer thread function 
  * This function runs in a separate thread and processes items from the queue 
@@ -36,21 +71,21 @@ plugin_context_t* get_plugin_context(void);
  * @return NULL 
  */ 
 void* plugin_consumer_thread(void* arg) ;
- 
+
 /** 
  * Print error message in the format [ERROR][Plugin Name] - message 
  * @param context Plugin context 
  * @param message Error message 
  */ 
 void log_error(plugin_context_t* context, const char* message) ;
- 
+
 /** 
  * Print info message in the format [INFO][Plugin Name] - message 
  * @param context Plugin context 
  * @param message Info message 
  */ 
 void log_info(plugin_context_t* context, const char* message) ;
- 
+
 
 /** 
 * Initialize the common plugin infrastructure with the specified queue size 
@@ -62,5 +97,114 @@ void log_info(plugin_context_t* context, const char* message) ;
 const char* common_plugin_init(const char* (*process_function)(const char*), 
 const char* name, int queue_size); 
 
+/** 
+* Initialize the common plugin infrastructure for a plugin that transforms
+* messages in place, so a line crosses the stage without being copied
+* @param process_message In-place processing function
+* @param process_batch_function Batch variant (may be NULL)
+* @param name Plugin name 
+* @param queue_size Maximum number of items that can be queued 
+* @return NULL on success, error message on failure 
+*/ 
+const char* common_plugin_init_message(plugin_message_process_t process_message,
+plugin_batch_process_t process_batch_function, const char* name, int queue_size);
+
+/** 
+* Queue a message on the plugin's input
+* @param context Plugin context
+* @param msg Message (ownership is always taken)
+* @return NULL on success, error message on failure 
+*/ 
+const char* common_plugin_place_message(plugin_context_t* context, message_t* msg);
+
+/** 
+* Get the sink that feeds this plugin's input queue without copying
+* @param sink Output sink
+*/ 
+void plugin_get_message_sink(message_sink_t* sink);
+
+/** 
+* Forward processed messages to a sink instead of the next plugin's
+* place_work (no copy at the boundary)
+* @param next_sink Next stage's sink
+*/ 
+void plugin_attach_message_sink(const message_sink_t* next_sink);
+
+/** 
+* Create a v2 instance: allocate a context and start its consumer thread
+* @param instance Receives the instance
+* @param process_message In-place processing function
+* @param process_batch_function Batch variant (may be NULL)
+* @param name Plugin name 
+* @param queue_size Maximum number of items that can be queued 
+* @return NULL on success, error message on failure 
+*/ 
+const char* common_plugin_create(plugin_instance_t** instance, plugin_message_process_t process_message,
+plugin_batch_process_t process_batch_function, const char* name, int queue_size);
+
+/** 
+* Drain an instance, join its thread and free it (plugin_descriptor_t.destroy)
+* @param instance Instance
+* @return NULL on success, error message on failure 
+*/ 
+const char* common_plugin_destroy(plugin_instance_t* instance);
+
+/** 
+* Copy a string into an instance's queue (plugin_descriptor_t.place_work)
+* @param instance Instance
+* @param str The string to process
+* @return NULL on success, error message on failure 
+*/ 
+const char* common_plugin_place_work(plugin_instance_t* instance, const char* str);
+
+/** 
+* Forward an instance's output to a sink (plugin_descriptor_t.attach)
+* @param instance Instance
+* @param next_sink Next stage's sink
+*/ 
+void common_plugin_attach(plugin_instance_t* instance, const message_sink_t* next_sink);
+
+/** 
+* Get the sink feeding an instance (plugin_descriptor_t.get_message_sink)
+* @param instance Instance
+* @param sink Output sink
+*/ 
+void common_plugin_get_message_sink(plugin_instance_t* instance, message_sink_t* sink);
+
+/** 
+* Wait until an instance has forwarded <END> (plugin_descriptor_t.wait_finished)
+* @param instance Instance
+* @return NULL on success, error message on failure 
+*/ 
+const char* common_plugin_wait_finished(plugin_instance_t* instance);
+
+/** 
+* Sample an instance's counters and queue (plugin_descriptor_t.get_stats)
+* @param instance Instance
+* @param stats Filled with the snapshot
+*/ 
+void common_plugin_get_stats(plugin_instance_t* instance, stage_stats_t* stats);
+
+/** 
+* Receive the host's services (message allocator, ...). Called by the host
+* before plugin_init; the table stays valid until the plugin is unloaded.
+* @param services Host services table
+*/ 
+void plugin_set_host_services(const host_services_t* services);
+
+/** 
+* Host services handed to this plugin, or NULL when running without a host
+* that provides them
+*/ 
+const host_services_t* common_host_services(void);
+
+/** 
+* Write one record (the concatenation of parts) to stdout, through the
+* host's buffered writer when it offers one
+* @param parts Record pieces
+* @param count Number of pieces
+*/ 
+void common_output_write(const struct iovec* parts, int count);
+
 
-#endif
\ No newline at end of file
+#endif
@@ -34,4 +34,40 @@ shutdown
 * This is a blocking function used for graceful shutdown coordination
 * @return NULL on success, error message on failure
 */
-const char* plugin_wait_finished(void);
\ No newline at end of file
+const char* plugin_wait_finished(void);
+/**
+* Optional: get the message sink feeding this plugin's queue. Messages placed
+* through it are queued without copying; the plugin takes ownership.
+* @param sink Filled with the plugin's sink
+*/
+void plugin_get_message_sink(message_sink_t* sink);
+/**
+* Optional: forward processed messages to a message sink instead of the next
+plugin's place_work, transferring ownership without copying
+* @param next_sink Next stage's message sink
+*/
+void plugin_attach_message_sink(const message_sink_t* next_sink);
+/**
+* Optional: receive the host services table (message allocator, ...).
+* Called before plugin_init. Plugins exchanging messages must use the host's
+allocator, so the host only uses the message entry points of plugins that
+export this.
+* @param services Host services table
+*/
+void plugin_set_host_services(const host_services_t* services);
+/**
+* Optional: sample the default instance's counters and queue (items, bytes,
+processing time, queue depth and wait times). ABI v2 plugins provide the
+same per instance through plugin_descriptor_t.get_stats.
+* @param stats Filled with the snapshot
+*/
+void plugin_get_stats(stage_stats_t* stats);
+/**
+* Optional (ABI v2, see plugin_abi.h): describe the plugin. The host creates
+one instance per stage through the descriptor, so the same plugin can appear
+several times in a chain, and uses the declared capabilities
+(transform.flags) to fuse or replicate pure stages. Hosts that do not know
+v2 keep using the functions above, which drive a single default instance.
+* @return Pointer to a descriptor that stays valid while the plugin is loaded
+*/
+const plugin_descriptor_t* plugin_get_descriptor(void);
@@ -3,29 +3,15 @@
 #include "sync/consumer_producer.h"
 #include <string.h>
 #include <stdlib.h>
+#include "kernels/text_kernels.h"
 
 /**
  * Transformation function for the rotator.
  * Moves every character one position to the right. Last char wraps to front.
  */
-static const char* rotator_transform(const char* input) {
-    if (!input) {
-        return NULL; 
-    }
-    size_t len = strlen(input);
-    if (len == 0) {
-        return strdup(input);
-    }
-    char* rotated = (char*)malloc(len + 1);
-    if (!rotated) {
-        return NULL;
-    }
-    for (size_t i = 0; i < len - 1; i++) {
-        rotated[i + 1] = input[i];
-    }
-    rotated[0] = input[len - 1];
-    rotated[len] = '\0'; 
-    return rotated;
+PLUGIN_TRANSFORM const char* rotator_transform(message_t* msg) {
+    text_kernels()->rotate_right(msg->data, msg->len);
+    return NULL;
 }
 
 /**
@@ -37,7 +23,7 @@ static const char* rotator_transform(const char* input) {
  */
 __attribute__((visibility("default")))
 const char* plugin_init(int queue_size) {
-    return common_plugin_init(rotator_transform, "ROTATOR", queue_size);
+    return common_plugin_init_message(rotator_transform, NULL, "ROTATOR", queue_size);
 }
 
 /**
@@ -64,15 +50,8 @@ const char* plugin_fini(void){
  */
 __attribute__((visibility("default")))
 const char* plugin_place_work(const char* str) {
-    plugin_context_t* context = get_plugin_context();
-    char* item_copy = strdup(str);
-    if (item_copy == NULL) return "Memory allocation failed in plugin_place_work";
-    const char* err = consumer_producer_put(context->queue, item_copy);
-    if (err != NULL) {
-        free(item_copy);
-        return err;
-    }
-    return NULL;
+    // Control lines ("<END>" from a v1 plugin upstream) become typed messages
+    return common_plugin_place_work(get_plugin_context(), str);
 }
 
 /**
@@ -105,6 +84,39 @@ const char* plugin_wait_finished(void){
 }
 
 
+static const char* rotator_create(plugin_instance_t** instance, int queue_size) {
+    return common_plugin_create(instance, rotator_transform, NULL, "ROTATOR", queue_size);
+}
+
+static const plugin_descriptor_t rotator_descriptor = {
+    .abi_version = PLUGIN_ABI_VERSION,
+    .size = sizeof(plugin_descriptor_t),
+    .name = "ROTATOR",
+    .transform = {
+        .process = rotator_transform,
+        .process_batch = NULL,
+        .flags = MESSAGE_TRANSFORM_PURE | MESSAGE_TRANSFORM_IN_PLACE |
+                 MESSAGE_TRANSFORM_LENGTH_PRESERVING | MESSAGE_TRANSFORM_THREAD_SAFE,
+    },
+    .create = rotator_create,
+    .destroy = common_plugin_destroy,
+    .place_work = common_plugin_place_work,
+    .attach = common_plugin_attach,
+    .get_message_sink = common_plugin_get_message_sink,
+    .wait_finished = common_plugin_wait_finished,
+    .get_stats = common_plugin_get_stats,
+};
+
+/**
+ * Describe the plugin for the v2 ABI: per-instance entry points and the
+ * transform's capabilities
+ * @return Pointer to the static descriptor
+ */
+__attribute__((visibility("default")))
+const plugin_descriptor_t* plugin_get_descriptor(void) {
+    return &rotator_descriptor;
+}
+
 /**
  * Return the plugin's display name.
  * Used for identification and debugging.
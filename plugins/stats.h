@@ -0,0 +1,151 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * Runtime statistics shared by the host, the plugins and the queues.
+ * Counters have a single writer (the thread running the stage, or the
+ * queue endpoint that owns them), which updates them with plain relaxed
+ * load/store pairs: no locked instructions and no cache line shared with
+ * another writer. Readers may sample them at any time.
+ */
+
+// Processing-time histogram: bucket b counts items that took [2^b, 2^(b+1)) ns
+#define STATS_HIST_BUCKETS 32
+
+/* Snapshot of one queue */
+typedef struct queue_stats {
+    uint64_t capacity;
+    uint64_t depth;              /* items queued when sampled */
+    uint64_t high_water;         /* deepest the queue has been */
+    uint64_t puts;               /* items in */
+    uint64_t gets;               /* items out */
+    uint64_t put_wait_ns;        /* producers blocked on a full queue */
+    uint64_t get_wait_ns;        /* consumers blocked on an empty queue */
+    uint64_t dropped;            /* items shed by the overflow policy */
+    uint64_t spilled;            /* items that overflowed to disk (counted in puts/gets too) */
+} queue_stats_t;
+
+/* Snapshot of a result cache */
+typedef struct cache_stats {
+    uint64_t capacity;           /* entries it can hold */
+    uint64_t entries;            /* entries held when sampled */
+    uint64_t hits;
+    uint64_t misses;             /* lines looked up and not found (longer ones are not looked up) */
+    uint64_t evictions;          /* entries dropped to make room */
+} cache_stats_t;
+
+/* Snapshot of one stage (summed over its threads) */
+typedef struct stage_stats {
+    uint64_t items;              /* data messages processed (<END> excluded) */
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t batches;
+    uint64_t busy_ns;            /* wall time inside the transform */
+    uint64_t cpu_ns;             /* CPU time of the stage's own threads */
+    uint64_t hist[STATS_HIST_BUCKETS];
+    int threads;                 /* threads of its own (0 when run inline elsewhere) */
+    int has_queue;
+    queue_stats_t queue;
+} stage_stats_t;
+
+/* Live counters of one stage thread */
+typedef struct stage_counters {
+    _Atomic uint64_t items;
+    _Atomic uint64_t bytes_in;
+    _Atomic uint64_t bytes_out;
+    _Atomic uint64_t batches;
+    _Atomic uint64_t busy_ns;
+    _Atomic uint64_t hist[STATS_HIST_BUCKETS];
+    _Atomic uint64_t cpu_ns;     /* final CPU time, stored by the thread as it exits */
+    atomic_int running;          /* the thread is alive: read its clock instead */
+    pthread_t thread;
+} stage_counters_t;
+
+static inline uint64_t stats_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* Add to a counter that only the calling thread writes */
+static inline void stats_add(_Atomic uint64_t* counter, uint64_t value) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value,
+                          memory_order_relaxed);
+}
+
+/* Raise a single-writer maximum */
+static inline void stats_max(_Atomic uint64_t* counter, uint64_t value) {
+    if (value > atomic_load_explicit(counter, memory_order_relaxed)) {
+        atomic_store_explicit(counter, value, memory_order_relaxed);
+    }
+}
+
+static inline int stats_hist_bucket(uint64_t ns) {
+    int bucket = 63 - __builtin_clzll(ns | 1);
+    return bucket < STATS_HIST_BUCKETS ? bucket : STATS_HIST_BUCKETS - 1;
+}
+
+/* The calling thread starts running a stage */
+static inline void stage_counters_begin(stage_counters_t* c) {
+    c->thread = pthread_self();
+    atomic_store(&c->running, 1);
+}
+
+/* The calling thread is about to exit: keep its CPU time */
+static inline void stage_counters_end(stage_counters_t* c) {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+        atomic_store(&c->cpu_ns, (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec);
+    }
+    atomic_store(&c->running, 0);
+}
+
+/**
+ * Account one processed batch
+ * @param c Counters of the calling thread
+ * @param items Messages in the batch
+ * @param bytes_in Payload bytes before the transform
+ * @param bytes_out Payload bytes after it
+ * @param ns Time spent in the transform
+ */
+static inline void stage_counters_record(stage_counters_t* c, uint64_t items, uint64_t bytes_in,
+                                         uint64_t bytes_out, uint64_t ns) {
+    stats_add(&c->items, items);
+    stats_add(&c->bytes_in, bytes_in);
+    stats_add(&c->bytes_out, bytes_out);
+    stats_add(&c->batches, 1);
+    stats_add(&c->busy_ns, ns);
+    stats_add(&c->hist[stats_hist_bucket(items ? ns / items : ns)], items);
+}
+
+/**
+ * Add a thread's counters to a snapshot. Must not race with the thread
+ * being joined.
+ * @param c Counters
+ * @param s Snapshot to add to
+ */
+static inline void stage_counters_read(stage_counters_t* c, stage_stats_t* s) {
+    s->items += atomic_load_explicit(&c->items, memory_order_relaxed);
+    s->bytes_in += atomic_load_explicit(&c->bytes_in, memory_order_relaxed);
+    s->bytes_out += atomic_load_explicit(&c->bytes_out, memory_order_relaxed);
+    s->batches += atomic_load_explicit(&c->batches, memory_order_relaxed);
+    s->busy_ns += atomic_load_explicit(&c->busy_ns, memory_order_relaxed);
+    for (int b = 0; b < STATS_HIST_BUCKETS; b++) {
+        s->hist[b] += atomic_load_explicit(&c->hist[b], memory_order_relaxed);
+    }
+    clockid_t clock;
+    struct timespec ts;
+    if (atomic_load(&c->running) && pthread_getcpuclockid(c->thread, &clock) == 0 &&
+        clock_gettime(clock, &ts) == 0) {
+        s->cpu_ns += (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+    } else {
+        s->cpu_ns += atomic_load(&c->cpu_ns);
+    }
+}
+
+#endif /* STATS_H */
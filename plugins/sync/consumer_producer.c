@@ -1,24 +1,122 @@
+#define _POSIX_C_SOURCE 200809L
 #include "consumer_producer.h"
 #include "monitor.h"
 #include <stdlib.h>
+#include <string.h>
+
+static size_t ring_size_for(int capacity) {
+    size_t size = 1;
+    while (size < (size_t)capacity) size <<= 1;
+    return size;
+}
+
+
+int consumer_producer_backend_parse(const char* name, consumer_producer_backend_t* backend) {
+    if (name == NULL || backend == NULL) return -1;
+    if (strcmp(name, "locked") == 0) {
+        *backend = CP_BACKEND_LOCKED;
+        return 0;
+    }
+    if (strcmp(name, "spsc") == 0) {
+        *backend = CP_BACKEND_SPSC;
+        return 0;
+    }
+    return -1;
+}
+
+
+int consumer_producer_policy_parse(const char* text, consumer_producer_policy_t* policy) {
+    if (text == NULL || policy == NULL) return -1;
+    policy->timeout_ms = 0;
+    policy->sample_every = CP_SAMPLE_DEFAULT;
+    policy->spill_dir = NULL;
+    char* end = NULL;
+    if (strcmp(text, "block") == 0) {
+        policy->overflow = CP_POLICY_BLOCK;
+    } else if (strcmp(text, "drop-newest") == 0) {
+        policy->overflow = CP_POLICY_DROP_NEWEST;
+    } else if (strcmp(text, "drop-oldest") == 0) {
+        policy->overflow = CP_POLICY_DROP_OLDEST;
+    } else if (strcmp(text, "sample") == 0) {
+        policy->overflow = CP_POLICY_SAMPLE;
+    } else if (strncmp(text, "sample:", 7) == 0) {
+        long every = strtol(text + 7, &end, 10);
+        if (end == text + 7 || *end != '\0' || every < 1 || every > 1000000) return -1;
+        policy->overflow = CP_POLICY_SAMPLE;
+        policy->sample_every = (unsigned)every;
+    } else if (strcmp(text, "spill") == 0) {
+        policy->overflow = CP_POLICY_SPILL;
+    } else if (strncmp(text, "spill:", 6) == 0 && text[6] != '\0') {
+        policy->overflow = CP_POLICY_SPILL;
+        policy->spill_dir = text + 6;
+    } else if (strncmp(text, "timeout:", 8) == 0) {
+        long ms = strtol(text + 8, &end, 10);
+        if (end == text + 8 || *end != '\0' || ms < 0 || ms > 3600000) return -1;
+        policy->overflow = CP_POLICY_TIMEOUT;
+        policy->timeout_ms = (unsigned)ms;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+
+consumer_producer_backend_t consumer_producer_backend_from_env(void) {
+    consumer_producer_backend_t backend = CP_BACKEND_LOCKED;
+    const char* name = getenv(CP_BACKEND_ENV);
+    if (name != NULL && consumer_producer_backend_parse(name, &backend) != 0) {
+        backend = CP_BACKEND_LOCKED;
+    }
+    return backend;
+}
 
 
 const char* consumer_producer_init(consumer_producer_t* queue, int capacity) {
+    return consumer_producer_init_backend(queue, capacity, CP_BACKEND_LOCKED);
+}
+
+
+const char* consumer_producer_init_backend(consumer_producer_t* queue, int capacity,
+                                           consumer_producer_backend_t backend) {
     if (capacity <= 0) return "Capacity must be > 0";
 
-    queue->items = malloc(capacity * sizeof(char*));
+    size_t slots = (backend == CP_BACKEND_SPSC) ? ring_size_for(capacity) : (size_t)capacity;
+    queue->items = malloc(slots * sizeof(void*));
     if (!queue->items) return "Out of memory";
+    queue->backend = backend;
+    queue->spin = eventcount_spin_limit();
     queue->capacity = capacity;
-    queue->count = 0;
+    atomic_init(&queue->count, 0);
     queue->head = 0;
     queue->tail = 0;
-    queue->is_finished = 0;
+    atomic_init(&queue->is_finished, 0);
+
+    queue->ring_mask = slots - 1;
+    atomic_init(&queue->ring_tail, 0);
+    atomic_init(&queue->ring_head, 0);
+    queue->head_cache = 0;
+    queue->tail_cache = 0;
+    atomic_init(&queue->puts, 0);
+    atomic_init(&queue->put_wait_ns, 0);
+    atomic_init(&queue->high_water, 0);
+    atomic_init(&queue->dropped, 0);
+    queue->sample_tick = 0;
+    atomic_init(&queue->spilled, 0);
+    queue->policy = (consumer_producer_policy_t){ CP_POLICY_BLOCK, 0, CP_SAMPLE_DEFAULT, NULL };
+    queue->droppable = NULL;
+    queue->release = NULL;
+    queue->release_context = NULL;
+    queue->spill = NULL;
+    atomic_init(&queue->gets, 0);
+    atomic_init(&queue->get_wait_ns, 0);
+    eventcount_init(&queue->not_full);
+    eventcount_init(&queue->not_empty);
 
     if (pthread_mutex_init(&queue->lock, NULL) != 0) {
         free(queue->items);
         return "Mutex init failed";
     }
-    if (monitor_init(&queue->not_full) != 0 || monitor_init(&queue->not_empty) != 0 || monitor_init(&queue->finished) != 0) {
+    if (monitor_init(&queue->finished) != 0) {
         pthread_mutex_destroy(&queue->lock);
         free(queue->items);
         return "Monitor init failed";
@@ -27,84 +125,679 @@ const char* consumer_producer_init(consumer_producer_t* queue, int capacity) {
 }
 
 
+void consumer_producer_set_policy(consumer_producer_t* queue, const consumer_producer_policy_t* policy,
+                                  int (*droppable)(void* item), void (*release)(void* context, void* item),
+                                  void* context) {
+    queue->policy = *policy;
+    if (queue->policy.sample_every == 0) queue->policy.sample_every = 1;
+    queue->droppable = droppable;
+    queue->release = release;
+    queue->release_context = context;
+    if (policy->overflow == CP_POLICY_DROP_OLDEST && queue->backend == CP_BACKEND_SPSC) {
+        /* No item has been put yet, and the SPSC ring has at least capacity slots */
+        queue->backend = CP_BACKEND_LOCKED;
+    }
+}
+
+
+const char* consumer_producer_set_spill(consumer_producer_t* queue, const char* dir,
+                                        const consumer_producer_spill_ops_t* ops) {
+    spill_t* spill = malloc(sizeof *spill);
+    if (!spill) return "Out of memory";
+    const char* err = spill_init(spill, dir, 0);
+    if (err != NULL) {
+        free(spill);
+        return err;
+    }
+    queue->spill = spill;
+    queue->spill_ops = *ops;
+    queue->policy.overflow = CP_POLICY_SPILL;
+    queue->policy.spill_dir = NULL;
+    return NULL;
+}
+
+
 void consumer_producer_destroy(consumer_producer_t* queue){
     if (queue == NULL) return;
 
+    if (queue->spill) {
+        spill_destroy(queue->spill);
+        free(queue->spill);
+        queue->spill = NULL;
+    }
+
     pthread_mutex_destroy(&queue->lock);
-    monitor_destroy(&queue->not_full);
-    monitor_destroy(&queue->not_empty);
     monitor_destroy(&queue->finished);
 
     free(queue->items);
     queue->items = NULL;
 
     queue->capacity = 0;
-    queue->count = 0;
+    atomic_store(&queue->count, 0);
     queue->head = 0;
     queue->tail = 0;
-    queue->is_finished = 0;
+    atomic_store(&queue->is_finished, 0);
 }
 
 
-const char* consumer_producer_put(consumer_producer_t* queue, const char* item) {
-    pthread_mutex_lock(&queue->lock);
-    if (queue->is_finished == 1){
-        pthread_mutex_unlock(&queue->lock);
-        return "Queue is closed";
+/*
+* SPSC backend.
+* The producer owns ring_tail and the consumer owns ring_head; each publishes
+* its index with a release store and reads the other side's with an acquire
+* load only when its cached copy says the ring is full/empty. A blocked side
+* polls queue->spin times, then registers on the eventcount, re-checks the
+* ring and parks; the other side's notify is a fence plus a load unless
+* someone is registered.
+*/
+
+/* Block until the ring has room; returns free slots, or 0 if the queue closed */
+static size_t spsc_wait_space(consumer_producer_t* queue, size_t tail) {
+    size_t capacity = (size_t)queue->capacity;
+
+    if (tail - queue->head_cache >= capacity) {
+        int spins = 0;
+        uint64_t start = 0;
+        for (;;) {
+            if (atomic_load_explicit(&queue->is_finished, memory_order_acquire)) {
+                return 0;
+            }
+            queue->head_cache = atomic_load_explicit(&queue->ring_head, memory_order_acquire);
+            if (tail - queue->head_cache < capacity) break;
+            if (start == 0) start = stats_now_ns();
+            if (spins < queue->spin) {
+                spins++;
+                eventcount_relax();
+                continue;
+            }
+            unsigned key = eventcount_prepare_wait(&queue->not_full);
+            queue->head_cache = atomic_load_explicit(&queue->ring_head, memory_order_acquire);
+            if (tail - queue->head_cache < capacity || atomic_load(&queue->is_finished)) {
+                eventcount_cancel_wait(&queue->not_full);
+                continue;
+            }
+            eventcount_wait(&queue->not_full, key);
+        }
+        if (start != 0) stats_add(&queue->put_wait_ns, stats_now_ns() - start);
+    } else if (atomic_load_explicit(&queue->is_finished, memory_order_relaxed)) {
+        return 0;
     }
-    while (queue->count == queue->capacity) {
-        pthread_mutex_unlock(&queue->lock);
-        monitor_wait(&queue->not_full);
-        pthread_mutex_lock(&queue->lock);
+    return capacity - (tail - queue->head_cache);
+}
+
+/* Publish n items at tail (there is room for them); returns the new tail */
+static size_t spsc_insert(consumer_producer_t* queue, size_t tail, void* const* items, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        queue->items[(tail + i) & queue->ring_mask] = items[i];
+    }
+    tail += n;
+    atomic_store_explicit(&queue->ring_tail, tail, memory_order_release);
+    eventcount_notify(&queue->not_empty);
+    stats_add(&queue->puts, n);
+    stats_max(&queue->high_water, tail - atomic_load_explicit(&queue->ring_head, memory_order_relaxed));
+    return tail;
+}
+
+static const char* spsc_put_batch(consumer_producer_t* queue, void* const* items, int count, int* queued) {
+    size_t tail = atomic_load_explicit(&queue->ring_tail, memory_order_relaxed);
+    size_t done = 0;
+
+    while (done < (size_t)count) {
+        size_t space = spsc_wait_space(queue, tail);
+        if (space == 0) {
+            *queued = (int)done;
+            return "Queue is closed";
+        }
+        size_t n = (size_t)count - done;
+        if (n > space) n = space;
+        tail = spsc_insert(queue, tail, items + done, n);
+        done += n;
+    }
+    *queued = count;
+    return NULL;
+}
+
+/* Take up to max of the items between head and tail_cache (there is at least one) */
+static int spsc_take(consumer_producer_t* queue, size_t head, void** out, int max) {
+    size_t n = queue->tail_cache - head;
+    if (n > (size_t)max) n = (size_t)max;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = queue->items[(head + i) & queue->ring_mask];
+    }
+    head += n;
+    atomic_store_explicit(&queue->ring_head, head, memory_order_release);
+    eventcount_notify(&queue->not_full);
+    stats_add(&queue->gets, n);
+
+    if (head == queue->tail_cache && atomic_load(&queue->is_finished) &&
+        atomic_load(&queue->ring_tail) == head) {
+        monitor_signal(&queue->finished);
+    }
+    return (int)n;
+}
+
+static int spsc_get_batch(consumer_producer_t* queue, void** out, int max) {
+    size_t head = atomic_load_explicit(&queue->ring_head, memory_order_relaxed);
+
+    if (head == queue->tail_cache) {
+        int spins = 0;
+        uint64_t start = 0;
+        for (;;) {
+            queue->tail_cache = atomic_load_explicit(&queue->ring_tail, memory_order_acquire);
+            if (head != queue->tail_cache) break;
+            if (atomic_load_explicit(&queue->is_finished, memory_order_acquire)) {
+                /* Re-read: a put may have landed just before the close */
+                queue->tail_cache = atomic_load_explicit(&queue->ring_tail, memory_order_acquire);
+                if (head != queue->tail_cache) break;
+                if (start != 0) stats_add(&queue->get_wait_ns, stats_now_ns() - start);
+                return 0;
+            }
+            if (start == 0) start = stats_now_ns();
+            if (spins < queue->spin) {
+                spins++;
+                eventcount_relax();
+                continue;
+            }
+            unsigned key = eventcount_prepare_wait(&queue->not_empty);
+            queue->tail_cache = atomic_load_explicit(&queue->ring_tail, memory_order_acquire);
+            if (head != queue->tail_cache || atomic_load(&queue->is_finished)) {
+                eventcount_cancel_wait(&queue->not_empty);
+                continue;
+            }
+            eventcount_wait(&queue->not_empty, key);
+        }
+        if (start != 0) stats_add(&queue->get_wait_ns, stats_now_ns() - start);
+    }
+    return spsc_take(queue, head, out, max);
+}
+
+
+/*
+* Locked backend.
+* count is only modified under queue->lock; blocked threads may peek at it
+* while spinning so they can skip the lock until progress is possible.
+* Waiters register on the eventcount while still holding the lock, so the
+* notify issued after the next put/get always sees them.
+*/
+
+static void locked_spin(consumer_producer_t* queue, int full) {
+    for (int spins = 0; spins < queue->spin; spins++) {
+        int count = atomic_load_explicit(&queue->count, memory_order_relaxed);
+        if ((full ? count < queue->capacity : count > 0) ||
+            atomic_load_explicit(&queue->is_finished, memory_order_relaxed)) {
+            return;
+        }
+        eventcount_relax();
+    }
+}
+
+/* Append n items (there is room for them) and release the lock */
+static void locked_insert(consumer_producer_t* queue, void* const* items, int n) {
+    int was_empty = queue->count == 0;
+    for (int i = 0; i < n; i++) {
+        queue->items[queue->tail] = items[i];
+        queue->tail = (queue->tail + 1) % queue->capacity;
     }
-    queue->items[queue->tail] = (char*)item;
-    queue->tail = (queue->tail + 1) % queue->capacity;
-    queue->count++;
+    atomic_store_explicit(&queue->count, queue->count + n, memory_order_relaxed);
+    stats_add(&queue->puts, (uint64_t)n);
+    stats_max(&queue->high_water, (uint64_t)queue->count);
 
-    monitor_signal(&queue->not_empty);
     pthread_mutex_unlock(&queue->lock);
+    /*
+     * Consumers only park on an empty queue, so only the put that ends
+     * the empty spell has anyone to wake. Wake one: a consumer that
+     * leaves items behind passes the wakeup on (see locked_get_batch).
+     */
+    if (was_empty) {
+        eventcount_notify_one(&queue->not_empty);
+    }
+}
+
+static const char* locked_put_batch(consumer_producer_t* queue, void* const* items, int count, int* queued) {
+    int done = 0;
+
+    while (done < count) {
+        pthread_mutex_lock(&queue->lock);
+        int spun = 0;
+        uint64_t start = 0;
+        for (;;) {
+            if (queue->is_finished == 1){
+                pthread_mutex_unlock(&queue->lock);
+                *queued = done;
+                return "Queue is closed";
+            }
+            if (queue->count < queue->capacity) break;
+            if (start == 0) start = stats_now_ns();
+            if (!spun) {
+                pthread_mutex_unlock(&queue->lock);
+                locked_spin(queue, 1);
+                spun = 1;
+                pthread_mutex_lock(&queue->lock);
+                continue;
+            }
+            unsigned key = eventcount_prepare_wait(&queue->not_full);
+            pthread_mutex_unlock(&queue->lock);
+            eventcount_wait(&queue->not_full, key);
+            pthread_mutex_lock(&queue->lock);
+        }
+        int n = queue->capacity - queue->count;
+        if (n > count - done) n = count - done;
+        if (start != 0) stats_add(&queue->put_wait_ns, stats_now_ns() - start);
+        locked_insert(queue, items + done, n);
+        done += n;
+    }
+    *queued = count;
     return NULL;
-    
 }
 
+/* Take up to max items (there is at least one) and release the lock */
+static int locked_take(consumer_producer_t* queue, void** out, int max) {
+    int n = queue->count < max ? queue->count : max;
+    for (int i = 0; i < n; i++) {
+        out[i] = queue->items[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+    }
+    atomic_store_explicit(&queue->count, queue->count - n, memory_order_relaxed);
+    stats_add(&queue->gets, (uint64_t)n);
 
-char* consumer_producer_get(consumer_producer_t* queue)  {
-    pthread_mutex_lock(&queue->lock);
+    if (queue->count == 0 && queue->is_finished){
+        monitor_signal(&queue->finished);
+    }
+    int left = queue->count;
+
+    pthread_mutex_unlock(&queue->lock);
+    eventcount_notify(&queue->not_full);
+    if (left > 0) {
+        /* More than one batch queued: pass the wakeup on to another consumer */
+        eventcount_notify_one(&queue->not_empty);
+    }
+    return n;
+}
 
+static int locked_get_batch(consumer_producer_t* queue, void** out, int max) {
+    pthread_mutex_lock(&queue->lock);
+    int spun = 0;
+    uint64_t start = 0;
     while (queue->count == 0) {
         if (queue->is_finished){
+            if (start != 0) stats_add(&queue->get_wait_ns, stats_now_ns() - start);
+            pthread_mutex_unlock(&queue->lock);
+            return 0;
+        }
+        if (start == 0) start = stats_now_ns();
+        if (!spun) {
             pthread_mutex_unlock(&queue->lock);
-            return NULL;
+            locked_spin(queue, 0);
+            spun = 1;
+            pthread_mutex_lock(&queue->lock);
+            continue;
         }
+        unsigned key = eventcount_prepare_wait(&queue->not_empty);
         pthread_mutex_unlock(&queue->lock);
-        monitor_wait(&queue->not_empty);
+        eventcount_wait(&queue->not_empty, key);
         pthread_mutex_lock(&queue->lock);
     }
+    if (start != 0) stats_add(&queue->get_wait_ns, stats_now_ns() - start);
+    return locked_take(queue, out, max);
+}
 
-    char* item = queue->items[queue->head];
-    queue->head = (queue->head + 1) % queue->capacity;
-    queue->count--;
 
-    monitor_signal(&queue->not_full);
+/*
+* Overflow policies.
+* Items go in with non-blocking puts; an item that finds the queue full is
+* then dropped, waited for or makes room according to the policy. Items
+* the droppable callback rejects wait like under CP_POLICY_BLOCK.
+*/
 
-    if (queue->count == 0 && queue->is_finished){
-        monitor_signal(&queue->finished);
+/* Items queued right now (the producer's view) */
+static int queue_depth(consumer_producer_t* queue) {
+    if (queue->backend == CP_BACKEND_SPSC) {
+        return (int)(atomic_load_explicit(&queue->ring_tail, memory_order_relaxed) -
+                     atomic_load_explicit(&queue->ring_head, memory_order_acquire));
+    }
+    return atomic_load_explicit(&queue->count, memory_order_relaxed);
+}
+
+/* Queue as many of the items as fit without waiting; -1 once closed */
+static int try_put(consumer_producer_t* queue, void* const* items, int count) {
+    if (queue->backend == CP_BACKEND_SPSC) {
+        if (atomic_load_explicit(&queue->is_finished, memory_order_acquire)) return -1;
+        size_t tail = atomic_load_explicit(&queue->ring_tail, memory_order_relaxed);
+        queue->head_cache = atomic_load_explicit(&queue->ring_head, memory_order_acquire);
+        size_t space = (size_t)queue->capacity - (tail - queue->head_cache);
+        int n = space < (size_t)count ? (int)space : count;
+        if (n > 0) spsc_insert(queue, tail, items, (size_t)n);
+        return n;
+    }
+    pthread_mutex_lock(&queue->lock);
+    if (queue->is_finished) {
+        pthread_mutex_unlock(&queue->lock);
+        return -1;
+    }
+    int n = queue->capacity - queue->count;
+    if (n > count) n = count;
+    if (n <= 0) {
+        pthread_mutex_unlock(&queue->lock);
+        return 0;
+    }
+    locked_insert(queue, items, n);
+    return n;
+}
+
+static void drop_item(consumer_producer_t* queue, void* item) {
+    queue->release(queue->release_context, item);
+    atomic_fetch_add_explicit(&queue->dropped, 1, memory_order_relaxed);
+}
+
+/* Evict the oldest item if the queue is still full and it may be dropped */
+static int evict_oldest(consumer_producer_t* queue) {
+    void* victim = NULL;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count == queue->capacity && queue->droppable(queue->items[queue->head])) {
+        victim = queue->items[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        atomic_store_explicit(&queue->count, queue->count - 1, memory_order_relaxed);
+        stats_add(&queue->gets, 1);     /* it left the queue, so depth stays puts - gets */
+    }
+    pthread_mutex_unlock(&queue->lock);
+    if (victim == NULL) return 0;
+    drop_item(queue, victim);
+    return 1;
+}
+
+/* Wait for room until deadline: 1 room, 0 timed out, -1 closed */
+static int wait_room(consumer_producer_t* queue, uint64_t deadline) {
+    uint64_t start = stats_now_ns();
+    int result = 0;
+    for (;;) {
+        if (atomic_load(&queue->is_finished)) { result = -1; break; }
+        if (queue_depth(queue) < queue->capacity) { result = 1; break; }
+        uint64_t now = stats_now_ns();
+        if (now >= deadline) break;
+        unsigned key = eventcount_prepare_wait(&queue->not_full);
+        if (atomic_load(&queue->is_finished) || queue_depth(queue) < queue->capacity) {
+            eventcount_cancel_wait(&queue->not_full);
+            continue;
+        }
+        eventcount_wait_timeout(&queue->not_full, key, deadline - now);
+    }
+    atomic_fetch_add_explicit(&queue->put_wait_ns, stats_now_ns() - start, memory_order_relaxed);
+    return result;
+}
+
+static const char* policy_put_batch(consumer_producer_t* queue, void* const* items, int count, int* queued) {
+    const consumer_producer_policy_t* policy = &queue->policy;
+    uint64_t deadline = 0;          /* when items[deadline_for] gives up waiting */
+    int deadline_for = -1;
+    int done = 0;
+    while (done < count) {
+        void* item = items[done];
+        int droppable = queue->droppable(item);
+        int limit = count - done;
+        if (policy->overflow == CP_POLICY_SAMPLE) {
+            int calm = (queue->capacity + 1) / 2 - queue_depth(queue);
+            if (calm > 0) {
+                if (limit > calm) limit = calm;
+            } else {
+                // Under pressure: one item in sample_every gets a chance at the queue
+                limit = 1;
+                if (droppable && queue->sample_tick++ % policy->sample_every != 0) {
+                    drop_item(queue, item);
+                    done++;
+                    continue;
+                }
+            }
+        }
+        int n = try_put(queue, items + done, limit);
+        if (n < 0) {
+            *queued = done;
+            return "Queue is closed";
+        }
+        if (n > 0) {
+            done += n;
+            continue;
+        }
+
+        // Full
+        if (!droppable) {
+            int taken = 0;
+            const char* err = queue->backend == CP_BACKEND_SPSC ? spsc_put_batch(queue, &item, 1, &taken)
+                                                                : locked_put_batch(queue, &item, 1, &taken);
+            if (err != NULL) {
+                *queued = done;
+                return err;
+            }
+            done++;
+            continue;
+        }
+        if (policy->overflow == CP_POLICY_DROP_OLDEST && evict_oldest(queue)) {
+            continue;
+        }
+        if (policy->overflow == CP_POLICY_TIMEOUT) {
+            // Every item that finds the queue full gets the whole timeout
+            if (deadline_for != done) {
+                deadline = stats_now_ns() + (uint64_t)policy->timeout_ms * 1000000u;
+                deadline_for = done;
+            }
+            int room = wait_room(queue, deadline);
+            if (room < 0) {
+                *queued = done;
+                return "Queue is closed";
+            }
+            if (room > 0) {
+                continue;
+            }
+        }
+        drop_item(queue, item);
+        done++;
     }
+    *queued = count;
+    return NULL;
+}
+
 
+/*
+* Spilling.
+* Items stay in the ring while it has room and nothing is spilled. Once
+* an item finds the ring full it goes to the spill, and so does every
+* item after it until the spill is empty again, so the ring only ever
+* holds items older than the spilled ones. A consumer therefore looks at
+* the spill count first: if something is spilled, the ring can only shrink
+* meanwhile, and once it is empty the oldest item is the spill's first.
+*/
+
+typedef struct {
+    consumer_producer_t* queue;
+    void* const* items;
+    void** out;
+} spill_batch_t;
+
+static size_t spill_item_size(void* context, int i) {
+    spill_batch_t* batch = context;
+    return batch->queue->spill_ops.size(batch->items[i]);
+}
+
+static void spill_item_save(void* context, int i, void* dst) {
+    spill_batch_t* batch = context;
+    batch->queue->spill_ops.save(batch->items[i], dst);
+}
+
+static int spill_item_load(void* context, const void* record, size_t size) {
+    spill_batch_t* batch = context;
+    void* item = batch->queue->spill_ops.load(record, size);
+    if (item == NULL) return -1;
+    *batch->out++ = item;
+    return 0;
+}
+
+/*
+ * Count spill traffic. On the locked backend other producers and consumers
+ * count the ring's traffic in the same counters under the lock, so the
+ * spill path takes it too; the SPSC ring has one writer per counter.
+ */
+static void spill_count(consumer_producer_t* queue, _Atomic uint64_t* counter, uint64_t n) {
+    if (queue->backend == CP_BACKEND_SPSC) {
+        stats_add(counter, n);
+        return;
+    }
+    pthread_mutex_lock(&queue->lock);
+    stats_add(counter, n);
     pthread_mutex_unlock(&queue->lock);
+}
+
+static const char* spill_put_batch(consumer_producer_t* queue, void* const* items, int count, int* queued) {
+    int done = 0;
+    if (spill_pending(queue->spill) == 0) {
+        done = try_put(queue, items, count);
+        if (done < 0) {
+            *queued = 0;
+            return "Queue is closed";
+        }
+    }
+    if (done == count) {
+        *queued = count;
+        return NULL;
+    }
+    if (atomic_load(&queue->is_finished)) {
+        *queued = done;
+        return "Queue is closed";
+    }
+    spill_batch_t batch = { queue, items + done, NULL };
+    int n = spill_write(queue->spill, count - done, spill_item_size, spill_item_save, &batch);
+    for (int i = 0; i < n; i++) {
+        queue->spill_ops.release(items[done + i]);
+    }
+    spill_count(queue, &queue->spilled, (uint64_t)n);
+    spill_count(queue, &queue->puts, (uint64_t)n);
+    eventcount_notify(&queue->not_empty);
+    done += n;
+    *queued = done;
+    return done == count ? NULL : "Cannot extend the spill";
+}
+
+/* Take whatever is in the ring without waiting */
+static int try_get(consumer_producer_t* queue, void** out, int max) {
+    if (queue->backend == CP_BACKEND_SPSC) {
+        size_t head = atomic_load_explicit(&queue->ring_head, memory_order_relaxed);
+        queue->tail_cache = atomic_load_explicit(&queue->ring_tail, memory_order_acquire);
+        return head == queue->tail_cache ? 0 : spsc_take(queue, head, out, max);
+    }
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count == 0) {
+        pthread_mutex_unlock(&queue->lock);
+        return 0;
+    }
+    return locked_take(queue, out, max);
+}
+
+static int spill_get_batch(consumer_producer_t* queue, void** out, int max) {
+    uint64_t start = 0;
+    int n;
+    for (;;) {
+        int spilled = spill_pending(queue->spill) > 0;
+        n = try_get(queue, out, max);
+        if (n > 0) break;
+        if (spilled) {
+            spill_batch_t batch = { queue, NULL, out };
+            n = spill_read(queue->spill, max, spill_item_load, &batch);
+            spill_count(queue, &queue->gets, (uint64_t)n);
+            if (n > 0) break;
+            continue;
+        }
+        if (atomic_load(&queue->is_finished)) {
+            /* Re-check: a put may have landed just before the close */
+            if (spill_pending(queue->spill) > 0 || queue_depth(queue) > 0) continue;
+            break;
+        }
+        if (start == 0) start = stats_now_ns();
+        unsigned key = eventcount_prepare_wait(&queue->not_empty);
+        if (queue_depth(queue) > 0 || spill_pending(queue->spill) > 0 || atomic_load(&queue->is_finished)) {
+            eventcount_cancel_wait(&queue->not_empty);
+            continue;
+        }
+        eventcount_wait(&queue->not_empty, key);
+    }
+    if (start != 0) spill_count(queue, &queue->get_wait_ns, stats_now_ns() - start);
+    return n;
+}
+
+
+const char* consumer_producer_put(consumer_producer_t* queue, void* item) {
+    return consumer_producer_put_batch(queue, &item, 1, NULL);
+}
+
+
+const char* consumer_producer_put_batch(consumer_producer_t* queue, void* const* items, int count,
+                                        int* queued) {
+    int taken = 0;
+    if (queued == NULL) queued = &taken;
+    *queued = 0;
+    if (count <= 0) return NULL;
+    if (queue->spill) {
+        return spill_put_batch(queue, items, count, queued);
+    }
+    if (queue->policy.overflow != CP_POLICY_BLOCK && queue->droppable && queue->release) {
+        return policy_put_batch(queue, items, count, queued);
+    }
+    if (queue->backend == CP_BACKEND_SPSC) {
+        return spsc_put_batch(queue, items, count, queued);
+    }
+    return locked_put_batch(queue, items, count, queued);
+}
+
+
+void* consumer_producer_get(consumer_producer_t* queue)  {
+    void* item = NULL;
+    if (consumer_producer_get_batch(queue, &item, 1) == 0) {
+        return NULL;
+    }
     return item;
 }
 
 
+int consumer_producer_get_batch(consumer_producer_t* queue, void** items, int max) {
+    if (max <= 0) return 0;
+    if (queue->spill) {
+        return spill_get_batch(queue, items, max);
+    }
+    if (queue->backend == CP_BACKEND_SPSC) {
+        return spsc_get_batch(queue, items, max);
+    }
+    return locked_get_batch(queue, items, max);
+}
+
+
+void consumer_producer_get_stats(consumer_producer_t* queue, queue_stats_t* stats) {
+    stats->capacity = (uint64_t)queue->capacity;
+    stats->puts = atomic_load_explicit(&queue->puts, memory_order_relaxed);
+    stats->gets = atomic_load_explicit(&queue->gets, memory_order_relaxed);
+    stats->depth = stats->puts > stats->gets ? stats->puts - stats->gets : 0;
+    stats->high_water = atomic_load_explicit(&queue->high_water, memory_order_relaxed);
+    stats->put_wait_ns = atomic_load_explicit(&queue->put_wait_ns, memory_order_relaxed);
+    stats->get_wait_ns = atomic_load_explicit(&queue->get_wait_ns, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&queue->dropped, memory_order_relaxed);
+    stats->spilled = atomic_load_explicit(&queue->spilled, memory_order_relaxed);
+}
+
+
 void consumer_producer_signal_finished(consumer_producer_t* queue) {
+    if (queue->backend == CP_BACKEND_SPSC) {
+        atomic_store(&queue->is_finished, 1);
+        eventcount_notify(&queue->not_empty);
+        eventcount_notify(&queue->not_full);
+        if (atomic_load(&queue->ring_head) == atomic_load(&queue->ring_tail)) {
+            monitor_signal(&queue->finished);
+        }
+        return;
+    }
+
     pthread_mutex_lock(&queue->lock);
-    queue->is_finished = 1; 
-    monitor_signal(&queue->not_empty);
-    monitor_signal(&queue->not_full);
+    queue->is_finished = 1;
     if (queue->count == 0) {
         monitor_signal(&queue->finished);
     }
     pthread_mutex_unlock(&queue->lock);
+    eventcount_notify(&queue->not_empty);
+    eventcount_notify(&queue->not_full);
 }
 
 
@@ -2,25 +2,114 @@
 #define CONSUMER_PRODUCER_H
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include "monitor.h"
+#include "eventcount.h"
+#include "spill.h"
+#include "../stats.h"
+
+#define CP_CACHE_LINE 64
+
+/* Environment variable consulted by consumer_producer_backend_from_env() */
+#define CP_BACKEND_ENV "ANALYZER_QUEUE_BACKEND"
+
+/*
+* Queue implementation selected at init time
+*/
+typedef enum {
+    CP_BACKEND_LOCKED = 0,  /* mutex + eventcounts, any number of producers/consumers */
+    CP_BACKEND_SPSC         /* lock-free ring, exactly one producer and one consumer */
+} consumer_producer_backend_t;
+
+/*
+* What a producer does with an item that finds the queue full.
+* Items the queue's droppable callback rejects (control messages) always
+* wait for room, whatever the policy.
+*/
+typedef enum {
+    CP_POLICY_BLOCK = 0,    /* wait for room (default) */
+    CP_POLICY_TIMEOUT,      /* wait up to timeout_ms per put, then drop */
+    CP_POLICY_DROP_NEWEST,  /* drop the item being put */
+    CP_POLICY_DROP_OLDEST,  /* drop the oldest queued item to make room (locked backend) */
+    CP_POLICY_SAMPLE,       /* from half full on keep one item in sample_every; drop when full */
+    CP_POLICY_SPILL         /* write overflow to disk segments and read it back in order */
+} consumer_producer_overflow_t;
+
+// Default for "sample" without a rate
+#define CP_SAMPLE_DEFAULT 4
+
+typedef struct {
+    consumer_producer_overflow_t overflow;
+    unsigned timeout_ms;            /* CP_POLICY_TIMEOUT */
+    unsigned sample_every;          /* CP_POLICY_SAMPLE */
+    const char* spill_dir;          /* CP_POLICY_SPILL; NULL = $TMPDIR or /tmp */
+} consumer_producer_policy_t;
+
+/*
+* How a spilling queue turns items into segment records and back
+*/
+typedef struct consumer_producer_spill_ops {
+    size_t (*size)(void* item);                       /* bytes of the item's record */
+    void (*save)(void* item, void* record);           /* write the record (size bytes) */
+    void* (*load)(const void* record, size_t size);   /* rebuild an item; NULL on failure */
+    void (*release)(void* item);                      /* free an item once it is saved */
+} consumer_producer_spill_ops_t;
 
 /*
 * Consumer-Producer queue structure for thread-safe producer-consumer pattern
-* Now using monitors for simpler implementation
+* Blocking uses eventcounts (spin, then park on a futex); the finished
+* monitor stays sticky because wait_finished may be called after the fact.
 */
 typedef struct {
-    char** items;
+    consumer_producer_backend_t backend;
+    int spin;                       /* polls before parking */
+    consumer_producer_policy_t policy;
+    int (*droppable)(void* item);   /* policy may drop this item */
+    void (*release)(void* context, void* item);  /* disposes of a dropped item */
+    void* release_context;
+    spill_t* spill;                 /* CP_POLICY_SPILL: overflow on disk, NULL otherwise */
+    consumer_producer_spill_ops_t spill_ops;
+
+    void** items;
     int capacity;
-    int count;
+    atomic_int count;               /* written under lock, peeked while spinning */
     int head;
     int tail;
 
-    monitor_t not_full;
-    monitor_t not_empty;
     monitor_t finished;
 
     pthread_mutex_t lock;
-    int is_finished;
+    atomic_int is_finished;
+
+    /*
+    * SPSC ring state. Indices grow monotonically and are masked into a
+    * power-of-two ring; each side keeps a cached copy of the other side's
+    * index so the fast path only touches its own cache line.
+    */
+    size_t ring_mask;
+
+    _Alignas(CP_CACHE_LINE) atomic_size_t ring_tail;   /* written by producer */
+    size_t head_cache;                                  /* producer's view of ring_head */
+
+    /*
+    * Statistics, kept next to the index of the side that writes them (the
+    * producer, or the consumer; under lock for the locked backend)
+    */
+    _Atomic uint64_t puts;
+    _Atomic uint64_t put_wait_ns;
+    _Atomic uint64_t high_water;
+    _Atomic uint64_t dropped;       /* items shed by the overflow policy */
+    _Atomic uint64_t spilled;       /* items that went through the spill */
+    unsigned sample_tick;
+
+    _Alignas(CP_CACHE_LINE) atomic_size_t ring_head;   /* written by consumer */
+    size_t tail_cache;                                  /* consumer's view of ring_tail */
+    _Atomic uint64_t gets;
+    _Atomic uint64_t get_wait_ns;
+
+    _Alignas(CP_CACHE_LINE) eventcount_t not_full;
+    _Alignas(CP_CACHE_LINE) eventcount_t not_empty;
 } consumer_producer_t;
 
 /*
@@ -31,6 +120,69 @@ typedef struct {
 */
 const char* consumer_producer_init(consumer_producer_t* queue, int capacity);
 
+/*
+* Initialize a consumer-producer queue with an explicit backend.
+* CP_BACKEND_SPSC is only valid when exactly one thread puts and exactly one
+* thread gets for the lifetime of the queue.
+* @param queue Pointer to queue structure
+* @param capacity Maximum number of items
+* @param backend Queue implementation to use
+* @return NULL on success, error message on failure
+*/
+const char* consumer_producer_init_backend(consumer_producer_t* queue, int capacity,
+                                           consumer_producer_backend_t backend);
+
+/*
+* Parse a backend name ("locked" or "spsc")
+* @param name Backend name
+* @param backend Output backend
+* @return 0 on success, -1 if the name is unknown
+*/
+int consumer_producer_backend_parse(const char* name, consumer_producer_backend_t* backend);
+
+/*
+* Backend requested through the CP_BACKEND_ENV environment variable.
+* Falls back to CP_BACKEND_LOCKED when unset or unknown.
+*/
+consumer_producer_backend_t consumer_producer_backend_from_env(void);
+
+/*
+* Parse an overflow policy: block, timeout:MS, drop-newest, drop-oldest,
+* sample, sample:N, spill or spill:DIR (spill_dir then points into text)
+* @param text Policy
+* @param policy Output policy
+* @return 0 on success, -1 if the text is not a policy
+*/
+int consumer_producer_policy_parse(const char* text, consumer_producer_policy_t* policy);
+
+/*
+* Set what happens to items that find the queue full. Call before the
+* first put. drop-oldest moves an SPSC queue to the locked backend, since
+* evicting takes the consumer's end of the ring.
+* @param queue Pointer to queue structure
+* @param policy Overflow policy
+* @param droppable Returns non-zero for items the policy may drop
+* @param release Disposes of a dropped item (called without the queue lock)
+* @param context First argument of release
+*/
+void consumer_producer_set_policy(consumer_producer_t* queue, const consumer_producer_policy_t* policy,
+                                  int (*droppable)(void* item), void (*release)(void* context, void* item),
+                                  void* context);
+
+/*
+* Make the queue spill (CP_POLICY_SPILL). Call before the first put.
+* Once the ring is full, items are written to memory-mapped segment files
+* under dir, and every later item follows them there until the consumer
+* has read the spill back, so the queue stays FIFO and producers never
+* wait. Its first segment is created now.
+* @param queue Pointer to queue structure
+* @param dir Directory for the segments (NULL: $TMPDIR, else /tmp)
+* @param ops Record conversion for the queue's items
+* @return NULL on success, error message on failure
+*/
+const char* consumer_producer_set_spill(consumer_producer_t* queue, const char* dir,
+                                        const consumer_producer_spill_ops_t* ops);
+
 /*
 * Destroy a consumer-producer queue and free its resources
 * @param queue Pointer to queue structure
@@ -39,20 +191,51 @@ void   consumer_producer_destroy(consumer_producer_t* queue);
 
 /*
 * Add an item to the queue (producer).
-* Blocks if queue is full.
+* Blocks if queue is full, unless the overflow policy drops the item.
 * @param queue Pointer to queue structure
-* @param item String to add (queue takes ownership)
+* @param item Item to add (queue takes ownership)
 * @return NULL on success, error message on failure
 */
-const char* consumer_producer_put(consumer_producer_t* queue, const char* item);
+const char* consumer_producer_put(consumer_producer_t* queue, void* item);
+
+/*
+* Add several items to the queue (producer).
+* Each acquisition moves as many items as currently fit; blocks until all
+* items are queued or dropped by the overflow policy.
+* @param queue Pointer to queue structure
+* @param items Items to add (queue takes ownership)
+* @param count Number of items
+* @param queued Optional; receives how many items were queued or dropped. On failure the
+*        items from that index on remain owned by the caller.
+* @return NULL on success, error message on failure
+*/
+const char* consumer_producer_put_batch(consumer_producer_t* queue, void* const* items, int count,
+                                        int* queued);
 
 /**
  * Remove an item from the queue (consumer) and returns it.
  * Blocks if queue is empty.
  * @param queue Pointer to queue structure
- * @return String item or NULL if queue is empty
+ * @return Item, or NULL once the queue is finished and empty
+ */
+void* consumer_producer_get(consumer_producer_t* queue);
+
+/**
+ * Remove up to max items from the queue (consumer) in one acquisition.
+ * Blocks until at least one item is available.
+ * @param queue Pointer to queue structure
+ * @param items Output array with room for max items
+ * @param max Maximum number of items to take
+ * @return Number of items taken, 0 if the queue is finished and empty
+ */
+int consumer_producer_get_batch(consumer_producer_t* queue, void** items, int max);
+
+/**
+ * Sample the queue's counters (any thread, any time before destroy)
+ * @param queue Pointer to queue structure
+ * @param stats Filled with the snapshot
  */
-char* consumer_producer_get(consumer_producer_t* queue);
+void consumer_producer_get_stats(consumer_producer_t* queue, queue_stats_t* stats);
 
 /**
  * Signal that processing is finished
@@ -0,0 +1,76 @@
+#define _GNU_SOURCE
+#include "eventcount.h"
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define EVENTCOUNT_DEFAULT_SPIN 256
+
+static long futex(atomic_uint* addr, int op, unsigned val) {
+    return syscall(SYS_futex, (uint32_t*)addr, op, val, NULL, NULL, 0);
+}
+
+void eventcount_init(eventcount_t* ec) {
+    atomic_init(&ec->seq, 0);
+    atomic_init(&ec->waiters, 0);
+}
+
+unsigned eventcount_prepare_wait(eventcount_t* ec) {
+    atomic_fetch_add(&ec->waiters, 1);
+    unsigned key = atomic_load(&ec->seq);
+    /* Order the registration before the caller's re-check of its condition */
+    atomic_thread_fence(memory_order_seq_cst);
+    return key;
+}
+
+void eventcount_cancel_wait(eventcount_t* ec) {
+    atomic_fetch_sub_explicit(&ec->waiters, 1, memory_order_relaxed);
+}
+
+void eventcount_wait(eventcount_t* ec, unsigned key) {
+    if (atomic_load_explicit(&ec->seq, memory_order_acquire) == key) {
+        futex(&ec->seq, FUTEX_WAIT_PRIVATE, key);
+    }
+    atomic_fetch_sub_explicit(&ec->waiters, 1, memory_order_relaxed);
+}
+
+void eventcount_wait_timeout(eventcount_t* ec, unsigned key, uint64_t timeout_ns) {
+    if (atomic_load_explicit(&ec->seq, memory_order_acquire) == key) {
+        struct timespec timeout = { (time_t)(timeout_ns / 1000000000u), (long)(timeout_ns % 1000000000u) };
+        syscall(SYS_futex, (uint32_t*)&ec->seq, FUTEX_WAIT_PRIVATE, key, &timeout, NULL, 0);
+    }
+    atomic_fetch_sub_explicit(&ec->waiters, 1, memory_order_relaxed);
+}
+
+void eventcount_notify(eventcount_t* ec) {
+    /* Order the caller's state change before the waiter check */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&ec->waiters, memory_order_relaxed) == 0) {
+        return;
+    }
+    atomic_fetch_add(&ec->seq, 1);
+    futex(&ec->seq, FUTEX_WAKE_PRIVATE, INT_MAX);
+}
+
+void eventcount_notify_one(eventcount_t* ec) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&ec->waiters, memory_order_relaxed) == 0) {
+        return;
+    }
+    atomic_fetch_add(&ec->seq, 1);
+    futex(&ec->seq, FUTEX_WAKE_PRIVATE, 1);
+}
+
+int eventcount_spin_limit(void) {
+    const char* value = getenv(EVENTCOUNT_SPIN_ENV);
+    if (value != NULL && *value != '\0') {
+        int spin = atoi(value);
+        return spin < 0 ? 0 : spin;
+    }
+    /* Spinning on one CPU only delays the thread we are waiting for */
+    return sysconf(_SC_NPROCESSORS_ONLN) > 1 ? EVENTCOUNT_DEFAULT_SPIN : 0;
+}
@@ -0,0 +1,92 @@
+#ifndef EVENTCOUNT_H
+#define EVENTCOUNT_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+/* Environment variable holding the spin count used before parking */
+#define EVENTCOUNT_SPIN_ENV "ANALYZER_SPIN"
+
+/**
+ * Futex-backed eventcount.
+ * A waiter registers with eventcount_prepare_wait(), re-checks its condition
+ * and only then parks with eventcount_wait(). A notifier publishes its state
+ * change first and then calls eventcount_notify(), which costs one fence and
+ * one load when nobody is parked and a futex wake otherwise. Unlike monitor_t
+ * nothing is sticky: every wait is paired with the condition it guards.
+ */
+typedef struct {
+    atomic_uint seq;       /* bumped by every notify that has waiters */
+    atomic_uint waiters;   /* threads between prepare_wait and wait/cancel */
+} eventcount_t;
+
+/**
+ * Initialize an eventcount
+ * @param ec Pointer to eventcount
+ */
+void eventcount_init(eventcount_t* ec);
+
+/**
+ * Register as a waiter. The caller must re-check its condition after this
+ * call and then either eventcount_wait() or eventcount_cancel_wait().
+ * @param ec Pointer to eventcount
+ * @return Key to pass to eventcount_wait()
+ */
+unsigned eventcount_prepare_wait(eventcount_t* ec);
+
+/**
+ * Withdraw a registration made by eventcount_prepare_wait()
+ * @param ec Pointer to eventcount
+ */
+void eventcount_cancel_wait(eventcount_t* ec);
+
+/**
+ * Park until a notify happens after the matching prepare_wait.
+ * May return spuriously; callers loop on their condition.
+ * @param ec Pointer to eventcount
+ * @param key Value returned by eventcount_prepare_wait()
+ */
+void eventcount_wait(eventcount_t* ec, unsigned key);
+
+/**
+ * As eventcount_wait(), but give up after a while
+ * @param ec Pointer to eventcount
+ * @param key Value returned by eventcount_prepare_wait()
+ * @param timeout_ns Longest time to park
+ */
+void eventcount_wait_timeout(eventcount_t* ec, unsigned key, uint64_t timeout_ns);
+
+/**
+ * Wake every parked waiter. Skips the syscall when nobody is registered.
+ * @param ec Pointer to eventcount
+ */
+void eventcount_notify(eventcount_t* ec);
+
+/**
+ * Wake one parked waiter. Enough when any single waiter can handle the
+ * change (new items for a queue with several consumers): waiters that had
+ * not parked yet still see the new seq and return.
+ * @param ec Pointer to eventcount
+ */
+void eventcount_notify_one(eventcount_t* ec);
+
+/**
+ * Spin iterations to poll before parking.
+ * Reads EVENTCOUNT_SPIN_ENV; defaults to 0 on a single CPU and a short
+ * spin otherwise.
+ * @return Number of polls
+ */
+int eventcount_spin_limit(void);
+
+/**
+ * Pause hint for spin loops
+ */
+static inline void eventcount_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+#endif /* EVENTCOUNT_H */
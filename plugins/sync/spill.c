@@ -0,0 +1,235 @@
+#define _GNU_SOURCE
+#include "spill.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Record header: payload length, padded so every record starts 8-byte aligned */
+#define SPILL_HEADER 8u
+
+/* Written or read pages are unmapped in steps of this many bytes */
+#define SPILL_UNMAP_STEP (1u << 20)
+
+struct spill_segment {
+    int fd;
+    char* base;
+    size_t size;
+    size_t head;                    /* next record to read */
+    size_t tail;                    /* end of the last record written */
+    size_t written_out;             /* pages below this were unmapped after writing */
+    size_t read_out;                /* pages below this were unmapped after reading */
+    spill_segment_t* next;
+};
+
+static size_t record_bytes(size_t len) {
+    return SPILL_HEADER + ((len + 7) & ~(size_t)7);
+}
+
+/*
+ * Give the file its blocks now: writing through a mapping of a sparse file
+ * on a full disk would fault instead of failing.
+ */
+static int segment_reserve(spill_segment_t* seg) {
+    return posix_fallocate(seg->fd, 0, (off_t)seg->size) == 0 ? 0 : -1;
+}
+
+/*
+ * Drop the pages between *done and offset from the mapping. The data stays
+ * in the file (and the page cache, which the kernel can write back and
+ * reclaim), so a backlog does not grow the process's resident memory; the
+ * reader faults a page back in when it gets there.
+ */
+static void segment_unmap(spill_segment_t* seg, size_t* done, size_t offset) {
+    size_t end = offset & ~(size_t)(SPILL_UNMAP_STEP - 1);
+    if (end <= *done) {
+        return;
+    }
+    (void)madvise(seg->base + *done, end - *done, MADV_DONTNEED);
+    *done = end;
+}
+
+static void segment_free(spill_segment_t* seg) {
+    munmap(seg->base, seg->size);
+    close(seg->fd);
+    free(seg);
+}
+
+static spill_segment_t* segment_create(const char* dir, size_t size) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size = (size + page - 1) / page * page;
+    char path[4096];
+    if (snprintf(path, sizeof path, "%s/analyzer-spill-XXXXXX", dir) >= (int)sizeof path) {
+        return NULL;
+    }
+    spill_segment_t* seg = calloc(1, sizeof *seg);
+    if (!seg) {
+        return NULL;
+    }
+    seg->fd = mkstemp(path);
+    if (seg->fd < 0) {
+        free(seg);
+        return NULL;
+    }
+    unlink(path);
+    seg->size = size;
+    if (segment_reserve(seg) != 0) {
+        close(seg->fd);
+        free(seg);
+        return NULL;
+    }
+    seg->base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, seg->fd, 0);
+    if (seg->base == MAP_FAILED) {
+        close(seg->fd);
+        free(seg);
+        return NULL;
+    }
+    return seg;
+}
+
+/* A segment read to the end: empty the file and keep it, or free it */
+static void segment_recycle(spill_t* spill, spill_segment_t* seg) {
+    seg->head = 0;
+    seg->tail = 0;
+    seg->written_out = 0;
+    seg->read_out = 0;
+    seg->next = NULL;
+    if (spill->spares >= SPILL_SPARE_SEGMENTS || seg->size != spill->segment_size ||
+        ftruncate(seg->fd, 0) != 0 || segment_reserve(seg) != 0) {
+        segment_free(seg);
+        return;
+    }
+    seg->next = spill->spare;
+    spill->spare = seg;
+    spill->spares++;
+}
+
+/* Segment with room for a record of need bytes after the current one, or NULL */
+static spill_segment_t* segment_next(spill_t* spill, size_t need) {
+    if (spill->spare && spill->spare->size >= need) {
+        spill_segment_t* seg = spill->spare;
+        spill->spare = seg->next;
+        spill->spares--;
+        seg->next = NULL;
+        return seg;
+    }
+    return segment_create(spill->dir, need > spill->segment_size ? need : spill->segment_size);
+}
+
+const char* spill_init(spill_t* spill, const char* dir, size_t segment_size) {
+    memset(spill, 0, sizeof *spill);
+    if (dir == NULL || *dir == '\0') {
+        dir = getenv("TMPDIR");
+    }
+    if (dir == NULL || *dir == '\0') {
+        dir = "/tmp";
+    }
+    spill->dir = strdup(dir);
+    if (!spill->dir) {
+        return "Memory allocation failed";
+    }
+    spill->segment_size = segment_size ? segment_size : SPILL_SEGMENT_SIZE;
+    spill->read = segment_create(spill->dir, spill->segment_size);
+    if (!spill->read) {
+        free(spill->dir);
+        return "Cannot create a spill segment file";
+    }
+    spill->segment_size = spill->read->size;
+    spill->write = spill->read;
+    atomic_init(&spill->pending, 0);
+    if (pthread_mutex_init(&spill->lock, NULL) != 0) {
+        segment_free(spill->read);
+        free(spill->dir);
+        return "Mutex init failed";
+    }
+    return NULL;
+}
+
+void spill_destroy(spill_t* spill) {
+    spill_segment_t* lists[2] = { spill->read, spill->spare };
+    for (int l = 0; l < 2; l++) {
+        spill_segment_t* seg = lists[l];
+        while (seg) {
+            spill_segment_t* next = seg->next;
+            segment_free(seg);
+            seg = next;
+        }
+    }
+    spill->read = spill->write = spill->spare = NULL;
+    pthread_mutex_destroy(&spill->lock);
+    free(spill->dir);
+    spill->dir = NULL;
+}
+
+int spill_write(spill_t* spill, int count, size_t (*size)(void* context, int i),
+                void (*save)(void* context, int i, void* dst), void* context) {
+    pthread_mutex_lock(&spill->lock);
+    int done = 0;
+    for (; done < count; done++) {
+        size_t len = size(context, done);
+        size_t need = record_bytes(len);
+        spill_segment_t* seg = spill->write;
+        if (seg->size - seg->tail < need) {
+            spill_segment_t* next = segment_next(spill, need);
+            if (!next) {
+                break;
+            }
+            seg->next = next;
+            spill->write = seg = next;
+        }
+        uint64_t header = (uint64_t)len;
+        memcpy(seg->base + seg->tail, &header, sizeof header);
+        save(context, done, seg->base + seg->tail + SPILL_HEADER);
+        seg->tail += need;
+        segment_unmap(seg, &seg->written_out, seg->tail);
+        spill->bytes += len;
+        if (spill->bytes > spill->high_water_bytes) {
+            spill->high_water_bytes = spill->bytes;
+        }
+    }
+    atomic_fetch_add_explicit(&spill->pending, (size_t)done, memory_order_release);
+    pthread_mutex_unlock(&spill->lock);
+    return done;
+}
+
+int spill_read(spill_t* spill, int max, int (*load)(void* context, const void* record, size_t size),
+               void* context) {
+    pthread_mutex_lock(&spill->lock);
+    int done = 0;
+    while (done < max) {
+        spill_segment_t* seg = spill->read;
+        if (seg->head == seg->tail) {
+            if (seg == spill->write) {
+                // Drained: start over at the front of the segment we have
+                seg->head = seg->tail = 0;
+                seg->written_out = seg->read_out = 0;
+                break;
+            }
+            spill->read = seg->next;
+            segment_recycle(spill, seg);
+            continue;
+        }
+        uint64_t header;
+        memcpy(&header, seg->base + seg->head, sizeof header);
+        size_t len = (size_t)header;
+        if (load(context, seg->base + seg->head + SPILL_HEADER, len) != 0) {
+            break;
+        }
+        seg->head += record_bytes(len);
+        spill->bytes -= len;
+        done++;
+    }
+    segment_unmap(spill->read, &spill->read->read_out, spill->read->head);
+    atomic_fetch_sub_explicit(&spill->pending, (size_t)done, memory_order_release);
+    pthread_mutex_unlock(&spill->lock);
+    return done;
+}
+
+void spill_get_usage(spill_t* spill, uint64_t* bytes, uint64_t* high_water_bytes) {
+    pthread_mutex_lock(&spill->lock);
+    *bytes = spill->bytes;
+    *high_water_bytes = spill->high_water_bytes;
+    pthread_mutex_unlock(&spill->lock);
+}
@@ -0,0 +1,96 @@
+#ifndef SPILL_H
+#define SPILL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Default size of one spill segment file */
+#define SPILL_SEGMENT_SIZE (64u << 20)
+
+/* Consumed segments kept mapped for reuse; the rest are unmapped and closed */
+#define SPILL_SPARE_SEGMENTS 1
+
+typedef struct spill_segment spill_segment_t;
+
+/**
+ * Append-only log of byte records in memory-mapped segment files.
+ * Records are read back in the order they were written. Segment files are
+ * unlinked as soon as they are created, so nothing is left behind; a
+ * segment that has been read to the end is emptied (its blocks and page
+ * cache are released) and reused. The writer and the readers may run on
+ * different threads: every call takes the spill's mutex, so callers
+ * should move records in batches.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    char* dir;
+    size_t segment_size;
+    spill_segment_t* read;          /* oldest segment, being read */
+    spill_segment_t* write;         /* newest segment, being appended to */
+    spill_segment_t* spare;         /* consumed segments waiting for reuse */
+    int spares;
+    atomic_size_t pending;          /* records written and not read yet */
+    uint64_t bytes;                 /* bytes in unread records */
+    uint64_t high_water_bytes;
+} spill_t;
+
+/**
+ * Initialize a spill and create its first segment, so an unusable
+ * directory is reported now rather than in the middle of a burst
+ * @param spill Spill
+ * @param dir Directory for the segment files (NULL: $TMPDIR, else /tmp)
+ * @param segment_size Bytes per segment (0: SPILL_SEGMENT_SIZE)
+ * @return NULL on success, error message on failure
+ */
+const char* spill_init(spill_t* spill, const char* dir, size_t segment_size);
+
+/**
+ * Free every segment (unread records are discarded)
+ * @param spill Spill
+ */
+void spill_destroy(spill_t* spill);
+
+/**
+ * Records written and not read yet (any thread, no lock)
+ * @param spill Spill
+ * @return Number of records
+ */
+static inline size_t spill_pending(spill_t* spill) {
+    return atomic_load_explicit(&spill->pending, memory_order_acquire);
+}
+
+/**
+ * Append records. The spill's mutex is held while the callback writes
+ * them, so it should only copy.
+ * @param spill Spill
+ * @param count Number of records
+ * @param size Returns the size of record i
+ * @param save Writes record i (size bytes) at dst
+ * @param context First argument of size and save
+ * @return Number of records appended (fewer than count when a segment cannot be created)
+ */
+int spill_write(spill_t* spill, int count, size_t (*size)(void* context, int i),
+                void (*save)(void* context, int i, void* dst), void* context);
+
+/**
+ * Read records back in order
+ * @param spill Spill
+ * @param max Maximum number of records
+ * @param load Called with each record; returns 0 to continue, -1 to stop (that record stays unread)
+ * @param context First argument of load
+ * @return Number of records read
+ */
+int spill_read(spill_t* spill, int max, int (*load)(void* context, const void* record, size_t size),
+               void* context);
+
+/**
+ * Sample the spill's byte counters
+ * @param spill Spill
+ * @param bytes Filled with the bytes in unread records
+ * @param high_water_bytes Filled with the most bytes ever unread at once
+ */
+void spill_get_usage(spill_t* spill, uint64_t* bytes, uint64_t* high_water_bytes);
+
+#endif /* SPILL_H */
@@ -4,17 +4,22 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <unistd.h> /* for usleep */
 
 /**
  * Transformation function for the typewriter.
- * Simulates a typewriter effect with a 100ms delay per character.
+ * Prints the line. The typewriter pace comes from the host, which holds
+ * lines back without blocking this thread: typewriter,rate=10B lets 10
+ * characters a second through (100ms per character).
  */
-static const char* typewriter_transform(const char* input) {
-    if (!input) return NULL;
-    printf("[typewriter] %s\n", input);
-    fflush(stdout);
-    return input;
+static const char* typewriter_transform(message_t* msg) {
+    static const char prefix[] = "[typewriter] ";
+    struct iovec record[3] = {
+        { (void*)prefix, sizeof(prefix) - 1 },
+        { msg->data, msg->len },
+        { "\n", 1 },
+    };
+    common_output_write(record, 3);
+    return NULL;
 }
 
 /**
@@ -26,7 +31,7 @@ static const char* typewriter_transform(const char* input) {
  */
 __attribute__((visibility("default")))
 const char* plugin_init(int queue_size) {
-    return common_plugin_init(typewriter_transform, "TYPEWRITER", queue_size);
+    return common_plugin_init_message(typewriter_transform, NULL, "TYPEWRITER", queue_size);
 }
 
 /**
@@ -53,15 +58,8 @@ const char* plugin_fini(void){
  */
 __attribute__((visibility("default")))
 const char* plugin_place_work(const char* str) {
-    plugin_context_t* context = get_plugin_context();
-    char* item_copy = strdup(str);
-    if (item_copy == NULL) return "Memory allocation failed in plugin_place_work";
-    const char* err = consumer_producer_put(context->queue, item_copy);
-    if (err != NULL) {
-        free(item_copy);
-        return err;
-    }
-    return NULL;
+    // Control lines ("<END>" from a v1 plugin upstream) become typed messages
+    return common_plugin_place_work(get_plugin_context(), str);
 }
 
 /**
@@ -94,6 +92,39 @@ const char* plugin_wait_finished(void){
 }
 
 
+static const char* typewriter_create(plugin_instance_t** instance, int queue_size) {
+    return common_plugin_create(instance, typewriter_transform, NULL, "TYPEWRITER", queue_size);
+}
+
+static const plugin_descriptor_t typewriter_descriptor = {
+    .abi_version = PLUGIN_ABI_VERSION,
+    .size = sizeof(plugin_descriptor_t),
+    .name = "TYPEWRITER",
+    .transform = {
+        .process = typewriter_transform,
+        .process_batch = NULL,
+        .flags = MESSAGE_TRANSFORM_IN_PLACE | MESSAGE_TRANSFORM_LENGTH_PRESERVING |
+                 MESSAGE_TRANSFORM_READ_ONLY,
+    },
+    .create = typewriter_create,
+    .destroy = common_plugin_destroy,
+    .place_work = common_plugin_place_work,
+    .attach = common_plugin_attach,
+    .get_message_sink = common_plugin_get_message_sink,
+    .wait_finished = common_plugin_wait_finished,
+    .get_stats = common_plugin_get_stats,
+};
+
+/**
+ * Describe the plugin for the v2 ABI: per-instance entry points and the
+ * transform's capabilities
+ * @return Pointer to the static descriptor
+ */
+__attribute__((visibility("default")))
+const plugin_descriptor_t* plugin_get_descriptor(void) {
+    return &typewriter_descriptor;
+}
+
 /**
  * Return the plugin's display name.
  * Used for identification and debugging.
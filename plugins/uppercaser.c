@@ -4,23 +4,18 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <ctype.h>
+#include "kernels/text_kernels.h"
 
 
 
 /**
  * Transformation function for the uppercaser.
- * Converts all alphabetic characters in the string to uppercase.
+ * Converts all alphabetic characters in the string to uppercase, in place,
+ * with the widest vector kernel this CPU supports.
  */
-static const char* uppercaser_transform(const char* input) {
-     if (!input) return NULL;
-    size_t len = strlen(input);
-    char* result = calloc(len + 1, sizeof(char));
-    if (!result) return NULL;
-    for (size_t i = 0; i < len; i++) {
-        result[i] = toupper(input[i]);
-    }
-    return result;
+PLUGIN_TRANSFORM const char* uppercaser_transform(message_t* msg) {
+    text_kernels()->upper(msg->data, msg->len);
+    return NULL;
 }
 
 /**
@@ -32,7 +27,7 @@ static const char* uppercaser_transform(const char* input) {
  */
 __attribute__((visibility("default")))
 const char* plugin_init(int queue_size){
-    return common_plugin_init(uppercaser_transform, "UPPERCASE", queue_size);
+    return common_plugin_init_message(uppercaser_transform, NULL, "UPPERCASE", queue_size);
 }
 /**
  * Finalize the plugin - drain queue and terminate thread gracefully (i.e.
@@ -58,15 +53,8 @@ const char* plugin_fini(void){
  */
 __attribute__((visibility("default")))
 const char* plugin_place_work(const char* str) {
-    plugin_context_t* context = get_plugin_context();
-    char* item_copy = strdup(str);
-    if (item_copy == NULL) return "Memory allocation failed in plugin_place_work";
-    const char* err = consumer_producer_put(context->queue, item_copy);
-    if (err != NULL) {
-        free(item_copy);
-        return err;
-    }
-    return NULL;
+    // Control lines ("<END>" from a v1 plugin upstream) become typed messages
+    return common_plugin_place_work(get_plugin_context(), str);
 }
 
 /**
@@ -99,6 +87,39 @@ const char* plugin_wait_finished(void){
 }
 
 
+static const char* uppercaser_create(plugin_instance_t** instance, int queue_size) {
+    return common_plugin_create(instance, uppercaser_transform, NULL, "UPPERCASE", queue_size);
+}
+
+static const plugin_descriptor_t uppercaser_descriptor = {
+    .abi_version = PLUGIN_ABI_VERSION,
+    .size = sizeof(plugin_descriptor_t),
+    .name = "UPPERCASE",
+    .transform = {
+        .process = uppercaser_transform,
+        .process_batch = NULL,
+        .flags = MESSAGE_TRANSFORM_PURE | MESSAGE_TRANSFORM_IN_PLACE |
+                 MESSAGE_TRANSFORM_LENGTH_PRESERVING | MESSAGE_TRANSFORM_THREAD_SAFE,
+    },
+    .create = uppercaser_create,
+    .destroy = common_plugin_destroy,
+    .place_work = common_plugin_place_work,
+    .attach = common_plugin_attach,
+    .get_message_sink = common_plugin_get_message_sink,
+    .wait_finished = common_plugin_wait_finished,
+    .get_stats = common_plugin_get_stats,
+};
+
+/**
+ * Describe the plugin for the v2 ABI: per-instance entry points and the
+ * transform's capabilities
+ * @return Pointer to the static descriptor
+ */
+__attribute__((visibility("default")))
+const plugin_descriptor_t* plugin_get_descriptor(void) {
+    return &uppercaser_descriptor;
+}
+
 /**
  * Return the plugin's display name.
  * Used for identification and debugging.
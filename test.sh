@@ -125,5 +125,450 @@ else
 fi
 echo ""
 
+# --- Test 9: SPSC queue backend ---
+# Expected: [logger] OHELL (same output as Test 3 with the lock-free queues)
+echo "Running Test 9: spsc queue backend"
+
+OUTPUT9=$(echo -e "hello\n<END>" | ./output/analyzer --queue-backend=spsc 10 uppercaser rotator logger 2>/dev/null)
+ACTUAL9=$(echo "$OUTPUT9" | grep "\[logger\]")
+
+if [ "$ACTUAL9" = "[logger] OHELL" ]; then
+    echo "Test 9: PASS 👍"
+else
+    echo "Test 9: FAIL ❌ (Expected: [logger] OHELL, Got: $ACTUAL9)"
+    echo "Full Output for debug: $OUTPUT9"
+fi
+echo ""
+
+# --- Test 10: fused pure stages ---
+# Expected: [logger] H E L L O (uppercaser, flipper, flipper and expander share one thread)
+echo "Running Test 10: fused stages"
+
+OUTPUT10=$(echo -e "hello\n<END>" | ./output/analyzer --fuse 10 uppercaser flipper flipper expander logger 2>/dev/null)
+ACTUAL10=$(echo "$OUTPUT10" | grep "\[logger\]")
+
+if [ "$ACTUAL10" = "[logger] H E L L O" ]; then
+    echo "Test 10: PASS 👍"
+else
+    echo "Test 10: FAIL ❌ (Expected: [logger] H E L L O, Got: $ACTUAL10)"
+    echo "Full Output for debug: $OUTPUT10"
+fi
+echo ""
+
+# --- Test 11: replicated stage keeps input order ---
+# Expected: [logger] lines in input order although expander runs on 4 threads
+echo "Running Test 11: replicated stage"
+
+OUTPUT11=$(seq 1 2000 | sed 's/^/line/' | ./output/analyzer 10 uppercaser expander@4 logger 2>/dev/null)
+EXPECTED11=$(seq 1 2000 | sed 's/^/LINE/' | sed 's/./& /g; s/ $//; s/^/[logger] /')
+ACTUAL11=$(echo "$OUTPUT11" | grep "\[logger\]")
+
+if [ "$ACTUAL11" = "$EXPECTED11" ]; then
+    echo "Test 11: PASS 👍"
+else
+    echo "Test 11: FAIL ❌ (logger output out of order or incomplete)"
+fi
+echo ""
+
+# --- Test 12: text kernels match the scalar transforms ---
+echo "Running Test 12: text kernels"
+
+if OUTPUT12=$(./output/kernel_test 2>&1); then
+    echo "Test 12: PASS 👍"
+else
+    echo "Test 12: FAIL ❌"
+    echo "Full Output for debug: $OUTPUT12"
+fi
+echo ""
+
+# --- Test 13: long lines are not split ---
+# Expected: one [logger] line carrying all 5000 characters, CRLF trimmed
+echo "Running Test 13: long line"
+
+LONG13=$(head -c 5000 /dev/zero | tr '\0' 'a')
+OUTPUT13=$(printf '%s\r\n<END>\n' "$LONG13" | ./output/analyzer 10 uppercaser logger 2>/dev/null)
+ACTUAL13=$(echo "$OUTPUT13" | grep "\[logger\]")
+EXPECTED13="[logger] $(echo "$LONG13" | tr 'a' 'A')"
+
+if [ "$ACTUAL13" = "$EXPECTED13" ]; then
+    echo "Test 13: PASS 👍"
+else
+    echo "Test 13: FAIL ❌ (long line split or altered)"
+fi
+echo ""
+
+# --- Test 14: parallel file input ---
+# Expected: --input on 3 workers prints exactly what the stdin path prints
+echo "Running Test 14: --input"
+
+INPUT14=$(mktemp)
+seq 1 100000 | sed 's/^/line/' > "$INPUT14"
+EXPECTED14=$(./output/analyzer 10 uppercaser flipper logger < "$INPUT14" 2>/dev/null)
+ACTUAL14=$(./output/analyzer --input="$INPUT14" --jobs=3 10 uppercaser flipper logger < /dev/null 2>/dev/null)
+rm -f "$INPUT14"
+
+if [ "$ACTUAL14" = "$EXPECTED14" ]; then
+    echo "Test 14: PASS 👍"
+else
+    echo "Test 14: FAIL ❌ (--input output differs from stdin)"
+fi
+echo ""
+
+# --- Test 15: output flush policies ---
+# Expected: every policy writes the same bytes, in the same order
+echo "Running Test 15: --flush policies"
+
+INPUT15=$(seq 1 5000 | sed 's/^/row/')
+EXPECTED15=$(echo "$INPUT15" | ./output/analyzer 10 uppercaser logger 2>/dev/null)
+FAILED15=""
+for POLICY15 in size:1 size:100000 linger:0 end; do
+    ACTUAL15=$(echo "$INPUT15" | ./output/analyzer --flush=$POLICY15 10 uppercaser logger 2>/dev/null)
+    if [ "$ACTUAL15" != "$EXPECTED15" ]; then
+        FAILED15="$FAILED15 $POLICY15"
+    fi
+done
+
+if [ -z "$FAILED15" ]; then
+    echo "Test 15: PASS 👍"
+else
+    echo "Test 15: FAIL ❌ (output differs for:$FAILED15)"
+fi
+echo ""
+
+# --- Test 16: runtime statistics ---
+# Expected: --stats=json counts every line at every stage, and SIGUSR1
+# prints a report without stopping the pipeline
+echo "Running Test 16: --stats and SIGUSR1"
+
+STATS16=$(seq 1 1000 | ./output/analyzer --stats=json 10 uppercaser rotator@2 logger 2>&1 >/dev/null)
+ITEMS16=$(echo "$STATS16" | grep -o '"items":1000,' | wc -l)
+ERR16=$(mktemp)
+./output/analyzer 10 uppercaser logger < <(seq 1 100; sleep 1; echo "<END>") > /dev/null 2> "$ERR16" &
+PID16=$!
+sleep 0.5
+kill -USR1 $PID16
+STATUS16=0
+wait $PID16 || STATUS16=$?
+DUMP16=$(grep -c "pipeline stats" "$ERR16")
+rm -f "$ERR16"
+
+if [ "$ITEMS16" -eq 3 ] && [ "$STATUS16" -eq 0 ] && [ "$DUMP16" -eq 1 ]; then
+    echo "Test 16: PASS 👍"
+else
+    echo "Test 16: FAIL ❌ (stages counted: $ITEMS16/3, exit status $STATUS16, reports on SIGUSR1: $DUMP16)"
+fi
+echo ""
+
+# --- Test 17: latency tracing ---
+# Expected: every line is timed end to end, and one line in 100 leaves a
+# trace event per stage plus one end-to-end event
+echo "Running Test 17: --latency and --trace"
+
+TRACE17=$(mktemp)
+LATENCY17=$(seq 1 1000 | ./output/analyzer --trace="$TRACE17" --trace-sample=100 10 uppercaser rotator@2 logger 2>&1 >/dev/null)
+LINES17=$(echo "$LATENCY17" | awk '$1 == "end-to-end" { print $2 }')
+EVENTS17=$(grep -c '"ph":"X"' "$TRACE17" || true)
+rm -f "$TRACE17"
+
+if [ "$LINES17" = "1000" ] && [ "$EVENTS17" -eq 40 ]; then
+    echo "Test 17: PASS 👍"
+else
+    echo "Test 17: FAIL ❌ (lines timed: $LINES17/1000, trace events: $EVENTS17/40)"
+fi
+echo ""
+
+# --- Test 18: control messages ---
+# Expected: a line reading END is ordinary data, and <FLUSH> writes the
+# lines before it out even under --flush=end, while input is still open
+echo "Running Test 18: END as data and <FLUSH>"
+
+OUTPUT18=$(printf 'END\nnext\n<END>\n' | ./output/analyzer 10 uppercaser logger 2>/dev/null | grep "\[logger\]" | tr '\n' ' ')
+OUT18=$(mktemp)
+./output/analyzer --flush=end 10 uppercaser rotator@2 logger < <(printf 'early\n<FLUSH>\n'; sleep 1; printf 'late\n<END>\n') > "$OUT18" 2>/dev/null &
+PID18=$!
+sleep 0.5
+EARLY18=$(grep -c "\[logger\] YEARL" "$OUT18" || true)
+wait $PID18 || true
+LATE18=$(grep -c "\[logger\] ELAT" "$OUT18" || true)
+rm -f "$OUT18"
+
+if [ "$OUTPUT18" = "[logger] END [logger] NEXT " ] && [ "$EARLY18" -eq 1 ] && [ "$LATE18" -eq 1 ]; then
+    echo "Test 18: PASS 👍"
+else
+    echo "Test 18: FAIL ❌ (END as data: '$OUTPUT18', flushed early: $EARLY18, late line: $LATE18)"
+fi
+echo ""
+
+# --- Test 19: CPU pinning ---
+# Expected: --pin=auto and an explicit CPU list give the unpinned output,
+# and a CPU that does not exist is rejected
+echo "Running Test 19: --pin"
+
+INPUT19=$(printf 'line %d\n' $(seq 1 500); echo "<END>")
+PLAIN19=$(echo "$INPUT19" | ./output/analyzer 10 uppercaser rotator@2 flipper logger 2>/dev/null)
+AUTO19=$(echo "$INPUT19" | ./output/analyzer --pin=auto 10 uppercaser rotator@2 flipper logger 2>/dev/null)
+LIST19=$(echo "$INPUT19" | ./output/analyzer --pin=0 --fuse 10 uppercaser rotator@2 flipper logger 2>/dev/null)
+BAD19=0
+echo "$INPUT19" | ./output/analyzer --pin=99999 10 logger >/dev/null 2>&1 || BAD19=$?
+
+if [ "$AUTO19" = "$PLAIN19" ] && [ "$LIST19" = "$PLAIN19" ] && [ "$BAD19" -ne 0 ]; then
+    echo "Test 19: PASS 👍"
+else
+    echo "Test 19: FAIL ❌ (auto matches: $([ "$AUTO19" = "$PLAIN19" ] && echo yes || echo no), list matches: $([ "$LIST19" = "$PLAIN19" ] && echo yes || echo no), bad CPU status: $BAD19)"
+fi
+echo ""
+
+# --- Test 20: work-stealing executor ---
+# Expected: pure stages run as tasks on a worker pool with the same output,
+# in order, as with a thread per stage, for any pool size and queue size
+echo "Running Test 20: --executor"
+
+INPUT20=$(printf 'line %d\n' $(seq 1 2000); echo "<FLUSH>"; printf 'tail %d\n' $(seq 1 50); echo "<END>")
+CHAIN20="uppercaser rotator flipper expander rotator logger"
+PLAIN20=$(echo "$INPUT20" | ./output/analyzer 2 $CHAIN20 2>/dev/null)
+OK20=1
+for OPTS20 in "--executor=1" "--executor=3" "--executor=2 --fuse"; do
+    OUT20=$(echo "$INPUT20" | ./output/analyzer $OPTS20 2 $CHAIN20 2>/dev/null)
+    if [ "$OUT20" != "$PLAIN20" ]; then
+        OK20=0
+        echo "  output differs with $OPTS20"
+    fi
+done
+MODES20=$(echo "$INPUT20" | ./output/analyzer --executor=2 --stats=json 2 $CHAIN20 2>&1 >/dev/null | grep -o '"mode":"task"' | wc -l)
+
+if [ "$OK20" -eq 1 ] && [ "$MODES20" -eq 5 ]; then
+    echo "Test 20: PASS 👍"
+else
+    echo "Test 20: FAIL ❌ (task stages reported: $MODES20)"
+fi
+echo ""
+
+# --- Test 21: queue overflow policies ---
+# Expected: a shedding queue passes or counts every line (never a control
+# message), block keeps every line, timeout gives each line that finds
+# the queue full its own wait (a consumer slower than the batch but
+# faster than the timeout loses nothing), lines shed in front of an
+# ordered name@N stage do not stall its reorder window (the rest leave in
+# order), and an unknown policy is rejected
+echo "Running Test 21: queue policies"
+
+INPUT21=$(printf 'line %d\n' $(seq 1 2000); echo "<FLUSH>"; printf 'tail %d\n' $(seq 1 50); echo "<END>")
+PLAIN21=$(echo "$INPUT21" | ./output/analyzer 4 uppercaser logger 2>/dev/null)
+BLOCK21=$(echo "$INPUT21" | ./output/analyzer --queue-policy=block 4 uppercaser logger,cap=2 2>/dev/null)
+OK21=1
+for POLICY21 in drop-newest drop-oldest sample:2 timeout:0; do
+    OUT21=$(echo "$INPUT21" | ./output/analyzer --stats=json 4 uppercaser logger,cap=1,policy=$POLICY21 2>&1)
+    LINES21=$(echo "$OUT21" | grep -c '^\[logger\]')
+    DROPPED21=$(echo "$OUT21" | grep -o '"dropped":[0-9]*' | awk -F: '{ n += $2 } END { print n + 0 }')
+    if [ $((LINES21 + DROPPED21)) -ne 2050 ] || ! echo "$OUT21" | grep -q "Pipeline shutdown complete"; then
+        OK21=0
+        echo "  $POLICY21: $LINES21 lines out, $DROPPED21 dropped"
+    fi
+done
+# uppercaser takes a line every 50 ms, well inside each line's 300 ms
+SLOW21=$(printf 'slow %d\n' $(seq 1 20) | ./output/analyzer 4 uppercaser,cap=1,policy=timeout:300 logger,rate=20,burst=1,cap=1 2>/dev/null | grep -c '^\[logger\]')
+REPLICA_RC21=0
+REPLICA21=$( (seq 1 100000; echo "<END>") | timeout 20 ./output/analyzer --stats=json 4 uppercaser,cap=1,policy=drop-newest expander@2 logger 2>&1) || REPLICA_RC21=$?
+REPLICA_LINES21=$(echo "$REPLICA21" | grep '^\[logger\]' | tr -d ' ' | sed 's/\[logger\]//')
+REPLICA_DROPPED21=$(echo "$REPLICA21" | grep -o '"dropped":[0-9]*' | awk -F: '{ n += $2 } END { print n + 0 }')
+REPLICA_OK21=0
+if [ "$REPLICA_RC21" -eq 0 ] && [ $(( $(echo "$REPLICA_LINES21" | grep -c .) + REPLICA_DROPPED21 )) -eq 100000 ] && \
+   echo "$REPLICA_LINES21" | sort -n -c 2>/dev/null; then
+    REPLICA_OK21=1
+fi
+BAD21=0
+echo "$INPUT21" | ./output/analyzer 4 logger,policy=drop-everything >/dev/null 2>&1 || BAD21=$?
+
+if [ "$OK21" -eq 1 ] && [ "$BLOCK21" = "$PLAIN21" ] && [ "$SLOW21" -eq 20 ] && [ "$REPLICA_OK21" -eq 1 ] && \
+   [ "$BAD21" -ne 0 ]; then
+    echo "Test 21: PASS 👍"
+else
+    echo "Test 21: FAIL ❌ (block matches: $([ "$BLOCK21" = "$PLAIN21" ] && echo yes || echo no), timeout kept $SLOW21/20, replicas behind drops: exit $REPLICA_RC21, $REPLICA_DROPPED21 dropped, bad policy status: $BAD21)"
+fi
+echo ""
+
+# --- Test 22: spilling queues ---
+# Expected: a queue that spills to disk keeps every line in order (same
+# output as blocking), reports what it spilled, and a spill directory that
+# cannot be used fails at startup
+echo "Running Test 22: spill policy"
+
+INPUT22=$(printf 'line %d\n' $(seq 1 5000); echo "<FLUSH>"; printf 'tail %d\n' $(seq 1 50); echo "<END>")
+PLAIN22=$(echo "$INPUT22" | ./output/analyzer 2 uppercaser rotator@2 logger 2>/dev/null)
+SPILL22=$(echo "$INPUT22" | ./output/analyzer --queue-policy=spill 1 uppercaser rotator@2 logger 2>/dev/null)
+SPSC22=$(echo "$INPUT22" | ./output/analyzer --queue-backend=spsc 1 uppercaser rotator logger,policy=spill:. 2>/dev/null)
+PLAINSPSC22=$(echo "$INPUT22" | ./output/analyzer 1 uppercaser rotator logger 2>/dev/null)
+SPILLED22=$(echo "$INPUT22" | ./output/analyzer --queue-policy=spill --stats=json 1 uppercaser logger 2>&1 >/dev/null | \
+    grep -o '"spilled":[0-9]*' | awk -F: '{ n += $2 } END { print n + 0 }')
+BAD22=0
+echo "$INPUT22" | ./output/analyzer 2 logger,policy=spill:/nonexistent >/dev/null 2>&1 || BAD22=$?
+
+if [ "$SPILL22" = "$PLAIN22" ] && [ "$SPSC22" = "$PLAINSPSC22" ] && [ "$SPILLED22" -gt 0 ] && [ "$BAD22" -ne 0 ]; then
+    echo "Test 22: PASS 👍"
+else
+    echo "Test 22: FAIL ❌ (replicas match: $([ "$SPILL22" = "$PLAIN22" ] && echo yes || echo no), spsc matches: $([ "$SPSC22" = "$PLAINSPSC22" ] && echo yes || echo no), spilled: $SPILLED22, bad dir status: $BAD22)"
+fi
+echo ""
+
+# --- Test 23: branching topologies ---
+# Expected: every branch of a tee sees every line (a branch that only logs
+# sees them unchanged while its neighbour rewrites them), a merge passes on
+# the lines of all branches and one <END>, and unbalanced brackets are
+# rejected
+echo "Running Test 23: tee and merge"
+
+INPUT23=$(printf 'line %d\n' $(seq 1 3000); echo "<END>")
+TEE23=$(echo "$INPUT23" | ./output/analyzer 4 [ logger / uppercaser logger ] 2>/dev/null | sort)
+EXPECT23=$( (echo "$INPUT23" | ./output/analyzer 4 logger; echo "$INPUT23" | ./output/analyzer 4 uppercaser logger) 2>/dev/null | \
+    grep -v "Pipeline shutdown complete" | sort)
+MERGE23=$(echo "$INPUT23" | ./output/analyzer --executor 4 flipper [ uppercaser / rotator ] logger 2>/dev/null | sort)
+EXPECTM23=$( (echo "$INPUT23" | ./output/analyzer 4 flipper uppercaser logger; echo "$INPUT23" | ./output/analyzer 4 flipper rotator logger) 2>/dev/null | \
+    grep -v "Pipeline shutdown complete" | sort)
+BAD23=0
+echo "$INPUT23" | ./output/analyzer 4 [ logger / uppercaser >/dev/null 2>&1 || BAD23=$?
+
+if [ "$(echo "$TEE23" | grep -v "Pipeline shutdown complete")" = "$EXPECT23" ] && \
+   [ "$(echo "$MERGE23" | grep -v "Pipeline shutdown complete")" = "$EXPECTM23" ] && \
+   [ "$(echo "$MERGE23" | grep -c "Pipeline shutdown complete")" -eq 1 ] && [ "$BAD23" -ne 0 ]; then
+    echo "Test 23: PASS 👍"
+else
+    echo "Test 23: FAIL ❌ (bad brackets status: $BAD23)"
+fi
+echo ""
+
+# --- Test 24: result cache ---
+# Expected: --memo gives the same lines as running every stage, replays
+# repeated lines from the cache (hits reported in --stats), still works
+# when the cache is too small to hold them, and rejects a bad size
+echo "Running Test 24: memo cache"
+
+INPUT24=$(for i in $(seq 1 400); do printf 'GET /index.html %d\nPOST /api/login\nhello world\n' $((i % 7)); done; echo "<END>")
+PLAIN24=$(echo "$INPUT24" | ./output/analyzer 8 uppercaser rotator expander logger flipper logger 2>/dev/null | sort)
+MEMO24=$(echo "$INPUT24" | ./output/analyzer --memo 8 uppercaser rotator expander logger flipper logger 2>/dev/null | sort)
+SMALL24=$(echo "$INPUT24" | ./output/analyzer --memo=16 --executor 8 uppercaser rotator expander logger flipper logger 2>/dev/null | sort)
+HITS24=$(echo "$INPUT24" | ./output/analyzer --memo --stats=json 8 uppercaser rotator expander logger 2>&1 >/dev/null | \
+    grep -o '"hits":[0-9]*' | cut -d: -f2)
+BAD24=0
+echo "$INPUT24" | ./output/analyzer --memo=3 8 uppercaser logger >/dev/null 2>&1 || BAD24=$?
+
+if [ "$MEMO24" = "$PLAIN24" ] && [ "$SMALL24" = "$PLAIN24" ] && [ "${HITS24:-0}" -gt 1000 ] && [ "$BAD24" -ne 0 ]; then
+    echo "Test 24: PASS 👍"
+else
+    echo "Test 24: FAIL ❌ (memo matches: $([ "$MEMO24" = "$PLAIN24" ] && echo yes || echo no), small matches: $([ "$SMALL24" = "$PLAIN24" ] && echo yes || echo no), hits: $HITS24, bad size status: $BAD24)"
+fi
+echo ""
+
+# --- Test 25: analyzer-static ---
+# Expected: the statically linked build gives the same output as the
+# plugin build, with specialized fused runs (--fuse), runs too long to be
+# specialized, the result cache and branches, and still loads a plugin
+# that is not built in from its .so
+echo "Running Test 25: analyzer-static"
+
+INPUT25=$(printf 'Hello World %d\n' $(seq 1 2000); echo "<END>")
+PLAIN25=""
+STATIC25=""
+for run in "--fuse|uppercaser rotator expander logger" "--fuse|flipper rotator rotator uppercaser expander logger" \
+           "--fuse --memo|rotator flipper logger uppercaser logger" "|rotator [ uppercaser / flipper expander ] logger"; do
+    opts=${run%%|*}
+    chain=${run#*|}
+    PLAIN25="$PLAIN25$(echo "$INPUT25" | ./output/analyzer $opts 8 $chain 2>&1 | sort)"
+    STATIC25="$STATIC25$(echo "$INPUT25" | ./output/analyzer-static $opts 8 $chain 2>&1 | sort)"
+done
+cp output/rotator.so output/test25_rotator.so
+SO25=$(echo "$INPUT25" | ./output/analyzer-static --fuse 8 uppercaser test25_rotator logger 2>&1)
+rm -f output/test25_rotator.so
+EXPECTSO25=$(echo "$INPUT25" | ./output/analyzer --fuse 8 uppercaser rotator logger 2>&1)
+LINES25=$(echo "$STATIC25" | grep -c "^\[logger\]")
+
+if [ "$STATIC25" = "$PLAIN25" ] && [ "$LINES25" -eq 12000 ] && [ "$SO25" = "$EXPECTSO25" ]; then
+    echo "Test 25: PASS 👍"
+else
+    echo "Test 25: FAIL ❌ (chains match: $([ "$STATIC25" = "$PLAIN25" ] && echo yes || echo no), lines: $LINES25, .so plugin matches: $([ "$SO25" = "$EXPECTSO25" ] && echo yes || echo no))"
+fi
+echo ""
+
+# --- Test 26: rate limits ---
+# Expected: paced stages keep every line in order, a line rate and a byte
+# rate both hold the chain back for as long as the bucket takes to refill
+# (burst lines go at once), and malformed rates are rejected
+echo "Running Test 26: pacing"
+
+INPUT26=$(printf 'line %02d\n' $(seq 1 30); echo "<END>")
+PLAIN26=$(echo "$INPUT26" | ./output/analyzer 4 uppercaser rotator logger 2>/dev/null)
+START26=$(date +%s%N)
+PACED26=$(echo "$INPUT26" | ./output/analyzer 4 uppercaser,rate=100,burst=10 rotator,rate=1000,cap=2 logger 2>/dev/null)
+MID26=$(date +%s%N)
+BYTES26=$(echo "$INPUT26" | ./output/analyzer --executor 4 uppercaser rotator,rate=500B logger 2>/dev/null)
+END26=$(date +%s%N)
+LINES_MS26=$(( (MID26 - START26) / 1000000 ))
+BYTES_MS26=$(( (END26 - MID26) / 1000000 ))
+BAD26=0
+echo "$INPUT26" | ./output/analyzer 4 logger,rate=0 >/dev/null 2>&1 || BAD26=$((BAD26 + 1))
+echo "$INPUT26" | ./output/analyzer 4 logger,burst=5 >/dev/null 2>&1 || BAD26=$((BAD26 + 1))
+
+# 20 lines past the burst at 100/s, and 160 bytes (7 a line) past the burst at 500 B/s
+if [ "$PACED26" = "$PLAIN26" ] && [ "$BYTES26" = "$PLAIN26" ] && [ "$LINES_MS26" -ge 180 ] && \
+   [ "$BYTES_MS26" -ge 290 ] && [ "$BAD26" -eq 2 ]; then
+    echo "Test 26: PASS 👍"
+else
+    echo "Test 26: FAIL ❌ (lines match: $([ "$PACED26" = "$PLAIN26" ] && echo yes || echo no), bytes match: $([ "$BYTES26" = "$PLAIN26" ] && echo yes || echo no), line-paced ms: $LINES_MS26, byte-paced ms: $BYTES_MS26, rejected: $BAD26/2)"
+fi
+echo ""
+
+# --- Test 27: io_uring input and output ---
+# Expected: --io=uring gives the same output as read()/writev() for a
+# file several read-ahead blocks long and for a pipe, written to a file,
+# appended to one and piped on, with text after <END> left unread
+# (wherever io_uring is unavailable it falls back, with the same output)
+echo "Running Test 27: --io=uring"
+
+INPUT27=$(mktemp)
+OUT27=$(mktemp)
+printf 'io_uring line %06d with some padding to fill blocks\n' $(seq 1 60000) > "$INPUT27"
+printf '<END>\nafter the end\n' >> "$INPUT27"
+PLAIN27=$(./output/analyzer 64 uppercaser logger < "$INPUT27" 2>/dev/null | cksum)
+./output/analyzer --io=uring 64 uppercaser logger < "$INPUT27" > "$OUT27" 2>/dev/null
+FILE27=$(cksum < "$OUT27")
+echo "before" > "$OUT27"
+cat "$INPUT27" | ./output/analyzer --io=uring --flush=end 64 uppercaser logger >> "$OUT27" 2>/dev/null
+APPEND27=$(tail -n +2 "$OUT27" | cksum)
+FIRST27=$(head -1 "$OUT27")
+PIPE27=$(cat "$INPUT27" | ./output/analyzer --io=uring 64 uppercaser logger 2>/dev/null | cksum)
+BAD27=0
+./output/analyzer --io=async 4 logger < /dev/null >/dev/null 2>&1 || BAD27=1
+rm -f "$INPUT27" "$OUT27"
+
+if [ "$FILE27" = "$PLAIN27" ] && [ "$APPEND27" = "$PLAIN27" ] && [ "$FIRST27" = "before" ] && \
+   [ "$PIPE27" = "$PLAIN27" ] && [ "$BAD27" -eq 1 ]; then
+    echo "Test 27: PASS 👍"
+else
+    echo "Test 27: FAIL ❌ (file: $([ "$FILE27" = "$PLAIN27" ] && echo yes || echo no), append: $([ "$APPEND27" = "$PLAIN27" ] && [ "$FIRST27" = "before" ] && echo yes || echo no), pipe: $([ "$PIPE27" = "$PLAIN27" ] && echo yes || echo no), bad option rejected: $BAD27)"
+fi
+echo ""
+
+# --- Test 28: plugins with only the original entry points ---
+# Expected: a v1 plugin (strings and a textual "<END>") mixes with the
+# current ones in either position, and its "<END>" still ends the chain
+echo "Running Test 28: v1 plugins"
+
+INPUT28=$(printf 'hello %d\n' $(seq 1 500); echo "<END>")
+EXPECT28=$(echo "$INPUT28" | ./output/analyzer 8 flipper uppercaser logger 2>&1)
+FRONT_RC28=0
+FRONT28=$(echo "$INPUT28" | timeout 10 ./output/analyzer 8 v1_flipper uppercaser logger 2>&1) || FRONT_RC28=$?
+BACK_RC28=0
+BACK28=$(echo "$INPUT28" | timeout 10 ./output/analyzer 8 uppercaser v1_flipper logger 2>&1) || BACK_RC28=$?
+FUSED_RC28=0
+FUSED28=$(echo "$INPUT28" | timeout 10 ./output/analyzer --fuse 8 v1_flipper uppercaser rotator rotator logger 2>&1) || FUSED_RC28=$?
+EXPECT_FUSED28=$(echo "$INPUT28" | ./output/analyzer --fuse 8 flipper uppercaser rotator rotator logger 2>&1)
+
+if [ "$FRONT_RC28" -eq 0 ] && [ "$BACK_RC28" -eq 0 ] && [ "$FUSED_RC28" -eq 0 ] && [ "$FRONT28" = "$EXPECT28" ] && \
+   [ "$BACK28" = "$EXPECT28" ] && [ "$FUSED28" = "$EXPECT_FUSED28" ]; then
+    echo "Test 28: PASS 👍"
+else
+    echo "Test 28: FAIL ❌ (exit codes: $FRONT_RC28/$BACK_RC28/$FUSED_RC28, front matches: $([ "$FRONT28" = "$EXPECT28" ] && echo yes || echo no), back matches: $([ "$BACK28" = "$EXPECT28" ] && echo yes || echo no), fused matches: $([ "$FUSED28" = "$EXPECT_FUSED28" ] && echo yes || echo no))"
+fi
+echo ""
+
 echo "--------------------------"
 echo "Tests complete."
\ No newline at end of file
@@ -0,0 +1,113 @@
+#define _POSIX_C_SOURCE 200809L
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "kernels/text_kernels.h"
+
+/*
+ * Checks every text kernel variant this CPU supports against the scalar
+ * loops the plugins used before the kernels existed.
+ * Usage: ./output/kernel_test
+ */
+
+#define MAX_LEN 1100
+
+static void reference_upper(char* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        data[i] = toupper((unsigned char)data[i]);
+    }
+}
+
+static void reference_reverse(char* data, size_t len) {
+    for (size_t i = 0; i < len / 2; i++) {
+        char tmp = data[i];
+        data[i] = data[len - 1 - i];
+        data[len - 1 - i] = tmp;
+    }
+}
+
+static void reference_rotate_right(char* data, size_t len) {
+    if (len < 2) return;
+    char last = data[len - 1];
+    for (size_t i = len - 1; i > 0; i--) {
+        data[i] = data[i - 1];
+    }
+    data[0] = last;
+}
+
+/* Output is 2*len-1 bytes; the last byte of the 2*len buffer is ignored */
+static void reference_expand(char* data, size_t len) {
+    if (len < 2) return;
+    for (size_t i = len - 1; i > 0; i--) {
+        data[2 * i] = data[i];
+        data[2 * i - 1] = ' ';
+    }
+}
+
+static void fill(char* data, size_t len, unsigned* seed) {
+    for (size_t i = 0; i < len; i++) {
+        *seed = *seed * 1103515245u + 12345u;
+        unsigned r = (*seed >> 16) & 0xff;
+        /* Mostly letters, with the edges of a-z and high bytes mixed in */
+        static const char edges[] = "`az{@AZ[ \x7f\x80\xe1\xff";
+        if (r < 160) {
+            data[i] = (char)('a' + r % 26);
+        } else if (r < 200) {
+            data[i] = edges[r % (sizeof(edges) - 1)];
+        } else {
+            data[i] = (char)(r | 1);
+        }
+    }
+}
+
+static int check(const text_kernels_t* k, const char* kernel, void (*run)(char*, size_t),
+                 void (*reference)(char*, size_t), size_t out_len_factor) {
+    static char input[MAX_LEN], expected[2 * MAX_LEN], actual[2 * MAX_LEN + 128];
+    unsigned seed = 42;
+    for (size_t len = 0; len <= MAX_LEN; len++) {
+        /* Exercise every misalignment against the vector width */
+        size_t offset = len % 64;
+        fill(input, len, &seed);
+        memcpy(expected, input, len);
+        memcpy(actual + offset, input, len);
+        memset(actual + offset + len, '#', len + 16);
+        reference(expected, len);
+        run(actual + offset, len);
+        size_t out = len == 0 ? 0 : out_len_factor * len - (out_len_factor - 1);
+        if (memcmp(expected, actual + offset, out) != 0) {
+            fprintf(stderr, "%s/%s: mismatch at length %zu\n", k->name, kernel, len);
+            return 1;
+        }
+        if (out_len_factor == 1 && actual[offset + len] != '#') {
+            fprintf(stderr, "%s/%s: wrote past the end at length %zu\n", k->name, kernel, len);
+            return 1;
+        }
+        if (out_len_factor == 2 && actual[offset + 2 * len] != '#' && len > 0) {
+            fprintf(stderr, "%s/%s: wrote past 2*len at length %zu\n", k->name, kernel, len);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(void) {
+    static const char* const variants[] = { "scalar", "sse2", "avx2", "avx512" };
+    int failures = 0;
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+        const text_kernels_t* k = text_kernels_by_name(variants[v]);
+        if (!k) {
+            printf("%s: not supported, skipped\n", variants[v]);
+            continue;
+        }
+        int failed = 0;
+        failed += check(k, "upper", k->upper, reference_upper, 1);
+        failed += check(k, "reverse", k->reverse, reference_reverse, 1);
+        failed += check(k, "rotate_right", k->rotate_right, reference_rotate_right, 1);
+        failed += check(k, "expand", k->expand, reference_expand, 2);
+        printf("%s: %s\n", k->name, failed ? "FAIL" : "PASS");
+        failures += failed;
+    }
+    printf("selected: %s\n", text_kernels()->name);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,114 @@
+#define _POSIX_C_SOURCE 200809L
+/*
+ * A plugin as the original assignment API defined it: strings in and out
+ * through plugin_place_work/plugin_attach, a queue of its own, "<END>" as
+ * text, and none of the message, host-services or descriptor entry points.
+ * Test 28 runs it in front of and behind the current plugins.
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define V1_QUEUE_MAX 64
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    char* items[V1_QUEUE_MAX];
+    int capacity;
+    int head;
+    int count;
+    int finished;
+    pthread_t thread;
+    const char* (*next_place_work)(const char*);
+} v1 = { .lock = PTHREAD_MUTEX_INITIALIZER, .changed = PTHREAD_COND_INITIALIZER };
+
+static char* take(void) {
+    pthread_mutex_lock(&v1.lock);
+    while (v1.count == 0) {
+        pthread_cond_wait(&v1.changed, &v1.lock);
+    }
+    char* str = v1.items[v1.head];
+    v1.head = (v1.head + 1) % v1.capacity;
+    v1.count--;
+    pthread_cond_broadcast(&v1.changed);
+    pthread_mutex_unlock(&v1.lock);
+    return str;
+}
+
+static void* consumer(void* arg) {
+    (void)arg;
+    for (;;) {
+        char* str = take();
+        int end = strcmp(str, "<END>") == 0;
+        if (!end) {
+            size_t len = strlen(str);
+            for (size_t i = 0; i < len / 2; i++) {
+                char c = str[i];
+                str[i] = str[len - 1 - i];
+                str[len - 1 - i] = c;
+            }
+        }
+        if (v1.next_place_work) {
+            v1.next_place_work(str);
+        }
+        free(str);
+        if (end) {
+            break;
+        }
+    }
+    pthread_mutex_lock(&v1.lock);
+    v1.finished = 1;
+    pthread_cond_broadcast(&v1.changed);
+    pthread_mutex_unlock(&v1.lock);
+    return NULL;
+}
+
+const char* plugin_get_name(void) {
+    return "v1_flipper";
+}
+
+const char* plugin_init(int queue_size) {
+    v1.capacity = queue_size < V1_QUEUE_MAX ? queue_size : V1_QUEUE_MAX;
+    if (v1.capacity < 1) {
+        return "Invalid queue size";
+    }
+    if (pthread_create(&v1.thread, NULL, consumer, NULL) != 0) {
+        return "Failed to create consumer thread";
+    }
+    return NULL;
+}
+
+const char* plugin_place_work(const char* str) {
+    char* copy = strdup(str);
+    if (!copy) {
+        return "Memory allocation failed";
+    }
+    pthread_mutex_lock(&v1.lock);
+    while (v1.count == v1.capacity) {
+        pthread_cond_wait(&v1.changed, &v1.lock);
+    }
+    v1.items[(v1.head + v1.count) % v1.capacity] = copy;
+    v1.count++;
+    pthread_cond_broadcast(&v1.changed);
+    pthread_mutex_unlock(&v1.lock);
+    return NULL;
+}
+
+void plugin_attach(const char* (*next_place_work)(const char*)) {
+    v1.next_place_work = next_place_work;
+}
+
+const char* plugin_wait_finished(void) {
+    pthread_mutex_lock(&v1.lock);
+    while (!v1.finished) {
+        pthread_cond_wait(&v1.changed, &v1.lock);
+    }
+    pthread_mutex_unlock(&v1.lock);
+    return NULL;
+}
+
+const char* plugin_fini(void) {
+    pthread_join(v1.thread, NULL);
+    return NULL;
+}